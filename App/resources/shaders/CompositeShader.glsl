@@ -21,9 +21,7 @@ layout(binding = 4) uniform sampler2D u_Depth;
 
 uniform vec2 u_ViewportDims;
 
-uniform mat4 u_InverseView;
-uniform mat4 u_InverseProjection;
-uniform vec3 u_CameraPos;
+#include "camera.glinc"
 
 uniform int u_Output;
 
@@ -45,7 +43,7 @@ float GetAOFadeFromPixelPosition(vec3 worldPos)
 	const float min_dist = 80.0f;
 	const float range = 30.0f;
 
-	vec3 planarCam = u_CameraPos;
+	vec3 planarCam = u_CameraPosition;
 	planarCam.y = 0.0f;
 	worldPos.y = 0.0f;
 
@@ -3,7 +3,8 @@
 
 layout(location = 0) in vec3 a_Position;
 
-uniform mat4 u_ViewProjection;
+#include "camera.glinc"
+
 uniform mat4 u_Transformation;
 
 out vec3 o_Vertex;
@@ -29,6 +30,7 @@ uniform float u_LightIntensity;
 
 uniform vec2 u_ViewportDims;
 
+#include "camera.glinc"
 #include "raytracing.glinc"
 
 layout(binding = 2) uniform sampler2D u_Normals;
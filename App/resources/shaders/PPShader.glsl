@@ -22,9 +22,9 @@ layout(binding = 4) uniform sampler2D u_Normal;
 layout(binding = 5) uniform sampler2D u_PreviousNormal;
 layout(binding = 6) uniform sampler2D u_AmbientAccumulation;
 
+#include "camera.glinc"
 #include "raytracing.glinc"
 
-uniform mat4 u_ViewProjection;
 uniform mat4 u_PrevFrameViewProjection;
 
 const int AmbientOcclusionRaysMaxDistanceMeters = 24;
@@ -6,7 +6,8 @@
 
 layout(location = 0) in vec3 a_Position;
 
-uniform mat4 u_ViewProjection;
+#include "camera.glinc"
+
 out vec3 v_VertexWorldSpace;
 out flat int v_Instance;
 
@@ -15,7 +16,8 @@ struct ChunkInstance
 	mat4 transformation;
 	uint64_t voxel_texture_handle;
 	ivec2 index;
-	int lod;
+	int lod; // finest LOD in use
+	uint region_lods; // 2 bits per 4x4 xz region, x fastest
 };
 
 layout(std430, binding = 0) readonly buffer InstanceData
@@ -47,7 +49,10 @@ in vec3 v_VertexWorldSpace;
 in flat int v_Instance;
 
 //layout(binding = 0) uniform usampler3D u_ShadowMap;
-layout(binding = 0) uniform usampler3D u_PackedOcclusionMap;
+layout(binding = 0) uniform usampler3D u_PackedOcclusionMap; // occlusion cascade 0, LOD0 voxels
+layout(binding = 7) uniform usampler3D u_OcclusionCascade1;   // LOD2 voxels
+
+#include "occlusion_bricks.glinc"
 
 layout(binding = 3) uniform sampler2D u_MaterialPalette;
 
@@ -56,7 +61,8 @@ struct ChunkInstance
 	mat4 transformation;
 	uint64_t voxel_texture_handle;
 	ivec2 index;
-	int lod;
+	int lod; // finest LOD in use
+	uint region_lods; // 2 bits per 4x4 xz region, x fastest
 };
 
 layout(std430, binding = 0) readonly buffer InstanceData
@@ -64,10 +70,11 @@ layout(std430, binding = 0) readonly buffer InstanceData
 	ChunkInstance chunks[];
 };
 
-uniform mat4 u_ViewProjection;
-uniform vec3 u_CameraPosition;
+#include "camera.glinc"
+
 uniform vec2 u_ViewportDims;
 uniform ivec3 u_ChunkDimensions;
+uniform ivec2 u_OcclusionOriginChunk; // center chunk of the packed occlusion map
 
 float RayAABB_fast(vec3 ro, vec3 invrd, vec3 p0, vec3 p1)
 {
@@ -90,18 +97,14 @@ bool Approx(float a, float b)
 
 void RaymarchVoxelMesh(
 	vec3 rayOrigin, vec3 rayDirection, vec3 obbCenter,
-	usampler3D voxel_texture, int mip, ivec2 chunk_index,
+	usampler3D voxel_texture, uint region_lods, ivec2 chunk_index,
 	out int color, out vec3 normal, out float t, out ivec3 voxel
 )
 {
 	const float BaseVoxelScale = 0.1f;
 
-	mip = 0;
-	float voxelScale = BaseVoxelScale * exp2(mip);
-
-	// Bounding box
-	ivec3 mipDimensions = textureSize(voxel_texture, mip);
-	vec3 worldspaceExtents = (vec3(mipDimensions) * voxelScale) * 0.5f;
+	// Bounding box, same for every mip
+	vec3 worldspaceExtents = (vec3(textureSize(voxel_texture, 0)) * BaseVoxelScale) * 0.5f;
 	vec3 p0 = obbCenter - worldspaceExtents;
 	vec3 p1 = obbCenter + worldspaceExtents;
 
@@ -109,10 +112,15 @@ void RaymarchVoxelMesh(
 	vec3 invDirection = 1.0f / rayDirection;
 
 	float hit = RayAABB_fast(rayOrigin, invDirection, p0, p1);
+	vec3 entryWorldspace = rayOrigin + rayDirection * hit;
+
+	// march at the LOD of the region the ray enters through
+	ivec2 region = clamp(ivec2((entryWorldspace.xz - p0.xz) / (p1.xz - p0.xz) * 4.0f), ivec2(0), ivec2(3));
+	int mip = int((region_lods >> (2 * (region.y * 4 + region.x))) & 3u);
+	ivec3 mipDimensions = textureSize(voxel_texture, mip);
 
 	vec3 voxelsPerUnit = mipDimensions / (p1 - p0);
-	vec3 entry = ((rayOrigin + rayDirection * hit) - p0) * voxelsPerUnit;
-	vec3 entryWorldspace = rayOrigin + rayDirection * hit;	
+	vec3 entry = (entryWorldspace - p0) * voxelsPerUnit;
 
 	vec3 delta = abs(invDirection);
 	ivec3 pos = ivec3(clamp(floor(entry), vec3(0.0f), vec3(mipDimensions - 1)));
@@ -121,32 +129,50 @@ void RaymarchVoxelMesh(
 	int axis = 0;
 	int maxSteps = mipDimensions.x + mipDimensions.y + mipDimensions.z;
 
-	// cached packed voxel data
+	// cached brick
 	ivec3 base = ivec3(-1);
-	uint packed_block = 0u;
+	uvec2 brick = uvec2(0u);
+
+	// LOD0 marches through occlusion cascade 0 (3x3 chunks), LOD2 through cascade 1 (12x12 chunks)
+	// LOD1 and chunks outside the cascades read their own texture
+	int cascade = mip == 0 ? 0 : (mip == 2 ? 1 : -1);
+	int gridSize = cascade == 0 ? 3 : 12;
+	ivec2 occlusionChunk = chunk_index - u_OcclusionOriginChunk + gridSize / 2;
+	bool inOcclusionMap = cascade >= 0 && all(greaterThanEqual(occlusionChunk, ivec2(0))) && all(lessThan(occlusionChunk, ivec2(gridSize)));
+
+	// toroidal cascades, every chunk lives at slot index mod grid no matter where the origin is
+	ivec2 occlusionSlot = chunk_index - gridSize * ivec2(floor(vec2(chunk_index) / float(gridSize))); // % is undefined for negatives
+	ivec3 chunkVoxelOffset = ivec3(occlusionSlot.x * mipDimensions.x, 0, occlusionSlot.y * mipDimensions.z);
 
 	for (int i = 0; i < maxSteps; i++)
 	{
-		const int halfGridSize = 1;
-		ivec3 chunkVoxelOffset = ivec3
-		(
-			(chunk_index.x + halfGridSize) * u_ChunkDimensions.x,
-			0,
-			(chunk_index.y + halfGridSize) * u_ChunkDimensions.z
-		);
-
-		ivec3 occlusionRelPos = pos + chunkVoxelOffset;
-		ivec3 new_base = occlusionRelPos >> 1; // packed block
-		ivec3 local_pos = occlusionRelPos & 1; // voxel within packed block
-		if (any(notEqual(new_base, base)))
+		bool hit_solid;
+		if (inOcclusionMap)
 		{
-			// entered new block, fetch packed
-			packed_block = texelFetch(u_PackedOcclusionMap, new_base, 0).r;
-			base = new_base;
-		}
+			ivec3 occlusionRelPos = pos + chunkVoxelOffset;
+			ivec3 new_base = occlusionRelPos >> 2; // brick
+			if (any(notEqual(new_base, base)))
+			{
+				// entered new brick, fetch it
+				brick = cascade == 0 ? texelFetch(u_PackedOcclusionMap, new_base, 0).rg : texelFetch(u_OcclusionCascade1, new_base, 0).rg;
+				base = new_base;
+			}
 
-		uint bit_index = local_pos.x + (local_pos.y << 1) + (local_pos.z << 2);
-		bool hit_solid = ((packed_block >> bit_index) & 1u) != 0u;
+			// nothing in the whole brick, jump straight past it
+			if (IsBrickEmpty(brick))
+			{
+				SkipBrick(pos, tMax, delta, step, axis);
+				if (any(lessThan(pos, ivec3(0))) || any(greaterThanEqual(pos, mipDimensions)))
+					break;
+				continue;
+			}
+
+			hit_solid = TestBrickVoxel(brick, occlusionRelPos & 3);
+		}
+		else
+		{
+			hit_solid = texelFetch(voxel_texture, pos, mip).r != 0u;
+		}
 		if (hit_solid)
 		{
 			uint col = texelFetch(voxel_texture, pos, mip).r;
@@ -216,9 +242,8 @@ void main()
 	usampler3D voxel_texture = usampler3D(chunk_instance.voxel_texture_handle);
 	ivec2 chunk_index = chunk_instance.index;
 	vec3 chunk_center = vec3(chunk_instance.transformation[3]);
-	int mip = chunk_instance.lod;
 
-	RaymarchVoxelMesh(u_CameraPosition, cameraToPixel, chunk_center, voxel_texture, mip, chunk_index, colorIndex, normal, t, voxel);
+	RaymarchVoxelMesh(u_CameraPosition, cameraToPixel, chunk_center, voxel_texture, chunk_instance.region_lods, chunk_index, colorIndex, normal, t, voxel);
 
 	// hitpoint / depth
 	vec3 hitpoint = u_CameraPosition + cameraToPixel * t;
@@ -6,7 +6,8 @@
 
 layout(location = 0) in vec3 a_Position;
 
-uniform mat4 u_ViewProjection;
+#include "camera.glinc"
+
 out vec3 v_VertexWorldSpace;
 out flat int v_Instance;
 
@@ -56,8 +57,7 @@ layout(std430, binding = 0) readonly buffer InstanceData
 	ChunkInstance chunks[];
 };
 
-uniform mat4 u_ViewProjection;
-uniform vec3 u_CameraPosition;
+#include "camera.glinc"
 
 float RayAABB_fast(vec3 ro, vec3 invrd, vec3 p0, vec3 p1)
 {
@@ -3,7 +3,8 @@
 
 layout(location = 0) in vec3 a_Position;
 
-uniform mat4 u_ViewProjection;
+#include "camera.glinc"
+
 uniform mat4 u_Transformation;
 
 void main()
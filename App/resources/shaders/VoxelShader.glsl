@@ -3,7 +3,8 @@
 
 layout(location = 0) in vec3 a_Position;
 
-uniform mat4 u_ViewProjection;
+#include "camera.glinc"
+
 uniform mat4 u_Transformation;
 
 out vec3 o_VertexWorldSpace;
@@ -30,7 +31,8 @@ layout(binding = 2) uniform sampler2D u_DepthOcclusion;
 layout(binding = 3) uniform sampler2D u_MaterialPalette;
 layout(binding = 4) uniform sampler2D u_Texture;
 
-uniform vec3 u_CameraPosition;
+#include "camera.glinc"
+
 uniform vec2 u_ViewportDims;
 
 uniform int u_MaterialIndex;
@@ -39,8 +41,6 @@ uniform int u_MipLevel = 0;
 uniform vec3 u_OBBCenter;
 uniform mat4 u_OBBOrientation;
 
-uniform mat4 u_ViewProjection;
-
 uniform int u_TextureTileFactor = 1;
 
 float RayAABB(vec3 ro, vec3 rd, vec3 p0, vec3 p1)
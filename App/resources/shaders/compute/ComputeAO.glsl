@@ -1,8 +1,11 @@
 #version 450 core
 
-layout(local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+layout(local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = LOCAL_SIZE_Z) in; // defines from ComputeShader::create
 
+// occlusion cascades, 4x4x4 bit bricks, see OcclusionCascade in Terrain.h
 layout(binding = 0) uniform usampler3D u_ShadowMap;
+layout(binding = 7) uniform usampler3D u_OcclusionCascade1;
+layout(binding = 8) uniform usampler3D u_OcclusionCascade2;
 layout(binding = 1) uniform sampler2D u_BlueNoiseTexture;
 
 layout(binding = 2) uniform sampler2D u_Depth;
@@ -14,19 +17,19 @@ layout(binding = 5) uniform sampler2D u_PreviousNormal;
 layout(binding = 6) uniform sampler2D u_AORead;
 layout(r8, binding = 0) uniform writeonly image2D u_Output;
 
-uniform mat4 u_InverseView;
-uniform mat4 u_ViewProjection;
-uniform mat4 u_InverseProjection;
+#include "../camera.glinc"
+
 uniform mat4 u_PrevFrameViewProjection;
 uniform int u_FrameNumber;
 
-uniform vec3 u_CameraPos;
+uniform vec3 u_CascadeMin[3];         // world space min corner
+uniform ivec3 u_CascadeWrapOffset[3]; // toroidal addressing, in cascade voxels
 
-const float g_BaseVoxelScale = 0.1f;
-const float g_ShadowLODScales[3] = float[3](g_BaseVoxelScale, g_BaseVoxelScale * 2.0f, g_BaseVoxelScale * 4.0f);
+const int g_CascadeCount = 3;
+const float g_CascadeVoxelScales[3] = float[3](0.1f, 0.4f, 1.6f);
+const float g_AORayVoxels = AO_RAY_VOXELS; // ray length in voxels of the cascade, so AO gets wider with distance
 
-const int g_AORayTotalDistance = 16;
-const int g_AORayDistances[3] = int[3](3, 5, 8);
+#include "../occlusion_bricks.glinc"
 
 const float g_PI = 3.14159265358f;
 const float g_GoldenRatio = 1.61803398875f;
@@ -66,48 +69,93 @@ vec3 RandomDirectionOnHemisphere(vec3 normal, ivec2 pixel, int frame, int sample
 	return normalize(x * tangent + y * bitangent + z * normal);
 }
 
-bool IsVoxelOccluded(ivec3 cell, int mip_level)
+ivec3 GetCascadeBricks(int cascade)
 {
-	ivec3 block_pos = cell >> 1;
-	ivec3 local_pos = cell & 1;
+	if (cascade == 0)
+		return textureSize(u_ShadowMap, 0);
+	if (cascade == 1)
+		return textureSize(u_OcclusionCascade1, 0);
+	return textureSize(u_OcclusionCascade2, 0);
+}
 
-	int bit_index = local_pos.x + local_pos.y * 2 + local_pos.z * 4;
-	uint vpacked = texelFetch(u_ShadowMap, block_pos, mip_level).r;
+uvec2 FetchCascadeBrick(int cascade, ivec3 brick)
+{
+	if (cascade == 0)
+		return texelFetch(u_ShadowMap, brick, 0).rg;
+	if (cascade == 1)
+		return texelFetch(u_OcclusionCascade1, brick, 0).rg;
+	return texelFetch(u_OcclusionCascade2, brick, 0).rg;
+}
 
-	return ((vpacked >> bit_index) & 1u) != 0u;
+// cell is relative to the cascade's min corner, chunks sit at fixed slots so wrap it around
+ivec3 WrapCascadeCell(ivec3 cell, int cascade)
+{
+	return (cell + u_CascadeWrapOffset[cascade]) % (GetCascadeBricks(cascade) * 4);
 }
 
-bool RaycastShadowMapVariableFidelity(vec3 origin, vec3 direction, out float t, const int maxDistanceMeters, const int mipLevel)
+// finest cascade that contains position with room for a full AO ray around it, -1 if none
+int SelectCascade(vec3 position)
 {
-	const float PackFactor = 2.0f;
+	for (int cascade = 0; cascade < g_CascadeCount; cascade++)
+	{
+		float scale = g_CascadeVoxelScales[cascade];
+		float margin = g_AORayVoxels * 2.0f * scale;
 
-	const float voxelScale = g_ShadowLODScales[mipLevel];
+		vec2 extents = vec2(GetCascadeBricks(cascade).xz * 4) * scale;
+		vec2 local = position.xz - u_CascadeMin[cascade].xz;
+		if (all(greaterThanEqual(local, vec2(margin))) && all(lessThanEqual(local, extents - margin)))
+			return cascade;
+	}
 
-	// Blocks
-	ivec3 mapDimensions = textureSize(u_ShadowMap, mipLevel);
+	return -1;
+}
 
-	vec3 worldspaceExtents = (mapDimensions * PackFactor * voxelScale) / 2.0f;
-	vec3 boundsMin = -worldspaceExtents;
+bool RaycastOcclusionCascade(vec3 origin, vec3 direction, out float t, float maxDistanceMeters, int cascade)
+{
+	const float voxelScale = g_CascadeVoxelScales[cascade];
+
+	// Voxels
+	ivec3 mapDimensions = GetCascadeBricks(cascade) * 4;
+	vec3 boundsMin = u_CascadeMin[cascade];
 
 	vec3 voxelsPerUnit = vec3(1.0f / voxelScale);
 	vec3 entry = (origin - boundsMin) * voxelsPerUnit;
 
 	// early exit
-	if (any(lessThan(entry, vec3(0))) || any(greaterThanEqual(entry, vec3(mapDimensions * PackFactor)))) {
-		t = float(maxDistanceMeters);
+	if (any(lessThan(entry, vec3(0))) || any(greaterThanEqual(entry, vec3(mapDimensions)))) {
+		t = maxDistanceMeters;
 		return false;
 	}
 
 	vec3 step = sign(direction);
 	vec3 delta = abs(1.0f / direction);
-	ivec3 pos = ivec3(clamp(floor(entry), vec3(0.0f), vec3(mapDimensions * PackFactor - 1)));
+	ivec3 pos = ivec3(clamp(floor(entry), vec3(0.0f), vec3(mapDimensions - 1)));
 	vec3 tMax = (vec3(pos) - entry + max(step, 0.0)) / direction;
 
 	int maxSteps = int(maxDistanceMeters / voxelScale);
+	float maxDistanceVoxels = maxDistanceMeters / voxelScale;
 	ivec3 iStep = ivec3(step);
 
+	// cached brick, bricks never straddle the wrap seam so the cache key can be the unwrapped brick
+	ivec3 cachedBrick = ivec3(-1);
+	uvec2 brick = uvec2(0u);
+
 	for (int i = 0; i < maxSteps; i++) {
-		if (IsVoxelOccluded(pos, 0)) {
+		if (any(notEqual(pos >> 2, cachedBrick))) {
+			cachedBrick = pos >> 2;
+			brick = FetchCascadeBrick(cascade, WrapCascadeCell(pos, cascade) >> 2);
+		}
+
+		// empty brick, skip it as a whole
+		if (IsBrickEmpty(brick)) {
+			int skipAxis;
+			SkipBrick(pos, tMax, delta, iStep, skipAxis);
+			if (any(lessThan(pos, ivec3(0))) || any(greaterThanEqual(pos, mapDimensions)) || tMax[skipAxis] - delta[skipAxis] > maxDistanceVoxels)
+				break;
+			continue;
+		}
+
+		if (TestBrickVoxel(brick, WrapCascadeCell(pos, cascade) & 3)) {
 			// Find which axis we just crossed
 			int axis = (tMax.x < tMax.y) ? ((tMax.x < tMax.z) ? 0 : 2) : ((tMax.y < tMax.z) ? 1 : 2);
 			t = (tMax[axis] - delta[axis]) * voxelScale;
@@ -122,40 +170,25 @@ bool RaycastShadowMapVariableFidelity(vec3 origin, vec3 direction, out float t,
 		tMax += vec3(mask) * delta;
 
 		// exit map?? :(
-		if (any(lessThan(pos, ivec3(0))) || any(greaterThanEqual(pos, mapDimensions * PackFactor))) {
+		if (any(lessThan(pos, ivec3(0))) || any(greaterThanEqual(pos, mapDimensions))) {
 			break;
 		}
 	}
 
-	t = float(maxDistanceMeters);
+	t = maxDistanceMeters;
 	return false;
 }
 
-float CastAmbientOcclusionRay(vec3 origin, vec3 direction)
+float CastAmbientOcclusionRay(vec3 origin, vec3 normal, vec3 direction, int cascade)
 {
-	vec3 rayOrigin = origin;
-	float totalTraveled = 0.0f;
+	float voxelScale = g_CascadeVoxelScales[cascade];
+	float maxDistance = g_AORayVoxels * voxelScale;
 	float t;
 
-	const int LOD0Dist = 1;
-
-	// LOD 0
-	rayOrigin = origin + direction * g_ShadowLODScales[0];
-	bool hit = RaycastShadowMapVariableFidelity(rayOrigin, direction, t, LOD0Dist, 0);
-	return clamp(t / LOD0Dist, 0.0f, 1.0f);
-
-	//for (int lod = 0; lod < 3; lod++) {
-	//	rayOrigin = origin + direction * ((totalTraveled + float(lod == 0)) * 1.01f * g_ShadowLODScales[lod] * 2.0f); // brless first mip offset
-	//
-	//	bool hit = RaycastShadowMapVariableFidelity(rayOrigin, direction, t, g_AORayDistances[lod], lod);
-	//	totalTraveled += t;
-	//
-	//	if (hit) {
-	//		return clamp(totalTraveled / g_AORayTotalDistance, 0.0, 1.0);
-	//	}
-	//} 
-	//
-	//return 1.0f; // no hit br
+	// coarse voxels swallow the surface they were packed from, start a voxel above it
+	vec3 rayOrigin = origin + direction * voxelScale + normal * (cascade > 0 ? voxelScale : 0.0f);
+	bool hit = RaycastOcclusionCascade(rayOrigin, direction, t, maxDistance, cascade);
+	return clamp(t / maxDistance, 0.0f, 1.0f);
 }
 
 vec2 GetLastFrameUVFromThisFrameWorldPos(vec3 worldPos)
@@ -219,11 +252,9 @@ void main()
 	}
 	vec3 worldSpaceFragment = ReconstructWorldSpaceFromDepth(uv);
 
-	const float ao_cutoff_distance = 110.0f;
-	vec3 planar_cam = vec3(u_CameraPos.x, 0.0f, u_CameraPos.z);
-	vec3 planar_worldspace = vec3(worldSpaceFragment.x, 0.0f, worldSpaceFragment.z);
-	float cameraDistance = distance(planar_worldspace, planar_cam);
-	if (cameraDistance > ao_cutoff_distance) // cut dat out br
+	// cascades are centered on the camera, so this picks by distance
+	int cascade = SelectCascade(worldSpaceFragment);
+	if (cascade < 0) // cut dat out br
 	{
 		imageStore(u_Output, pixel, vec4(0.0f));
 		return;
@@ -232,11 +263,11 @@ void main()
 	vec3 normal = texture(u_Normal, uv).xyz;
 
 	float this_frame_ao = 0.0f;
-	const int AmbientOcclusionRaysPerPixel = 2;
+	const int AmbientOcclusionRaysPerPixel = AO_RAYS_PER_PIXEL; // quality preset, compile time so the loop unrolls
 	for (int i = 0; i < AmbientOcclusionRaysPerPixel; i++)
 	{
 		vec3 direction = RandomDirectionOnHemisphere(normal, pixel, u_FrameNumber, i);
-		float norm = CastAmbientOcclusionRay(worldSpaceFragment, direction);
+		float norm = CastAmbientOcclusionRay(worldSpaceFragment, normal, direction, cascade);
 
 		this_frame_ao += norm;
 	}
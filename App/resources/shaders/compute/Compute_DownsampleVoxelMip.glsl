@@ -0,0 +1,47 @@
+#version 450 core
+
+// builds a voxel mip from the next finer one, see VoxelMips.h (keep the rules in sync with reduce_children)
+
+layout(local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = LOCAL_SIZE_Z) in; // defines from ComputeShader::create
+
+layout(binding = 0, r8ui) uniform readonly uimage3D u_ReadMip;
+layout(binding = 1, r8ui) uniform writeonly uimage3D u_WriteMip;
+
+uniform int u_ReductionRule; // 0 any solid, 1 majority
+
+void main()
+{
+	ivec3 texel = ivec3(gl_GlobalInvocationID.xyz);
+	if (any(greaterThanEqual(texel, imageSize(u_WriteMip))))
+		return;
+
+	// x fastest, then y, then z - ties go to the first child
+	uint children[8];
+	ivec3 read_base = texel * 2;
+	for (int i = 0; i < 8; i++)
+		children[i] = imageLoad(u_ReadMip, read_base + ivec3(i & 1, (i >> 1) & 1, i >> 2)).r;
+
+	uint solid = 0u;
+	uint material = 0u;
+	uint material_count = 0u;
+	for (int i = 0; i < 8; i++)
+	{
+		if (children[i] == 0u)
+			continue;
+
+		solid++;
+
+		uint count = 0u;
+		for (int j = 0; j < 8; j++)
+			count += children[j] == children[i] ? 1u : 0u;
+
+		if (count > material_count)
+		{
+			material = children[i];
+			material_count = count;
+		}
+	}
+
+	bool keep = u_ReductionRule == 0 ? solid > 0u : solid >= 4u;
+	imageStore(u_WriteMip, texel, uvec4(keep ? material : 0u));
+}
\ No newline at end of file
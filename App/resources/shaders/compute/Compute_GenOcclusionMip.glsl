@@ -2,30 +2,60 @@
 
 #extension GL_ARB_bindless_texture : enable
 
-layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+// next coarser occlusion mip, a voxel is solid if any of its 2x2x2 children is
+// one invocation per output brick, which covers 2x2x2 bricks of the finer mip
 
-layout(binding = 0, r8ui) uniform readonly uimage3D u_ReadMip;
-layout(binding = 1, r8ui) uniform writeonly uimage3D u_WriteMip;
+layout(local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = LOCAL_SIZE_Z) in; // defines from ComputeShader::create
+
+layout(binding = 0, rg32ui) uniform readonly uimage3D u_ReadMip;
+layout(binding = 1, rg32ui) uniform writeonly uimage3D u_WriteMip;
+
+uniform ivec3 u_WriteOffset; // only a region gets rebuilt when the cascades scroll
+uniform ivec3 u_WriteSize;
+
+bool TestBit(uvec2 brick, ivec3 local)
+{
+	int bit = local.x + (local.y << 2) + (local.z << 4);
+	return (((bit < 32 ? brick.x : brick.y) >> (bit & 31)) & 1u) != 0u;
+}
 
 void main()
 {
-	ivec3 texel = ivec3(gl_GlobalInvocationID.xyz);
-	ivec3 write_dims = imageSize(u_WriteMip);
+	if (any(greaterThanEqual(ivec3(gl_GlobalInvocationID.xyz), u_WriteSize)))
+		return;
 
+	ivec3 texel = u_WriteOffset + ivec3(gl_GlobalInvocationID.xyz);
 	ivec3 read_dims = imageSize(u_ReadMip);
-	ivec3 read_base = texel * 2;
 
-	uint has_voxels = 0u;
-	for (int x = 0; x < 2; x++)
-	for (int y = 0; y < 2; y++)
-	for (int z = 0; z < 2; z++)
+	uvec2 children[8];
+	for (int i = 0; i < 8; i++)
 	{
-		ivec3 read_pos = read_base + ivec3(x, y, z);
+		ivec3 read_pos = texel * 2 + ivec3(i & 1, (i >> 1) & 1, i >> 2);
+		children[i] = all(lessThan(read_pos, read_dims)) ? imageLoad(u_ReadMip, read_pos).rg : uvec2(0u);
+	}
 
-		uint data = imageLoad(u_ReadMip, read_pos).r;
-		if (data != 0u)
-			has_voxels = 1u;
+	uvec2 bits = uvec2(0u);
+	for (int bit = 0; bit < 64; bit++)
+	{
+		ivec3 out_voxel = ivec3(bit & 3, (bit >> 2) & 3, bit >> 4);
+
+		// the 2x2x2 children of this voxel all sit in the same finer brick
+		ivec3 child_voxel = out_voxel * 2;
+		ivec3 child_brick = child_voxel >> 2;
+		uvec2 child = children[child_brick.x + child_brick.y * 2 + child_brick.z * 4];
+
+		bool solid = false;
+		for (int c = 0; c < 8; c++)
+			solid = solid || TestBit(child, (child_voxel & 3) + ivec3(c & 1, (c >> 1) & 1, c >> 2));
+
+		if (solid)
+		{
+			if (bit < 32)
+				bits.x |= 1u << bit;
+			else
+				bits.y |= 1u << (bit - 32);
+		}
 	}
 
-	imageStore(u_WriteMip, texel, uvec4(has_voxels == 0u ? 0 : 125));
+	imageStore(u_WriteMip, texel, uvec4(bits, 0u, 0u));
 }
\ No newline at end of file
@@ -2,66 +2,69 @@
 
 #extension GL_ARB_bindless_texture : enable
 
-layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+layout(local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = LOCAL_SIZE_Z) in; // defines from ComputeShader::create
 
-layout(binding = 0, r8ui) uniform writeonly uimage3D u_ShadowMap;
-layout(binding = 1, bindless_sampler) uniform usampler3D u_ChunkHandles[9];
+layout(binding = 0, rg32ui) uniform writeonly uimage3D u_ShadowMap;
+layout(binding = 1, bindless_sampler) uniform usampler3D u_ChunkHandle;
 
-uniform ivec3 u_ChunkDimensions;
-uniform vec3 u_CenterChunkPosition;
+// the cascades are toroidal: every chunk has a fixed slot (index mod grid), only slots whose chunk changed get rebuilt
+uniform ivec3 u_ChunkDimensions; // one chunk in cascade voxels
+uniform ivec3 u_SlotBrickOffset; // first brick of the slot in the cascade
+uniform int u_HasChunk;          // chunks without the source LOD are treated as empty
+uniform ivec3 u_RegionBrickOffset; // edits only rebuild part of a slot
+uniform ivec3 u_RegionBricks;
 
-uniform int u_ChunkCount;
+uniform int u_SourceMip;    // chunk LOD the cascade is packed from
+uniform int u_SourceStride; // source voxels per cascade voxel along each axis
 
-void main()
+bool IsSolid(ivec3 cascade_voxel)
 {
-	const int PackFactor = 2;
-	ivec3 block = ivec3(gl_GlobalInvocationID.xyz);
+	ivec3 base = cascade_voxel * u_SourceStride;
+	for (int z = 0; z < u_SourceStride; z++)
+	for (int y = 0; y < u_SourceStride; y++)
+	for (int x = 0; x < u_SourceStride; x++)
+	{
+		if (texelFetch(u_ChunkHandle, base + ivec3(x, y, z), u_SourceMip).r != 0u)
+			return true;
+	}
 
-	const int GridSize = 3;
-	ivec3 total_voxels = ivec3(
-		u_ChunkDimensions.x * GridSize,
-		u_ChunkDimensions.y,
-		u_ChunkDimensions.z * GridSize
-	);
+	return false;
+}
+
+// one invocation per 4x4x4 brick, bit x + y * 4 + z * 16 (see occlusion_bricks.glinc)
+void main()
+{
+	const int BrickSize = 4;
+	ivec3 slot_bricks = (u_ChunkDimensions + BrickSize - 1) / BrickSize;
 
-	ivec3 total_blocks = ivec3(
-		(total_voxels.x + PackFactor - 1) / PackFactor,
-		(total_voxels.y + PackFactor - 1) / PackFactor,
-		(total_voxels.z + PackFactor - 1) / PackFactor
-	);
+	// bounds test in brick-space
+	if (any(greaterThanEqual(ivec3(gl_GlobalInvocationID.xyz), u_RegionBricks)))
+		return;
 
-	// bounds test in block-space
-	if (any(greaterThanEqual(block, total_blocks)))
+	ivec3 brick = u_RegionBrickOffset + ivec3(gl_GlobalInvocationID.xyz);
+	if (any(greaterThanEqual(brick, slot_bricks)))
 		return;
 
-	uint packed_data = 0u;
-	for (int x = 0; x < 2; x++)
-	for (int y = 0; y < 2; y++)
-	for (int z = 0; z < 2; z++)
+	uvec2 bits = uvec2(0u);
+	if (u_HasChunk != 0)
 	{
+		for (int z = 0; z < BrickSize; z++)
+		for (int y = 0; y < BrickSize; y++)
+		for (int x = 0; x < BrickSize; x++)
+		{
+			ivec3 local_voxel = brick * BrickSize + ivec3(x, y, z);
+			if (any(greaterThanEqual(local_voxel, u_ChunkDimensions)))
+				continue;
 
-		ivec3 voxel_pos = block * PackFactor + ivec3(x, y, z);
-		if (any(lessThan(voxel_pos, ivec3(0))) || any(greaterThanEqual(voxel_pos, total_voxels)))
-			continue;
-
-		ivec2 chunk_index2D = ivec2(
-			voxel_pos.x / u_ChunkDimensions.x,
-			voxel_pos.z / u_ChunkDimensions.z
-		);
-		int chunk_index = chunk_index2D.y * GridSize + chunk_index2D.x;
-
-		ivec3 local_voxel = ivec3(
-			voxel_pos.x % u_ChunkDimensions.x,
-			voxel_pos.y,
-			voxel_pos.z % u_ChunkDimensions.z
-		);
-	
-		uint voxel = texelFetch(u_ChunkHandles[chunk_index], local_voxel, 0).r;
-		if (voxel != 0u) {
-			int	bit_index = x + (y << 1) + (z << 2);
-			packed_data |= (1u << bit_index);
+			if (IsSolid(local_voxel)) {
+				int bit_index = x + (y << 2) + (z << 4);
+				if (bit_index < 32)
+					bits.x |= 1u << bit_index;
+				else
+					bits.y |= 1u << (bit_index - 32);
+			}
 		}
 	}
 	
-	imageStore(u_ShadowMap, block, uvec4(packed_data));
+	imageStore(u_ShadowMap, u_SlotBrickOffset + brick, uvec4(bits, 0u, 0u));
 }
\ No newline at end of file
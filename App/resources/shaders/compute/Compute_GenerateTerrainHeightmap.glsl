@@ -0,0 +1,34 @@
+#version 450 core
+
+// heightfield variant of Compute_GenerateTerrain.glsl
+// one invocation per (x, z) column evaluates the fBm once and fills the whole column
+
+layout(local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = LOCAL_SIZE_Z) in; // defines from ComputeShader::create
+
+layout(binding = 0, r8ui) uniform writeonly uimage3D u_ChunkTexture;
+
+uniform ivec3 u_ChunkDimensions;
+uniform vec3 u_ChunkPositionWorld;
+
+uniform int u_MipLevel;
+
+#include "terrain_noise.glinc"
+
+void main()
+{
+	ivec2 column = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(column, u_ChunkDimensions.xz)))
+		return;
+
+	float voxelScale = 0.1f * exp2(u_MipLevel);
+
+	// 2D fBm: the 3D noise on the chunk's base plane
+	vec3 p = vec3(column.x * voxelScale, 0.0f, column.y * voxelScale) + u_ChunkPositionWorld;
+	float height_sample = clamp(GetSimplexHeightMapValue(p) * 0.5f + 0.5f, 0.0f, 1.0f);
+
+	int voxel_height = int(height_sample * u_ChunkDimensions.y - 1);
+
+	uint c = u_MipLevel == 0 ? 127 : (u_MipLevel == 1 ? 100 : 40);
+	for (int y = 0; y < u_ChunkDimensions.y; y++)
+		imageStore(u_ChunkTexture, ivec3(column.x, y, column.y), uvec4(y < voxel_height ? c : 0u));
+}
\ No newline at end of file
@@ -5,12 +5,18 @@
 #include "rendering/Shader.h"
 #include "rendering/scene/SceneRenderer.h"
 #include "rendering/RenderPipeline.h"
+#include "rendering/StagingRing.h"
+#include "rendering/ProgramCache.h"
+#include "utils/FileWatcher.h"
 
 #include "windowing/Window.h"
 
 #include "voxel/Terrain.h"
+#include "threading/JobSystem.h"
 
 #include "gui/Font.h"
+
+#include <chrono>
  
 using namespace Engine;
 
@@ -37,7 +43,8 @@ static owning_ptr<Shader> Shader_NoFragment;
 static owning_ptr<Shader> SpriteShader;
 static owning_ptr<Shader> TextShader;
 
-static owning_ptr<ComputeShader> ComputeAOShader;
+static ComputeShader* ComputeAOShader = nullptr; // owned by the variant cache
+static ComputeShader* s_NextAOShader = nullptr;   // preset switch, swapped in once it's built
 static owning_ptr<ComputeShader> Compute_BlitShader;
 
 static owning_ptr<Font> s_Font;
@@ -54,9 +61,34 @@ static owning_ptr<Texture2D> crosshair;
 static owning_ptr<Texture2D> testTexture;
 
 static owning_ptr<TerrainGenerator> s_TerrainGen;
+static owning_ptr<FileWatcher> s_ShaderWatcher;
+static std::chrono::high_resolution_clock::time_point s_ShaderBuildStart;
+static bool s_ShaderBuildReported = false;
 
 static Matrix4 s_PreviousViewProjection = Matrix4(1.0f);
 
+// compile time quality knobs, every preset is its own specialised program
+struct QualityPreset
+{
+	const char* Name;
+	int32_t AORaysPerPixel;
+	float AORayVoxels;
+};
+
+static constexpr QualityPreset QualityPresets[] = {
+	{ "low", 1, 6.0f },
+	{ "medium", 2, 10.0f },
+	{ "high", 4, 14.0f },
+};
+static uint32_t s_QualityPreset = 1;
+
+static ComputeShader* get_ao_shader(const QualityPreset& preset)
+{
+	ShaderDefines defines = { { "LOCAL_SIZE_X", 16 }, { "LOCAL_SIZE_Y", 16 }, { "AO_RAYS_PER_PIXEL", preset.AORaysPerPixel } };
+	defines.set("AO_RAY_VOXELS", preset.AORayVoxels);
+	return ComputeShader::get_variant("resources/shaders/compute/ComputeAO.glsl", defines);
+}
+
 static void create_framebuffer(uint32_t screen_width, uint32_t screen_height)
 {
 	// Create framebuffer
@@ -87,29 +119,39 @@ static void create_framebuffer(uint32_t screen_width, uint32_t screen_height)
 	s_Framebuffer->m_ColorAttachments[4]->clear_to(&v);
 }
 
-static void reload_all_shaders()
+// everything builds in the background, passes are skipped until their shader is in
+static void load_shaders()
 {
-	LightShader = Shader::create("resources/shaders/LightShader.glsl");
+	LightShader = Shader::create_async("resources/shaders/LightShader.glsl");
 	rp_Lighting.pShader = LightShader.get();
-	DefaultMeshShader = Shader::create("resources/shaders/DefaultShader.glsl");
+	DefaultMeshShader = Shader::create_async("resources/shaders/DefaultShader.glsl");
 	rp_DebugGeometry.pShader = DefaultMeshShader.get();
-	SceneRenderer::s_VoxelMeshShader = Shader::create("resources/shaders/VoxelShader.glsl");
+	SceneRenderer::s_VoxelMeshShader = Shader::create_async("resources/shaders/VoxelShader.glsl");
 	rp_Geometry.pShader = SceneRenderer::s_VoxelMeshShader.get();
-	Shader_NoFragment = Shader::create("resources/shaders/VertexOnlyShader.glsl");
+	Shader_NoFragment = Shader::create_async("resources/shaders/VertexOnlyShader.glsl");
 	rp_Stencil.pShader = Shader_NoFragment.get();
-	CompositeShader = Shader::create("resources/shaders/CompositeShader.glsl");
+	CompositeShader = Shader::create_async("resources/shaders/CompositeShader.glsl");
 	rp_Composite.pShader = CompositeShader.get();
-	DepthAndNormal_BlitShader = Shader::create("resources/shaders/BlitShader.glsl");
+	DepthAndNormal_BlitShader = Shader::create_async("resources/shaders/BlitShader.glsl");
 	rp_Blit.pShader = DepthAndNormal_BlitShader.get();
-	SpriteShader = Shader::create("resources/shaders/SpriteShader.glsl");
-	TextShader = Shader::create("resources/shaders/TextShader.glsl");
+	SpriteShader = Shader::create_async("resources/shaders/SpriteShader.glsl");
+	TextShader = Shader::create_async("resources/shaders/TextShader.glsl");
 
-	ComputeAOShader = ComputeShader::create("resources/shaders/compute/ComputeAO.glsl");
-	Compute_BlitShader = ComputeShader::create("resources/shaders/compute/Compute_Blit.glsl");
+	ComputeAOShader = get_ao_shader(QualityPresets[s_QualityPreset]);
+	Compute_BlitShader = ComputeShader::create_async("resources/shaders/compute/Compute_Blit.glsl");
 }
 
 static void init_renderpass()
 {
+	rp_Geometry.Name = "GeometryPass";
+	rp_Stencil.Name = "StencilPass";
+	rp_Lighting.Name = "LightingPass";
+	rp_AmbientOcclusion.Name = "AmbientOcclusionPass";
+	rp_Composite.Name = "CompositePass";
+	rp_Blit.Name = "BlitPass";
+	rp_DebugGeometry.Name = "DebugGeometryPass";
+	rp_ScreenspaceUI.Name = "ScreenspaceUIPass";
+
 	rp_Geometry.Depth.Write = true;
 	rp_Geometry.Depth.Test = DepthTest::GreaterEq;
 
@@ -170,26 +212,27 @@ void testbed_start(App& app)
 	cameraController.m_TargetEuler = { -30.0f, 0.0f, 0.0f };
 
 	create_framebuffer(window->get_width(), window->get_height());
-	reload_all_shaders();
+
+	// the terrain generator builds its own programs, count those too. reported once the last one is in
+	s_ShaderBuildStart = std::chrono::high_resolution_clock::now();
+	ProgramCache::init("cache/programs");
+	load_shaders();
 	init_renderpass();
 
 	s_TerrainGen = make_owning<TerrainGenerator>();
+	s_ShaderWatcher = FileWatcher::create("resources/shaders");
+	s_TerrainGen->set_chunk_cache(make_owning<ChunkCache>("cache/terrain"));
 	 
-#define NUM_CHUNKS 9
-
-#if NUM_CHUNKS == 1
-	s_TerrainGen->generate_chunk({});
-#else
-	int dim = glm::sqrt(NUM_CHUNKS);
-	for (int x = 0; x < dim; x++)
-	for (int y = 0; y < dim; y++)
-	{
-		Int2 idx = { x - dim / 2, y - dim / 2 };
-		s_TerrainGen->generate_chunk(idx);
-	}
-#endif
-	s_TerrainGen->resort_chunks({});
-	s_TerrainGen->generate_shadowmap({});
+	// stream in everything around the start position before the first frame
+	auto generationStart = std::chrono::high_resolution_clock::now();
+	Float3 startPosition = cameraController.m_TargetPosition;
+	s_TerrainGen->update_streaming(startPosition, 0.0f);
+	s_TerrainGen->wait_for_pending_chunks();
+	s_TerrainGen->update_streaming(startPosition, 0.0f);
+	std::chrono::duration<float, std::milli> generationTime = std::chrono::high_resolution_clock::now() - generationStart;
+	LOG("generated {} chunks in {:.2f}ms ({} workers)", s_TerrainGen->m_ChunkTable.size(), generationTime.count(), JobSystem::get_worker_count());
+	s_TerrainGen->get_chunk_cache()->log_stats();
+	StagingRing::log_stats();
 
 	blueNoise = Texture2D::load("resources/textures/blue_noise_512.png");
 	blueNoise->set_wrap_mode(TextureWrapMode::Repeat);
@@ -222,7 +265,7 @@ static void handle_scene_view_ray_trace(const Transformation& camera)
 		glm::cos(pitch) * -glm::cos(yaw)
 	);
 
-	sceneCameraRay = SceneRenderer::trace_ray_through_scene(origin, direction, MaxDistanceMeters);
+	sceneCameraRay = s_TerrainGen->get_voxel_query().raycast(origin, direction, MaxDistanceMeters);
 }
 
 static Float3 get_highlighted_voxel_center()
@@ -234,7 +277,7 @@ static Float3 get_highlighted_voxel_center()
 
 static void draw_shadow_map(uint32_t level)
 {
-	auto& texture = s_TerrainGen->m_ShadowMap;
+	Texture3D* texture = s_TerrainGen->get_shadowmap();
 	Int3 voxelDimensions = texture->get_dimensions();
 
 	Matrix4 rotation = Matrix4(1.0f);
@@ -265,11 +308,20 @@ void testbed_update(App& app)
 	float elapsedTime = app.get_elapsed_time();
 	uint32_t frameNumber = (uint32_t)app.get_frame();
 
+	if (!s_ShaderBuildReported && Shader::get_pending_build_count() == 0)
+	{
+		std::chrono::duration<float, std::milli> shaderTime = std::chrono::high_resolution_clock::now() - s_ShaderBuildStart;
+		LOG("all shaders ready {:.2f}ms into start-up ({} start)", shaderTime.count(), ProgramCache::get_stats().misses == 0 ? "warm" : "cold");
+		ProgramCache::log_stats();
+		s_ShaderBuildReported = true;
+	}
+
 	cameraController.update(deltaTime);
+	s_TerrainGen->set_lod_view(camera, cameraController.get_transform().Position, viewport.y);
+	s_TerrainGen->update_streaming(cameraController.get_transform().Position, deltaTime);
 
 	Matrix4 view = cameraController.get_view();
 	Matrix4 projection = camera.get_projection();
-	Matrix4 viewProjection = projection * view;
 
 	// SSBO ORDER DETERMINES INSTANCE DRAW ORDER
 	// DEPTH CULLING BASICALLY ALREADY HAPPENS WTF WAS DAT FOR
@@ -280,15 +332,72 @@ void testbed_update(App& app)
 	s_Framebuffer->clear({ 0.0f });
 	SceneRenderer::begin_frame(camera, cameraController.get_transform());
 
-	// hot reload
+	// hot reload, in place: saving a file rebuilds only the programs including it, ctrl+R rebuilds everything
+	uint32_t reloadedShaders = 0;
 	if (Input::was_key_pressed(Key::R) && Input::is_key_down(Key::Control))
+		reloadedShaders = Shader::reload_all();
+	else if (s_ShaderWatcher)
+		reloadedShaders = Shader::reload_changed(s_ShaderWatcher->poll());
+
+	if (reloadedShaders > 0)
 	{
-		reload_all_shaders();
-		s_TerrainGen->m_TerrainShader = Shader::create("resources/shaders/TerrainShader.glsl");
-		s_TerrainGen->generate_shadowmap({});
+		s_TerrainGen->invalidate_shadowmap();
+		s_TerrainGen->generate_shadowmap(s_TerrainGen->get_shadowmap_origin());
 	}
 	handle_scene_view_ray_trace(cameraController.get_transform());
 
+	// terrain generation: F5 benchmarks both modes, ctrl+F5 switches the mode for newly generated chunks
+	if (Input::was_key_pressed(Key::F5))
+	{
+		if (Input::is_key_down(Key::Control))
+		{
+			bool heightmap = s_TerrainGen->get_generation_mode() == TerrainGenerationMode::Heightmap;
+			s_TerrainGen->set_generation_mode(heightmap ? TerrainGenerationMode::Volume : TerrainGenerationMode::Heightmap);
+			LOG("terrain generation mode: {}", heightmap ? "volume" : "heightmap");
+		}
+		else
+		{
+			for (uint32_t lod = 0; lod < TerrainChunk::LODCount; lod++)
+				s_TerrainGen->benchmark_generation(lod);
+		}
+	}
+
+	if (Input::was_key_pressed(Key::F6))
+		s_TerrainGen->benchmark_occlusion_formats();
+
+	// line of sight sized rays around the camera
+	if (Input::was_key_pressed(Key::F7))
+		s_TerrainGen->get_voxel_query().benchmark_raycasts(cameraController.get_transform().Position, 1 << 18, 64.0f);
+
+	// F9 cycles the quality presets, the old variant keeps rendering until the new one is built
+	if (Input::was_key_pressed(Key::F9))
+	{
+		s_QualityPreset = (s_QualityPreset + 1) % std::size(QualityPresets);
+		s_NextAOShader = get_ao_shader(QualityPresets[s_QualityPreset]);
+	}
+
+	if (s_NextAOShader && s_NextAOShader->is_ready())
+	{
+		ComputeAOShader = s_NextAOShader;
+		s_NextAOShader = nullptr;
+		LOG("quality preset: {}", QualityPresets[s_QualityPreset].Name);
+	}
+
+	// F8 dumps the profiler rings, open in chrome://tracing or ui.perfetto.dev
+	if (Input::was_key_pressed(Key::F8))
+		Profiler::write_chrome_trace("profile_trace.json");
+
+	// X blasts a 1m crater where the camera ray hits
+	if (Input::was_key_pressed(Key::X) && sceneCameraRay.hit)
+	{
+		uint32_t changed = s_TerrainGen->set_voxels(VoxelSphere{ sceneCameraRay.hitpoint, 1.0f }, 0);
+		s_TerrainGen->flush_voxel_edits();
+
+		const VoxelEditStats& stats = s_TerrainGen->get_voxel_edit_stats();
+		LOG("crater: {} voxels changed, flushed in {:.3f}ms ({} bricks, {}KB uploaded so far)",
+			changed, stats.last_flush_ms, stats.bricks_uploaded, stats.bytes_uploaded / 1024);
+	}
+
 	Float3 cameraPosition = cameraController.get_transform().Position;
 
 	// GEOMETRY PASS
@@ -298,7 +407,10 @@ void testbed_update(App& app)
 		if (Input::was_key_pressed(Key::UpArrow))
 		{
 			level = glm::max(--level, 0);
-			s_TerrainGen->generate_chunk_lod({}, level);
+
+			Int2 cameraChunk = TerrainGenerator::world_to_chunk_index(cameraPosition);
+			if (s_TerrainGen->m_ChunkTable.count(cameraChunk))
+				s_TerrainGen->generate_chunk_lod(cameraChunk, level);
 		}
 		if (Input::was_key_pressed(Key::DownArrow))
 		{
@@ -307,7 +419,7 @@ void testbed_update(App& app)
 		level = glm::clamp(level, 0, 2);
 
 		s_TerrainGen->m_TerrainShader->set("u_MipLevel", level);
-		s_TerrainGen->render_terrain(viewProjection, cameraPosition);
+		s_TerrainGen->render_terrain();
 	});
 
 	static Float3 lightPos = { -3.0f, 5.0f, 2.0f };
@@ -338,8 +450,6 @@ void testbed_update(App& app)
 
 			// Matrices
 			LightShader->set("u_Transformation", lightTransformation);
-			LightShader->set("u_InverseView", glm::inverse(view));
-			LightShader->set("u_InverseProjection", glm::inverse(projection));
 
 			LightShader->set("u_LightIntensity", intensity);
 			LightShader->set("u_LightRadius", radius);
@@ -351,7 +461,7 @@ void testbed_update(App& app)
 			LightShader->set("u_FrameNumber", frameNumber);
 			s_Framebuffer->m_DepthStencilAttachment->bind(0);
 			s_Framebuffer->m_ColorAttachments[1]->bind(2);
-			s_TerrainGen->m_ShadowMap->bind(1);
+			s_TerrainGen->get_shadowmap()->bind(1);
 			blueNoise->bind(9);
 
 			Graphics::draw_sphere(); // lighting volume mesh
@@ -369,12 +479,12 @@ void testbed_update(App& app)
 		s_Framebuffer->m_ColorAttachments[4]->clear_to(&v);
 	}
 
-	// COMPUTE AO
-	if (!ssao && show_ao)
+	// COMPUTE AO, skipped like any other pass until its program is built (the accumulation textures start out at 1)
+	if (!ssao && show_ao && ComputeAOShader->is_ready())
 	{
 		ComputeAOShader->bind();
 
-		s_TerrainGen->m_ShadowMap->bind(0);
+		s_TerrainGen->bind_occlusion_cascades(*ComputeAOShader);
 		blueNoise->bind(1);
 		s_Framebuffer->m_DepthStencilAttachment->bind(2);
 		s_Framebuffer->m_ColorAttachments[5]->bind(3);
@@ -397,19 +507,11 @@ void testbed_update(App& app)
 			fresh_ao_texture = write.get();
 		}
 
-		ComputeAOShader->set("u_InverseView", glm::inverse(view));
-		ComputeAOShader->set("u_InverseProjection", glm::inverse(projection));
+		// camera matrices come from the camera block bound in renderPipeline.begin
 		ComputeAOShader->set("u_PrevFrameViewProjection", s_PreviousViewProjection);
-		ComputeAOShader->set("u_ViewProjection", viewProjection);
 		ComputeAOShader->set("u_FrameNumber", frameNumber);
 
-		ComputeAOShader->set("u_CameraPos", cameraController.m_Transformation.Position);
-
-		uint32_t localSizeX = 16, localSizeY = 16;
-		ComputeAOShader->dispatch(
-			(viewport.x + localSizeX - 1) / localSizeX,
-			(viewport.y + localSizeY - 1) / localSizeY
-		);
+		ComputeAOShader->dispatch_threads((uint32_t)viewport.x, (uint32_t)viewport.y);
 		Graphics::memory_barrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 	}
 	
@@ -448,9 +550,6 @@ void testbed_update(App& app)
 			output = 4;
 
 		CompositeShader->set("u_Output", output);
-		CompositeShader->set("u_InverseView", glm::inverse(view));
-		CompositeShader->set("u_InverseProjection", glm::inverse(projection));
-		CompositeShader->set("u_CameraPos", cameraController.m_Transformation.Position);
 
 		Graphics::draw_fullscreen_triangle(CompositeShader);
 	});
@@ -539,6 +638,44 @@ void testbed_update(App& app)
 				Transformation({ 25.0f, viewport.y - 300.0f, 0.0f }, {}, { 40.0f, 40.0f, 1.0f }).get_transform());
 			Graphics::draw_text(std::format("({:.2f}, {:.2f}, {:.2f})", cell.x, cell.y, cell.z), s_Font);
 		}
+		// Streaming
+		{
+			float memoryMB = s_TerrainGen->get_loaded_chunk_memory() / (1024.0f * 1024.0f);
+			TextShader->set("u_Transformation",
+				Transformation({ 25.0f, viewport.y - 360.0f, 0.0f }, {}, { 40.0f, 40.0f, 1.0f }).get_transform());
+			Graphics::draw_text(std::format("chunks: {} (+{}) {:.0f}MB, lods queued: {}", s_TerrainGen->m_ChunkTable.size(),
+				s_TerrainGen->get_pending_chunk_count(), memoryMB, s_TerrainGen->get_queued_lod_count()), s_Font);
+		}
+		// Uploads
+		{
+			const StagingStats& staging = StagingRing::get_stats();
+			TextShader->set("u_Transformation",
+				Transformation({ 25.0f, viewport.y - 420.0f, 0.0f }, {}, { 40.0f, 40.0f, 1.0f }).get_transform());
+			Graphics::draw_text(std::format("uploads: {:.2f}MB/frame, {} stalls ({:.1f}ms)",
+				staging.last_frame_bytes / (1024.0f * 1024.0f), staging.stalls, staging.stall_ms), s_Font);
+		}
+		// GL state cache
+		{
+			const StateCacheStats& state = Graphics::get_state_stats();
+			TextShader->set("u_Transformation",
+				Transformation({ 25.0f, viewport.y - 480.0f, 0.0f }, {}, { 40.0f, 40.0f, 1.0f }).get_transform());
+			Graphics::draw_text(std::format("gl state: {} issued, {} filtered", state.get_issued(), state.get_filtered()), s_Font);
+		}
+		// Profiler, per pass breakdown of the newest frame the GPU timings are back for
+		{
+			TextShader->set("u_Transformation",
+				Transformation({ 25.0f, viewport.y - 540.0f, 0.0f }, {}, { 40.0f, 40.0f, 1.0f }).get_transform());
+			Graphics::draw_text(std::format("cpu: {:.2f}ms, gpu: {:.2f}ms", Profiler::get_frame_cpu_ms(), Profiler::get_frame_gpu_ms()), s_Font);
+
+			float y = viewport.y - 590.0f;
+			for (const ProfileZoneStats& zone : Profiler::get_frame_zones())
+			{
+				TextShader->set("u_Transformation",
+					Transformation({ 45.0f + zone.depth * 30.0f, y, 0.0f }, {}, { 30.0f, 30.0f, 1.0f }).get_transform());
+				Graphics::draw_text(std::format("{} x{}: gpu {:.3f}ms, cpu {:.3f}ms", zone.name, zone.count, zone.gpu_ms, zone.cpu_ms), s_Font);
+				y -= 40.0f;
+			}
+		}
 
 		// crosshair idfk
 		SpriteShader->bind();
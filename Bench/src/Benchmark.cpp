@@ -0,0 +1,109 @@
+#include "pch.h"
+
+#include "Benchmark.h"
+
+#include "threading/JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+using namespace Engine;
+
+static volatile uint64_t s_Sink = 0;
+
+void benchmark_sink(uint64_t value)
+{
+	s_Sink = s_Sink + value;
+}
+
+std::vector<BenchmarkResult> BenchmarkSuite::run(const std::string& filter, float iteration_scale) const
+{
+	std::vector<BenchmarkResult> results;
+	for (const Benchmark& benchmark : m_Benchmarks)
+	{
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+			continue;
+
+		for (uint32_t i = 0; i < benchmark.warmup; i++)
+		{
+			if (benchmark.setup)
+				benchmark.setup();
+			benchmark.run();
+		}
+
+		uint32_t iterations = glm::max(1u, (uint32_t)(benchmark.iterations * iteration_scale));
+		std::vector<double> times(iterations);
+		for (double& time : times)
+		{
+			if (benchmark.setup)
+				benchmark.setup();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			benchmark.run();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			time = elapsed.count();
+		}
+
+		std::sort(times.begin(), times.end());
+
+		BenchmarkResult result;
+		result.name = benchmark.name;
+		result.iterations = iterations;
+		result.items = benchmark.items;
+		result.min_ms = times.front();
+		result.median_ms = times.size() % 2 ? times[times.size() / 2] : (times[times.size() / 2 - 1] + times[times.size() / 2]) * 0.5;
+		// nearest rank, with few iterations this is just the max
+		result.p99_ms = times[(size_t)glm::ceil(times.size() * 0.99) - 1];
+		for (double time : times)
+			result.mean_ms += time / times.size();
+
+		if (result.items > 0.0)
+			LOG("{:<40} {:>10.3f}ms min {:>10.3f}ms median {:>10.3f}ms p99  {:.2f}M/s", result.name, result.min_ms, result.median_ms, result.p99_ms, result.get_items_per_second() / 1e6);
+		else
+			LOG("{:<40} {:>10.3f}ms min {:>10.3f}ms median {:>10.3f}ms p99", result.name, result.min_ms, result.median_ms, result.p99_ms);
+
+		results.push_back(std::move(result));
+	}
+
+	return results;
+}
+
+bool BenchmarkSuite::write_json(const std::filesystem::path& path, const std::vector<BenchmarkResult>& results)
+{
+	std::ofstream out(path, std::ios::out | std::ios::trunc);
+	if (!out)
+	{
+		LOG("bench: couldn't write '{}'", path.string());
+		return false;
+	}
+
+#ifdef ENGINE_DEBUG
+	const char* config = "Debug";
+#else
+	const char* config = "Release";
+#endif
+#ifdef __AVX2__
+	bool avx2 = true;
+#else
+	bool avx2 = false;
+#endif
+	auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	// names are plain identifiers, nothing needs escaping
+	out << "{\n";
+	out << std::format("\t\"config\": \"{}\",\n\t\"avx2\": {},\n\t\"workers\": {},\n\t\"timestamp\": {},\n", config, avx2, JobSystem::get_worker_count(), timestamp);
+	out << "\t\"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		out << std::format("\t\t{{ \"name\": \"{}\", \"iterations\": {}, \"min_ms\": {:.6f}, \"median_ms\": {:.6f}, \"p99_ms\": {:.6f}, \"mean_ms\": {:.6f}",
+			result.name, result.iterations, result.min_ms, result.median_ms, result.p99_ms, result.mean_ms);
+		if (result.items > 0.0)
+			out << std::format(", \"items\": {:.0f}, \"items_per_second\": {:.1f}", result.items, result.get_items_per_second());
+		out << (i + 1 < results.size() ? " },\n" : " }\n");
+	}
+	out << "\t]\n}\n";
+
+	return true;
+}
\ No newline at end of file
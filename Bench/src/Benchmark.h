@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+
+// one timed case, run warmup times untimed and then iterations times, each iteration timed on its own
+// setup runs before every iteration (warmup included) outside the timing, for state the benchmark consumes
+struct Benchmark
+{
+	std::string name;
+	uint32_t iterations = 10;
+	uint32_t warmup = 1;
+	double items = 0.0; // work per iteration (rays, lookups, voxels...), for throughput, 0 = not reported
+
+	std::function<void()> run = nullptr;
+	std::function<void()> setup = nullptr; // optional
+};
+
+struct BenchmarkResult
+{
+	std::string name;
+	uint32_t iterations = 0;
+	double items = 0.0;
+	double min_ms = 0.0, median_ms = 0.0, p99_ms = 0.0, mean_ms = 0.0;
+
+	double get_items_per_second() const { return items > 0.0 && median_ms > 0.0 ? items / (median_ms / 1000.0) : 0.0; }
+};
+
+class BenchmarkSuite
+{
+public:
+	void add(Benchmark benchmark) { m_Benchmarks.push_back(std::move(benchmark)); }
+
+	// only benchmarks with filter in their name (all if empty), iteration_scale multiplies every iteration count
+	std::vector<BenchmarkResult> run(const std::string& filter, float iteration_scale) const;
+
+	// {"config", "avx2", "workers", "timestamp", "benchmarks": [{"name", "iterations", "min_ms", "median_ms", "p99_ms", ...}]}
+	static bool write_json(const std::filesystem::path& path, const std::vector<BenchmarkResult>& results);
+private:
+	std::vector<Benchmark> m_Benchmarks;
+};
+
+// keeps results alive so the optimizer can't drop the work that produced them
+void benchmark_sink(uint64_t value);
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "pch.h"
+
+#include "Benchmark.h"
+
+#include "voxel/Terrain.h"
+#include "voxel/TerrainNoise.h"
+#include "voxel/OcclusionBricks.h"
+#include "voxel/VoxelQuery.h"
+#include "voxel/VoxelMesh.h"
+#include "rendering/Shader.h"
+#include "gui/Font.h"
+
+#include <memory>
+#include <random>
+
+using namespace Engine;
+
+static const Int3 ChunkDimensions = Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width);
+
+static owning_ptr<TerrainGenerator> s_TerrainGen;
+static owning_ptr<Font> s_Font;
+
+static std::shared_ptr<std::vector<uint8_t>> generate_chunk_voxels(Int2 chunk_index, uint32_t lod)
+{
+	Int3 dimensions = ChunkDimensions >> (int)lod;
+	auto voxels = std::make_shared<std::vector<uint8_t>>((size_t)dimensions.x * dimensions.y * dimensions.z);
+	generate_terrain_heightmap_cpu(voxels->data(), dimensions, TerrainGenerator::chunk_to_world_position(chunk_index), lod);
+	return voxels;
+}
+
+static void add_noise_benchmarks(BenchmarkSuite& suite)
+{
+	Int3 lod2 = ChunkDimensions >> 2;
+	auto voxels = std::make_shared<std::vector<uint8_t>>((size_t)ChunkDimensions.x * ChunkDimensions.y * ChunkDimensions.z);
+
+	suite.add({ .name = "noise/volume_lod2", .iterations = 10, .warmup = 1, .items = (double)lod2.x * lod2.y * lod2.z, .run = [voxels, lod2]()
+	{
+		generate_terrain_voxels_cpu(voxels->data(), lod2, TerrainGenerator::chunk_to_world_position(Int2(0)), 2);
+		benchmark_sink((*voxels)[0]);
+	}});
+
+	// a full LOD0 volume takes seconds on one core, 16 z slices of it are enough to see the per voxel cost
+	constexpr uint32_t Slices = 16;
+	suite.add({ .name = "noise/volume_lod0_16_slices", .iterations = 5, .warmup = 1, .items = (double)ChunkDimensions.x * ChunkDimensions.y * Slices, .run = [voxels]()
+	{
+		generate_terrain_voxels_cpu_slab(voxels->data(), ChunkDimensions, TerrainGenerator::chunk_to_world_position(Int2(0)), 0, 0, Slices);
+		benchmark_sink((*voxels)[0]);
+	}});
+
+	suite.add({ .name = "noise/heightmap_lod0", .iterations = 5, .warmup = 1, .items = (double)ChunkDimensions.x * ChunkDimensions.y * ChunkDimensions.z, .run = [voxels]()
+	{
+		generate_terrain_heightmap_cpu(voxels->data(), ChunkDimensions, TerrainGenerator::chunk_to_world_position(Int2(0)), 0);
+		benchmark_sink((*voxels)[0]);
+	}});
+}
+
+static void add_occlusion_benchmarks(BenchmarkSuite& suite)
+{
+	auto lod0 = generate_chunk_voxels(Int2(0), 0);
+	auto lod2 = generate_chunk_voxels(Int2(0), 2);
+	auto volume = std::make_shared<OcclusionBrickVolume>();
+
+	// the 0.1m and 1.6m cascades, see OcclusionCascadeDescs
+	suite.add({ .name = "occlusion/pack_lod0_3_mips", .iterations = 20, .warmup = 2, .items = (double)lod0->size(), .run = [lod0, volume]()
+	{
+		volume->build(lod0->data(), ChunkDimensions, 1, 3);
+		benchmark_sink(volume->mips[0][0]);
+	}});
+
+	suite.add({ .name = "occlusion/pack_lod2_stride4", .iterations = 50, .warmup = 2, .items = (double)lod2->size(), .run = [lod2, volume]()
+	{
+		volume->build(lod2->data(), ChunkDimensions >> 2, 4, 1);
+		benchmark_sink(volume->mips[0][0]);
+	}});
+}
+
+static void add_palette_benchmarks(BenchmarkSuite& suite)
+{
+	// a 64^3 model with ~200 colours, the way .vox exports come out of MagicaVoxel: mostly empty, a few colours per region
+	constexpr uint32_t Size = 64, ColorCount = 200;
+	auto pixels = std::make_shared<std::vector<uint8_t>>((size_t)Size * Size * Size * 4);
+
+	std::mt19937 rng(1337);
+	std::vector<uint32_t> colors(ColorCount);
+	for (uint32_t& color : colors)
+		color = rng() | 0xFF000000;
+
+	for (size_t i = 0; i < (size_t)Size * Size * Size; i++)
+	{
+		bool solid = rng() % 3 == 0;
+		uint32_t color = solid ? colors[(i / 512 + rng() % 8) % ColorCount] : 0;
+		memcpy(pixels->data() + i * 4, &color, 4);
+	}
+
+	suite.add({ .name = "voxel_mesh/palette_quantise_64", .iterations = 10, .warmup = 1, .items = (double)Size * Size * Size, .run = [pixels]()
+	{
+		VoxelMeshData data = process_voxel_image_data(pixels->data(), Size, Size, Size, 4);
+		benchmark_sink(data.voxels[0] + data.palette[1]);
+		delete[] data.voxels;
+	}});
+}
+
+static void add_resort_benchmarks(BenchmarkSuite& suite)
+{
+	// a streaming radius worth of chunks with every LOD resident, the origin moves one chunk between iterations
+	constexpr int32_t Radius = 16;
+	s_TerrainGen = TerrainGenerator::create_headless();
+	for (int32_t z = -Radius; z <= Radius; z++)
+	for (int32_t x = -Radius; x <= Radius; x++)
+		s_TerrainGen->add_placeholder_chunk(Int2(x, z), (1 << TerrainChunk::LODCount) - 1);
+
+	auto origin = std::make_shared<Int2>(0);
+	double chunkCount = (double)s_TerrainGen->m_ChunkTable.size();
+	suite.add({ .name = "terrain/resort_chunks_33x33", .iterations = 200, .warmup = 5, .items = chunkCount, .run = [origin]()
+	{
+		s_TerrainGen->resort_chunks(*origin);
+	}, .setup = [origin]()
+	{
+		origin->x = origin->x == 0 ? 1 : 0;
+	}});
+}
+
+static void add_raycast_benchmarks(BenchmarkSuite& suite)
+{
+	auto query = std::make_shared<VoxelQuery>();
+	for (int32_t z = -1; z <= 0; z++)
+	for (int32_t x = -1; x <= 0; x++)
+	{
+		auto voxels = generate_chunk_voxels(Int2(x, z), 0);
+		OcclusionBrickVolume volume;
+		volume.build(voxels->data(), ChunkDimensions, 1, 3);
+		query->set_chunk(Int2(x, z), std::move(volume));
+	}
+
+	// line of sight sized rays from just above the ground, all over the sphere
+	constexpr uint32_t RayCount = 1 << 14;
+	constexpr float MaxDistance = 64.0f;
+	auto batch = std::make_shared<TracedRayBatch>();
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+	for (uint32_t i = 0; i < RayCount; i++)
+	{
+		Float3 direction;
+		do
+			direction = Float3(uniform(rng), uniform(rng), uniform(rng));
+		while (glm::dot(direction, direction) > 1.0f || glm::dot(direction, direction) < 1e-4f);
+
+		Float3 origin = Float3(uniform(rng) * 20.0f, 2.0f + uniform(rng), uniform(rng) * 20.0f);
+		batch->add(origin, glm::normalize(direction), MaxDistance);
+	}
+
+	suite.add({ .name = "raycast/single", .iterations = 10, .warmup = 1, .items = (double)RayCount, .run = [query, batch]()
+	{
+		uint32_t hits = 0;
+		for (size_t i = 0; i < batch->size(); i++)
+		{
+			Float3 origin = Float3(batch->origin_x[i], batch->origin_y[i], batch->origin_z[i]);
+			Float3 direction = Float3(batch->direction_x[i], batch->direction_y[i], batch->direction_z[i]);
+			hits += query->raycast(origin, direction, batch->max_distance[i]).hit;
+		}
+		benchmark_sink(hits);
+	}});
+
+	suite.add({ .name = "raycast/packets_1_thread", .iterations = 10, .warmup = 1, .items = (double)RayCount, .run = [query, batch]()
+	{
+		query->raycast_batch(*batch, nullptr, false);
+		benchmark_sink(batch->hit[0]);
+	}});
+
+	suite.add({ .name = "raycast/packets_job_pool", .iterations = 10, .warmup = 1, .items = (double)RayCount, .run = [query, batch]()
+	{
+		query->raycast_batch(*batch, nullptr, true);
+		benchmark_sink(batch->hit[0]);
+	}});
+
+	// point queries hit the chunk table every time
+	constexpr uint32_t PointCount = 1 << 16;
+	auto points = std::make_shared<std::vector<Int3>>(PointCount);
+	for (Int3& point : *points)
+		point = Int3(rng() % 1024, rng() % 128, rng() % 1024) - Int3(768, 64, 768);
+
+	suite.add({ .name = "raycast/is_solid_points", .iterations = 20, .warmup = 2, .items = (double)PointCount, .run = [query, points]()
+	{
+		uint32_t solid = 0;
+		for (Int3 point : *points)
+			solid += query->is_solid(point);
+		benchmark_sink(solid);
+	}});
+}
+
+static void add_hash_map_benchmarks(BenchmarkSuite& suite)
+{
+	// chunk table shaped: Int2 keys around the origin, lookups half hits & half misses
+	constexpr int32_t Radius = 32;
+	constexpr uint32_t LookupCount = 1 << 16;
+	auto table = std::make_shared<std::unordered_map<Int2, uint32_t>>();
+	for (int32_t z = -Radius; z <= Radius; z++)
+	for (int32_t x = -Radius; x <= Radius; x++)
+		table->emplace(Int2(x, z), (uint32_t)table->size());
+
+	std::mt19937 rng(1337);
+	auto keys = std::make_shared<std::vector<Int2>>(LookupCount);
+	for (Int2& key : *keys)
+		key = Int2((int32_t)(rng() % (Radius * 4)) - Radius * 2, (int32_t)(rng() % (Radius * 2 + 1)) - Radius);
+
+	suite.add({ .name = "hash_map/chunk_table_find", .iterations = 20, .warmup = 2, .items = (double)LookupCount, .run = [table, keys]()
+	{
+		uint32_t sum = 0;
+		for (Int2 key : *keys)
+		{
+			auto it = table->find(key);
+			sum += it != table->end() ? it->second : 0;
+		}
+		benchmark_sink(sum);
+	}});
+
+	// streaming's insert / erase churn as the ring of chunks moves
+	suite.add({ .name = "hash_map/chunk_table_churn", .iterations = 20, .warmup = 2, .items = (double)(Radius * 2 + 1) * 2, .run = [table]()
+	{
+		for (int32_t z = -Radius; z <= Radius; z++)
+		{
+			table->erase(Int2(Radius, z));
+			table->emplace(Int2(Radius, z), 0u);
+		}
+		for (int32_t x = -Radius; x <= Radius; x++)
+		{
+			table->erase(Int2(x, Radius));
+			table->emplace(Int2(x, Radius), 0u);
+		}
+		benchmark_sink(table->size());
+	}});
+}
+
+static void add_uniform_benchmarks(BenchmarkSuite& suite)
+{
+	// Testbed's per-frame Shader::set traffic, only the CPU side (no GL headless): name -> location lookups
+	// string: what set(const std::string&) did, a std::string per literal plus count + 2x operator[]
+	// hashed: UniformID hashed at compile time, one find
+	#define TESTBED_UNIFORMS "u_MipLevel", "u_MaterialIndex", "u_ChunkDimensions", "u_OcclusionOriginChunk", "u_ViewProjection", \
+		"u_CameraPosition", "u_OBBCenter", "u_OBBOrientation", "u_VoxelDimensions", "u_Transformation", "u_InverseView", \
+		"u_InverseProjection", "u_PrevFrameViewProjection", "u_FrameNumber", "u_CameraPos", "u_CascadeMin[0]", "u_CascadeMin[1]", \
+		"u_CascadeMin[2]", "u_CascadeWrapOffset[0]", "u_CascadeWrapOffset[1]", "u_CascadeWrapOffset[2]", "u_Output", \
+		"u_ViewportDims", "u_Color", "u_DepthClip", "u_Tint", "u_Transformation", "u_ViewProjection", "u_Transformation", \
+		"u_Transformation", "u_Transformation", "u_Transformation", "u_Transformation", "u_Transformation", "u_Transformation"
+
+	static constexpr const char* Names[] = { TESTBED_UNIFORMS };
+	static constexpr UniformID IDs[] = { TESTBED_UNIFORMS };
+	#undef TESTBED_UNIFORMS
+	constexpr uint32_t FramesPerRun = 1000;
+
+	auto stringLocations = std::make_shared<std::unordered_map<std::string, int>>();
+	auto hashedLocations = std::make_shared<std::unordered_map<uint64_t, int, UniformID::Hash>>();
+	for (const char* name : Names)
+	{
+		stringLocations->emplace(name, (int)stringLocations->size());
+		hashedLocations->emplace(UniformID::hash_name(name), (int)hashedLocations->size());
+	}
+
+	suite.add({ .name = "uniforms/frame_string_lookup", .iterations = 20, .warmup = 2, .items = (double)std::size(Names) * FramesPerRun, .run = [stringLocations]()
+	{
+		auto& locations = *stringLocations;
+		int sum = 0;
+		for (uint32_t frame = 0; frame < FramesPerRun; frame++)
+		for (const char* literal : Names)
+		{
+			const std::string& name = literal;
+			if (!locations.count(name))
+				locations[name] = -1;
+			sum += locations[name];
+		}
+		benchmark_sink(sum);
+	}});
+
+	suite.add({ .name = "uniforms/frame_hashed_lookup", .iterations = 20, .warmup = 2, .items = (double)std::size(IDs) * FramesPerRun, .run = [hashedLocations]()
+	{
+		auto& locations = *hashedLocations;
+		int sum = 0;
+		for (uint32_t frame = 0; frame < FramesPerRun; frame++)
+		for (const UniformID& id : IDs)
+		{
+			auto it = locations.find(id.hash);
+			sum += it != locations.end() ? it->second : -1;
+		}
+		benchmark_sink(sum);
+	}});
+}
+
+static void add_text_benchmarks(BenchmarkSuite& suite, const std::filesystem::path& font_path)
+{
+	s_Font = Font::load_from_file(font_path, false);
+	if (!s_Font)
+	{
+		LOG("bench: no font at '{}', skipping text layout", font_path.string());
+		return;
+	}
+
+	// roughly the debug overlay, a few times over
+	std::string text;
+	for (uint32_t i = 0; i < 32; i++)
+		text += std::format("ms: {:.3f}\nfps: {:.2f}\n({:.2f}, {:.2f}, {:.2f})\nchunks: {} (+{}) {:.0f}MB, lods queued: {}\n", 16.6f + i, 60.2f - i, 1.0f * i, 2.0f, -3.5f * i, 441 + i, i, 512.0f, i * 3);
+
+	auto quads = std::make_shared<std::vector<TextQuad>>();
+	quads->reserve(text.size());
+	suite.add({ .name = "text/layout_overlay", .iterations = 100, .warmup = 5, .items = (double)text.size(), .run = [quads, text]()
+	{
+		quads->clear();
+		layout_text(*s_Font, text, 0.0f, *quads);
+		benchmark_sink(quads->size());
+	}});
+}
+
+void register_engine_benchmarks(BenchmarkSuite& suite, const std::filesystem::path& font_path)
+{
+	add_noise_benchmarks(suite);
+	add_occlusion_benchmarks(suite);
+	add_palette_benchmarks(suite);
+	add_resort_benchmarks(suite);
+	add_raycast_benchmarks(suite);
+	add_hash_map_benchmarks(suite);
+	add_uniform_benchmarks(suite);
+	add_text_benchmarks(suite, font_path);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "pch.h"
+
+#include "Benchmark.h"
+
+#include "threading/JobSystem.h"
+
+using namespace Engine;
+
+void register_engine_benchmarks(BenchmarkSuite& suite, const std::filesystem::path& font_path);
+
+// Bench [--filter <substring>] [--out <file.json>] [--scale <iteration multiplier>] [--font <ttf>] [--workers <n>]
+// no window and no GL context, runs on a plain box; results go to bench_results.json by default
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::filesystem::path outPath = "bench_results.json";
+	std::filesystem::path fontPath = "../App/resources/fonts/Raleway-Regular.ttf";
+	float iterationScale = 1.0f;
+	uint32_t workers = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else if (arg == "--out" && hasValue)
+			outPath = argv[++i];
+		else if (arg == "--font" && hasValue)
+			fontPath = argv[++i];
+		else if (arg == "--scale" && hasValue)
+			iterationScale = std::stof(argv[++i]);
+		else if (arg == "--workers" && hasValue)
+			workers = (uint32_t)std::stoul(argv[++i]);
+		else
+		{
+			LOG("usage: Bench [--filter <substring>] [--out <file.json>] [--scale <iteration multiplier>] [--font <ttf>] [--workers <n>]");
+			return 1;
+		}
+	}
+
+	JobSystem::init(workers);
+
+	BenchmarkSuite suite;
+	register_engine_benchmarks(suite, fontPath);
+
+	std::vector<BenchmarkResult> results = suite.run(filter, iterationScale);
+	bool written = BenchmarkSuite::write_json(outPath, results);
+	if (written)
+		LOG("bench: {} results written to '{}'", results.size(), outPath.string());
+
+	JobSystem::shutdown();
+	return written ? 0 : 1;
+}
\ No newline at end of file
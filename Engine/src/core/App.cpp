@@ -4,6 +4,9 @@
 #include "App.h"
 
 #include "rendering/Graphics.h"
+#include "rendering/StagingRing.h"
+#include "rendering/Shader.h"
+#include "threading/JobSystem.h"
 
 namespace Engine {
 
@@ -16,15 +19,19 @@ namespace Engine {
 		m_Instance = this;
 
 		m_Window = make_owning<Window>(window_name, window_width, window_height);
+
+		JobSystem::init();
 	}
 
 	App::~App()
 	{
+		JobSystem::shutdown();
 	}	
 
 	void App::run()
 	{
 		Graphics::init();
+		Profiler::init();
 
 		Hooks.start(*this);
 		
@@ -37,11 +44,17 @@ namespace Engine {
 			Input::update_mouse_delta();
 			m_Window->handle_events();
 
+			Profiler::begin_frame();
+			Shader::update_builds();
 			if (!m_Window->is_minimized())
 			{
+				PROFILE_SCOPE("Update");
 				Hooks.update(*this);
 				m_FrameNumber++;
 			}
+			StagingRing::end_frame();
+			Graphics::end_frame();
+			Profiler::end_frame();
 
 			// Time
 			auto current = std::chrono::high_resolution_clock::now();
@@ -52,6 +65,10 @@ namespace Engine {
 
 			m_Window->swap_buffers();
 		}
+
+		// still has a context here
+		StagingRing::shutdown();
+		Profiler::shutdown();
 	}
 
 	void App::close()
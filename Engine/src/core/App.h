@@ -2,6 +2,8 @@
 
 namespace Engine {
 
+	class App;
+
 	struct TestbedHooks
 	{
 		void(*start)(App&) = nullptr;
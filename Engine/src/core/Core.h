@@ -1,12 +1,22 @@
 #pragma once
 
-#define LOG(x, ...) Log::print(x, __VA_ARGS__)
+// __VA_OPT__ so LOG("plain text") doesn't leave a trailing comma
+#define LOG(x, ...) Log::print(x __VA_OPT__(,) __VA_ARGS__)
+
+#if defined(_MSC_VER)
+	#define DEBUG_BREAK() __debugbreak()
+#elif defined(__clang__)
+	#define DEBUG_BREAK() __builtin_debugtrap()
+#else
+	#include <csignal>
+	#define DEBUG_BREAK() std::raise(SIGTRAP)
+#endif
 
 // todo: runtime asserts idk
 #ifndef ENGINE_RELEASE
-	#define ASSERT(x) { if (!(x)) { LOG(##x); __debugbreak(); } }
+	#define ASSERT(x) { if (!(x)) { LOG(#x); DEBUG_BREAK(); } }
 #else
-	#define ASSERT(x) { if (!(x)) { LOG(##x); } }
+	#define ASSERT(x) { if (!(x)) { LOG(#x); } }
 #endif
 
 #define DELEGATE(fn) [this](auto&&... args) -> decltype(auto) { return this->fn(std::forward<decltype(args)>(args)...); }
\ No newline at end of file
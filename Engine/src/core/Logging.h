@@ -19,12 +19,12 @@ namespace Engine {
 		template<typename... Args>
 		static void print(const char* fmt, Args&&... args)
 		{
-			std::cout << std::vformat(fmt, std::make_format_args(std::forward<Args>(args)...)) << "\n";
+			std::cout << std::vformat(fmt, std::make_format_args(args...)) << "\n";
 		}
 		template<typename... Args>
 		static void write(const char* fmt, Args&&... args)
 		{
-			std::cout << std::vformat(fmt, std::make_format_args(std::forward<Args>(args)...));
+			std::cout << std::vformat(fmt, std::make_format_args(args...));
 		}
 	};
 
@@ -43,7 +43,7 @@ namespace Engine {
 
 	}
 
-	owning_ptr<Font> Font::load_from_file(const std::filesystem::path& path)
+	owning_ptr<Font> Font::load_from_file(const std::filesystem::path& path, bool create_atlas)
 	{
 		auto result = owning_ptr<Font>(new Font());
 		result->m_Data = new MSDFData();
@@ -96,8 +96,12 @@ namespace Engine {
 		int width, height;
 		atlasPacker.getDimensions(width, height);
 		emSize = atlasPacker.getScale();
+		result->m_AtlasSize = Int2(width, height);
 
-		if (std::filesystem::exists(atlas_save_path)) {
+		if (!create_atlas) {
+			// geometry only
+		}
+		else if (std::filesystem::exists(atlas_save_path)) {
 			// load cached atlas
 			result->m_AtlasTexture = Texture2D::load(atlas_save_path);
 		}
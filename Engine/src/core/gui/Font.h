@@ -15,11 +15,23 @@ namespace Engine {
 
 		MSDFData* get_msdf_data() const { return m_Data; }
 		Texture2D* get_atlas() const { return m_AtlasTexture.get(); }
+		Int2 get_atlas_size() const { return m_AtlasSize; }
 
-		static owning_ptr<Font> load_from_file(const std::filesystem::path& file);
+		// without create_atlas only the glyph geometry is loaded, no GL needed (layout_text still works)
+		static owning_ptr<Font> load_from_file(const std::filesystem::path& file, bool create_atlas = true);
 	private:
 		MSDFData* m_Data = nullptr;
 		owning_ptr<Texture2D> m_AtlasTexture = nullptr;
+		Int2 m_AtlasSize{};
 	};
 
+	struct TextQuad
+	{
+		Float2 position_min, position_max;   // em units, first baseline at y = 0
+		Float2 tex_coord_min, tex_coord_max; // atlas uvs
+	};
+
+	// glyph quads the way Graphics::draw_text places them, appended to quads
+	void layout_text(const Font& font, const std::string& text, float tracking, std::vector<TextQuad>& quads);
+
 }
\ No newline at end of file
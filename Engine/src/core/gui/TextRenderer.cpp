@@ -60,14 +60,12 @@ namespace Engine {
 		//s_TextShader = Shader::create("resources/shaders/TextShader.glsl");
 	}
 
-	void Graphics::draw_text(const std::string& text, const owning_ptr<class Font>& pFont, float tracking)
+	void layout_text(const Font& font, const std::string& text, float tracking, std::vector<TextQuad>& quads)
 	{
-		Font& font = *pFont;
-		
 		float lineHeight = 1.0f;
 		const msdf_atlas::FontGeometry& fontGeometry = font.get_msdf_data()->FontGeometry;
 		const msdfgen::FontMetrics& metrics = fontGeometry.getMetrics();
-		Texture2D* atlas = font.get_atlas();
+		Int2 atlasSize = font.get_atlas_size();
 
 		double x = 0.0;
 		double y = 0.0;
@@ -114,7 +112,6 @@ namespace Engine {
 		float spaceAdvance = (float)fontGeometry.getGlyph(' ')->getAdvance();
 		float tabColumnWidth = spaceAdvance * TabWidth;
 
-		uint32_t indexCount = 0;
 		for (size_t i = 0; i < text.length(); i++)
 		{
 			char currentChar = text[i];
@@ -167,29 +164,14 @@ namespace Engine {
 			// atlas bounds
 			double atlasL, atlasB, atlasR, atlasT;
 			glyph->getQuadAtlasBounds(atlasL, atlasB, atlasR, atlasT);
-			float texelWidth = 1.0f / atlas->get_width();
-			float texelHeight = 1.0f / atlas->get_height();
+			float texelWidth = 1.0f / atlasSize.x;
+			float texelHeight = 1.0f / atlasSize.y;
 			atlasL *= texelWidth, atlasB *= texelHeight, atlasR *= texelWidth, atlasT *= texelHeight;
 
 			Float2 texCoordMin = { (float)atlasR, (float)atlasB };
 			Float2 texCoordMax = { (float)atlasL, (float)atlasT };
 
-			// TL
-			s_CurrentVertex->position = { quadMin.x, quadMax.y };
-			s_CurrentVertex->texCoord = { texCoordMin.x, texCoordMax.y };
-			s_CurrentVertex++;
-			// TR
-			s_CurrentVertex->position = quadMax;
-			s_CurrentVertex->texCoord = texCoordMax;
-			s_CurrentVertex++;
-			// BR
-			s_CurrentVertex->position = { quadMax.x, quadMin.y };
-			s_CurrentVertex->texCoord = { texCoordMax.x, texCoordMin.y };
-			s_CurrentVertex++;
-			// BL
-			s_CurrentVertex->position = quadMin;
-			s_CurrentVertex->texCoord = texCoordMin;
-			s_CurrentVertex++;
+			quads.push_back({ quadMin, quadMax, texCoordMin, texCoordMax });
 
 			// advance
 			if (i + 1 < text.length())
@@ -200,16 +182,41 @@ namespace Engine {
 
 				x += fsScale * advance + tracking;
 			}
+		}
+	}
 
-			indexCount += 6;
+	void Graphics::draw_text(const std::string& text, const owning_ptr<class Font>& pFont, float tracking)
+	{
+		static std::vector<TextQuad> s_Quads;
+		s_Quads.clear();
+		layout_text(*pFont, text, tracking, s_Quads);
+
+		for (const TextQuad& quad : s_Quads)
+		{
+			// TL
+			s_CurrentVertex->position = { quad.position_min.x, quad.position_max.y };
+			s_CurrentVertex->texCoord = { quad.tex_coord_min.x, quad.tex_coord_max.y };
+			s_CurrentVertex++;
+			// TR
+			s_CurrentVertex->position = quad.position_max;
+			s_CurrentVertex->texCoord = quad.tex_coord_max;
+			s_CurrentVertex++;
+			// BR
+			s_CurrentVertex->position = { quad.position_max.x, quad.position_min.y };
+			s_CurrentVertex->texCoord = { quad.tex_coord_max.x, quad.tex_coord_min.y };
+			s_CurrentVertex++;
+			// BL
+			s_CurrentVertex->position = quad.position_min;
+			s_CurrentVertex->texCoord = quad.tex_coord_min;
+			s_CurrentVertex++;
 		}
 
-		atlas->bind();
+		pFont->get_atlas()->bind();
 		s_TextVAO->bind();
 		size_t vertexCount = (s_CurrentVertex - s_VertexData);
 		s_TextVBO->set_data(s_VertexData, vertexCount * sizeof(TextVertex));
 
-		Graphics::draw_indexed(indexCount);
+		Graphics::draw_indexed((uint32_t)(s_Quads.size() * 6));
 		s_CurrentVertex = s_VertexData;
 	}
 
@@ -1,7 +1,7 @@
 #include "pch.h"
 
 #define GLFW_INCLUDE_NONE
-#include <glfw/glfw3.h>
+#include <GLFW/glfw3.h>
 
 #include "windowing/Window.h"
 #include "App.h"
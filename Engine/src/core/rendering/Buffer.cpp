@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "Buffer.h"
+#include "Graphics.h"
+#include "StagingRing.h"
 
 #include <glad/glad.h>
 
@@ -18,7 +20,7 @@ namespace Engine {
 
 	void VertexBuffer::set_data(void* data, uint32_t size, uint32_t offset)
 	{
-		glNamedBufferSubData(m_ID, offset, size, data);
+		StagingRing::upload_buffer(m_ID, offset, data, size);
 	}
 
 	owning_ptr<VertexBuffer> VertexBuffer::create(void* data, uint32_t size)
@@ -50,18 +52,47 @@ namespace Engine {
 
 	ShaderStorageBuffer::~ShaderStorageBuffer()
 	{
+		Graphics::forget_buffer(m_ID);
 		glDeleteBuffers(1, &m_ID);
 	}
 
 	void ShaderStorageBuffer::bind(uint32_t slot)
 	{
-		//glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ID);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, slot, m_ID);
+		Graphics::bind_storage_buffer(slot, m_ID);
 	}
 
 	void ShaderStorageBuffer::set_data(const void* data, size_t offset, size_t size)
 	{
-		glNamedBufferSubData(m_ID, offset, size, data);
+		StagingRing::upload_buffer(m_ID, offset, data, size);
+	}
+
+	UniformBuffer::UniformBuffer(size_t size)
+		: m_Size(size)
+	{
+		glCreateBuffers(1, &m_ID);
+		glNamedBufferData(m_ID, size, nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	UniformBuffer::~UniformBuffer()
+	{
+		Graphics::forget_buffer(m_ID);
+		glDeleteBuffers(1, &m_ID);
+	}
+
+	void UniformBuffer::bind(uint32_t slot)
+	{
+		Graphics::bind_uniform_buffer(slot, m_ID);
+	}
+
+	void UniformBuffer::set_data(const void* data, size_t size, size_t offset)
+	{
+		ASSERT(offset + size <= m_Size);
+		StagingRing::upload_buffer(m_ID, offset, data, size);
+	}
+
+	owning_ptr<UniformBuffer> UniformBuffer::create(size_t size)
+	{
+		return owning_ptr<UniformBuffer>(new UniformBuffer(size));
 	}
 
 }
\ No newline at end of file
@@ -117,6 +117,7 @@ namespace Engine {
 		}
 
 		uint32_t get_handle() const { return m_ID; }
+		size_t get_capacity() const { return m_Capacity; }
 
 		template<typename T>
 		static owning_ptr<ShaderStorageBuffer> create(const T* data, size_t count)
@@ -132,4 +133,24 @@ namespace Engine {
 		size_t m_Capacity = 0; // max 'elements'
 	};
 
+	// std140 uniform block storage, whatever gets uploaded has to match the GLSL layout
+	class UniformBuffer
+	{
+	private:
+		UniformBuffer(size_t size);
+	public:
+		~UniformBuffer();
+
+		void bind(uint32_t slot);
+		void set_data(const void* data, size_t size, size_t offset = 0);
+
+		uint32_t get_handle() const { return m_ID; }
+		size_t get_size() const { return m_Size; }
+
+		static owning_ptr<UniformBuffer> create(size_t size);
+	private:
+		uint32_t m_ID = 0;
+		size_t m_Size = 0;
+	};
+
 }
\ No newline at end of file
@@ -18,6 +18,9 @@ namespace Engine {
 		return { x, y, z };
 	}
 
+	// not in our glad, same entry point for the KHR and ARB versions
+	typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
 	ExtensionsQuery graphics_query_gl_extension_support()
 	{
 		ExtensionsQuery query;
@@ -41,6 +44,16 @@ namespace Engine {
 			Int3 rgba8 = get_format_sparse_virtual_page_size_3d(GL_RGBA8);
 			LOG("\tRGBA8 vpage size = [{}, {}, {}]", rgba8.x, rgba8.y, rgba8.z);
 		}
+
+		auto maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		if (!maxShaderCompilerThreads)
+			maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		query.parallel_shader_compile = maxShaderCompilerThreads
+			&& (glfwExtensionSupported("GL_KHR_parallel_shader_compile") || glfwExtensionSupported("GL_ARB_parallel_shader_compile"));
+
+		LOG("GL_KHR_parallel_shader_compile:\n\t{}", query.parallel_shader_compile ? "YES" : "NO");
+		if (query.parallel_shader_compile)
+			maxShaderCompilerThreads(0xFFFFFFFF); // as many as the driver wants
 		LOG("");
 
 		return query;
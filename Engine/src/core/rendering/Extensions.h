@@ -6,6 +6,7 @@ namespace Engine {
 	{
 		bool bindless_texture = false;
 		bool sparse_texture = false;
+		bool parallel_shader_compile = false; // KHR or ARB, compiler threads already requested when set
 	};
 
 	ExtensionsQuery graphics_query_gl_extension_support();
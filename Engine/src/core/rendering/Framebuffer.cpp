@@ -50,27 +50,29 @@ namespace Engine {
 			m_DepthStencilAttachment = std::move(texture);
 		}
 
-		glNamedFramebufferDrawBuffers(m_ID, m_DrawBuffersCount, m_DrawBuffers);
+		Graphics::set_framebuffer_draw_buffers(m_ID, m_DrawBuffers, m_DrawBuffersCount);
 		ASSERT(glCheckNamedFramebufferStatus(m_ID, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
 	}
 
 	Framebuffer::~Framebuffer()
 	{
+		Graphics::forget_framebuffer(m_ID);
 		glDeleteFramebuffers(1, &m_ID);
 	}
 
 	void Framebuffer::bind()
 	{
-		glNamedFramebufferDrawBuffers(m_ID, m_DrawBuffersCount, m_DrawBuffers);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_ID);
+		// draw buffers get changed behind our back (Graphics::reset_draw_buffers), the cache drops the no-ops
+		Graphics::set_framebuffer_draw_buffers(m_ID, m_DrawBuffers, m_DrawBuffersCount);
+		Graphics::bind_draw_framebuffer(m_ID);
 	}
 
 	void Framebuffer::clear(const Color& color)
 	{
 		bind();
-		glNamedFramebufferDrawBuffers(m_ID, m_ClearBuffersCount, m_ClearBuffers);
+		Graphics::set_framebuffer_draw_buffers(m_ID, m_ClearBuffers, m_ClearBuffersCount);
 		Graphics::clear(color);
-		glNamedFramebufferDrawBuffers(m_ID, m_DrawBuffersCount, m_DrawBuffers);
+		Graphics::set_framebuffer_draw_buffers(m_ID, m_DrawBuffers, m_DrawBuffersCount);
 	}	
 
 	void Framebuffer::resize(uint32_t width, uint32_t height)
@@ -104,7 +106,7 @@ namespace Engine {
 
 	void Framebuffer::unbind()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		Graphics::bind_draw_framebuffer(0);
 	}
 
 	owning_ptr<Framebuffer> Framebuffer::create(const FramebufferDescriptor& descriptor)
@@ -7,6 +7,9 @@
 #include "VertexArray.h"
 
 #include "Extensions.h"
+#include "StagingRing.h"
+
+#include <bit>
 
 namespace Engine {
 
@@ -180,6 +183,209 @@ namespace Engine {
 		s_SphereVAO->set_index_buffer(IndexBuffer::create(indices.data(), indices.size()));
 	}
 
+	static constexpr uint32_t Unknown = ~0u;
+	static constexpr uint32_t CachedTextureUnits = 32;
+	static constexpr uint32_t CachedImageUnits = 16;
+	static constexpr uint32_t CachedStorageBuffers = 16;
+	static constexpr uint32_t CachedUniformBuffers = 16;
+	static constexpr uint32_t CachedColorBuffers = 8;
+
+	struct ImageBinding
+	{
+		uint32_t texture, mip, access, format;
+		bool operator==(const ImageBinding&) const = default;
+	};
+
+	struct StencilOps
+	{
+		uint32_t fail, depth_fail, depth_pass;
+		bool operator==(const StencilOps&) const = default;
+	};
+
+	struct DrawBuffers
+	{
+		uint32_t count;
+		uint32_t buffers[8];
+	};
+
+	// what GL should have bound right now, all uint32 so invalidating is one memset to Unknown
+	// Unknown never matches, the next set after an invalidate always goes through
+	static struct
+	{
+		uint32_t program, vertex_array, draw_framebuffer;
+		uint32_t textures[CachedTextureUnits];
+		ImageBinding images[CachedImageUnits];
+		uint32_t storage_buffers[CachedStorageBuffers];
+		uint32_t uniform_buffers[CachedUniformBuffers];
+
+		uint32_t cull_enabled, cull_face;
+		uint32_t depth_enabled, depth_func, depth_mask;
+		uint32_t stencil_enabled, stencil_write_mask;
+		uint32_t stencil_func, stencil_ref, stencil_read_mask;
+		StencilOps stencil_ops[2]; // front, back
+		uint32_t blend_enabled, blend_src, blend_dst;
+		uint32_t color_masks[CachedColorBuffers]; // rgba bits
+		uint32_t clear_color[4], clear_depth;     // float bits
+	} s_State;
+
+	// draw buffers are framebuffer state, not context state
+	static std::unordered_map<uint32_t, DrawBuffers> s_DrawBuffers;
+
+	template<typename T>
+	static bool update(T& cached, const T& value)
+	{
+		if (cached == value)
+			return false;
+
+		cached = value;
+		return true;
+	}
+
+	static void set_capability(GLenum capability, bool enabled)
+	{
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+	}
+
+	bool Graphics::track(StateCall call, bool changed)
+	{
+		if (changed)
+			s_FrameStats.issued[(size_t)call]++;
+		else
+			s_FrameStats.filtered[(size_t)call]++;
+
+		return changed;
+	}
+
+	void Graphics::end_frame()
+	{
+		s_LastFrameStats = s_FrameStats;
+		s_FrameStats = {};
+	}
+
+	void Graphics::invalidate_state_cache()
+	{
+		memset(&s_State, 0xff, sizeof(s_State));
+		s_DrawBuffers.clear();
+	}
+
+	void Graphics::log_state_stats()
+	{
+		static const char* s_CallNames[] = { "program", "vertex array", "texture", "image", "storage buffer", "uniform buffer", "framebuffer", "raster" };
+		static_assert(std::size(s_CallNames) == (size_t)StateCall::Count);
+
+		const StateCacheStats& stats = s_LastFrameStats;
+		LOG("gl state: {} calls issued, {} filtered last frame", stats.get_issued(), stats.get_filtered());
+		for (size_t i = 0; i < (size_t)StateCall::Count; i++)
+			LOG("  {}: {} issued, {} filtered", s_CallNames[i], stats.issued[i], stats.filtered[i]);
+	}
+
+	void Graphics::bind_program(uint32_t program)
+	{
+		if (track(StateCall::Program, update(s_State.program, program)))
+			glUseProgram(program);
+	}
+
+	void Graphics::bind_vertex_array(uint32_t vertex_array)
+	{
+		if (track(StateCall::VertexArray, update(s_State.vertex_array, vertex_array)))
+			glBindVertexArray(vertex_array);
+	}
+
+	void Graphics::bind_texture_unit(uint32_t slot, uint32_t texture)
+	{
+		bool changed = slot >= CachedTextureUnits || update(s_State.textures[slot], texture);
+		if (track(StateCall::Texture, changed))
+			glBindTextureUnit(slot, texture);
+	}
+
+	void Graphics::bind_image_texture(uint32_t slot, uint32_t texture, uint32_t mip, uint32_t access, uint32_t format)
+	{
+		bool changed = slot >= CachedImageUnits || update(s_State.images[slot], { texture, mip, access, format });
+		if (track(StateCall::Image, changed))
+			glBindImageTexture(slot, texture, mip, GL_FALSE, 0, access, format);
+	}
+
+	void Graphics::bind_storage_buffer(uint32_t slot, uint32_t buffer)
+	{
+		bool changed = slot >= CachedStorageBuffers || update(s_State.storage_buffers[slot], buffer);
+		if (track(StateCall::StorageBuffer, changed))
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, slot, buffer);
+	}
+
+	void Graphics::bind_uniform_buffer(uint32_t slot, uint32_t buffer)
+	{
+		bool changed = slot >= CachedUniformBuffers || update(s_State.uniform_buffers[slot], buffer);
+		if (track(StateCall::UniformBuffer, changed))
+			glBindBufferBase(GL_UNIFORM_BUFFER, slot, buffer);
+	}
+
+	void Graphics::bind_draw_framebuffer(uint32_t framebuffer)
+	{
+		if (track(StateCall::Framebuffer, update(s_State.draw_framebuffer, framebuffer)))
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	}
+
+	void Graphics::set_framebuffer_draw_buffers(uint32_t framebuffer, const uint32_t* buffers, uint32_t count)
+	{
+		bool changed = true;
+		if (count <= std::size(DrawBuffers{}.buffers))
+		{
+			auto [it, inserted] = s_DrawBuffers.try_emplace(framebuffer);
+			DrawBuffers& cached = it->second;
+
+			changed = inserted || cached.count != count || memcmp(cached.buffers, buffers, count * sizeof(uint32_t)) != 0;
+			cached.count = count;
+			memcpy(cached.buffers, buffers, count * sizeof(uint32_t));
+		}
+
+		if (track(StateCall::Framebuffer, changed))
+			glNamedFramebufferDrawBuffers(framebuffer, count, buffers);
+	}
+
+	void Graphics::forget_program(uint32_t program)
+	{
+		if (s_State.program == program)
+			s_State.program = Unknown;
+	}
+
+	void Graphics::forget_vertex_array(uint32_t vertex_array)
+	{
+		if (s_State.vertex_array == vertex_array)
+			s_State.vertex_array = Unknown;
+	}
+
+	void Graphics::forget_texture(uint32_t texture)
+	{
+		for (uint32_t& bound : s_State.textures)
+			if (bound == texture)
+				bound = Unknown;
+
+		for (ImageBinding& bound : s_State.images)
+			if (bound.texture == texture)
+				bound.texture = Unknown;
+	}
+
+	void Graphics::forget_buffer(uint32_t buffer)
+	{
+		for (uint32_t& bound : s_State.storage_buffers)
+			if (bound == buffer)
+				bound = Unknown;
+
+		for (uint32_t& bound : s_State.uniform_buffers)
+			if (bound == buffer)
+				bound = Unknown;
+	}
+
+	void Graphics::forget_framebuffer(uint32_t framebuffer)
+	{
+		s_DrawBuffers.erase(framebuffer);
+		if (s_State.draw_framebuffer == framebuffer)
+			s_State.draw_framebuffer = Unknown;
+	}
+
 	void Graphics::init()
 	{
 #ifdef ENGINE_DEBUG
@@ -189,10 +395,12 @@ namespace Engine {
 
 		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, false);
 #endif
-		ExtensionsQuery extensions = graphics_query_gl_extension_support();
+		s_Extensions = graphics_query_gl_extension_support();
+		StagingRing::init();
+		invalidate_state_cache();
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		toggle_blend(true);
+		set_blend_function(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 		//set_depth_test(DepthTest::Less);
 		set_depth_test(DepthTest::Greater);
@@ -210,41 +418,53 @@ namespace Engine {
 
 	void Graphics::set_color_mask(uint32_t buf, bool r, bool g, bool b, bool a)
 	{
-		glColorMaski(buf, r, g, b, a);
+		uint32_t mask = r | g << 1 | b << 2 | a << 3;
+		bool changed = buf >= CachedColorBuffers || update(s_State.color_masks[buf], mask);
+		if (track(StateCall::Raster, changed))
+			glColorMaski(buf, r, g, b, a);
 	}
 
 	void Graphics::set_face_cull(Face face)
 	{
-		if (face == Face::None) {
-			glDisable(GL_CULL_FACE);
-			return;
-		}
+		bool enabled = face != Face::None;
+		if (track(StateCall::Raster, update(s_State.cull_enabled, (uint32_t)enabled)))
+			set_capability(GL_CULL_FACE, enabled);
 
-		glEnable(GL_CULL_FACE);
-		glCullFace((GLenum)face);
+		if (enabled && track(StateCall::Raster, update(s_State.cull_face, (uint32_t)face)))
+			glCullFace((GLenum)face);
 	}
 
 	void Graphics::toggle_blend(bool enabled)
 	{
-		if (enabled)
-			glEnable(GL_BLEND);
-		else
-			glDisable(GL_BLEND);
+		if (track(StateCall::Raster, update(s_State.blend_enabled, (uint32_t)enabled)))
+			set_capability(GL_BLEND, enabled);
 	}
 
 	void Graphics::reset_draw_buffers()
 	{
-		glDrawBuffer(GL_NONE);
+		uint32_t none = GL_NONE;
+		set_draw_buffers(&none, 1);
 	}
 
 	void Graphics::set_draw_buffers(uint32_t* buffers, size_t count)
 	{
-		glDrawBuffers(count, buffers);
+		// targets whatever is bound, the cache only knows which framebuffer that is after a bind through here
+		if (s_State.draw_framebuffer == Unknown)
+		{
+			track(StateCall::Framebuffer, true);
+			glDrawBuffers((GLsizei)count, buffers);
+			return;
+		}
+
+		set_framebuffer_draw_buffers(s_State.draw_framebuffer, buffers, (uint32_t)count);
 	}
 
 	void Graphics::set_blend_function(uint32_t sfactor, uint32_t dfactor)
 	{
-		glBlendFunc(sfactor, dfactor);
+		bool changed = update(s_State.blend_src, sfactor);
+		changed |= update(s_State.blend_dst, dfactor);
+		if (track(StateCall::Raster, changed))
+			glBlendFunc(sfactor, dfactor);
 	}
 
 	static PrimitiveMode s_PrimitiveDrawMode = PrimitiveMode::Triangles;
@@ -261,49 +481,74 @@ namespace Engine {
 
 	void Graphics::set_depth_mask(bool mask)
 	{
-		glDepthMask(mask);
+		if (track(StateCall::Raster, update(s_State.depth_mask, (uint32_t)mask)))
+			glDepthMask(mask);
 	}
 
 	void Graphics::set_depth_test(DepthTest mode)
 	{
-		if (mode == DepthTest::Off) {
-			glDisable(GL_DEPTH_TEST);
-			return;
-		}
+		bool enabled = mode != DepthTest::Off;
+		if (track(StateCall::Raster, update(s_State.depth_enabled, (uint32_t)enabled)))
+			set_capability(GL_DEPTH_TEST, enabled);
 
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc((GLenum)mode);
+		if (enabled && track(StateCall::Raster, update(s_State.depth_func, (uint32_t)mode)))
+			glDepthFunc((GLenum)mode);
 	}
 
 	void Graphics::set_stencil_test(bool enabled)
 	{
-		if (enabled)
-			glEnable(GL_STENCIL_TEST);
-		else
-			glDisable(GL_STENCIL_TEST);
+		if (track(StateCall::Raster, update(s_State.stencil_enabled, (uint32_t)enabled)))
+			set_capability(GL_STENCIL_TEST, enabled);
 	}
 
 	void Graphics::set_stencil_func(StencilTest func, uint8_t ref, uint8_t mask)
 	{
-		glStencilFunc((GLenum)func, ref, mask);
+		bool changed = update(s_State.stencil_func, (uint32_t)func);
+		changed |= update(s_State.stencil_ref, (uint32_t)ref);
+		changed |= update(s_State.stencil_read_mask, (uint32_t)mask);
+		if (track(StateCall::Raster, changed))
+			glStencilFunc((GLenum)func, ref, mask);
 	}
 
 	void Graphics::set_face_stencil_op(Face face, StencilOp stencilFail, StencilOp stencilPassDepthFail, StencilOp stencilDepthPass)
 	{
-		glStencilOpSeparate((GLenum)face, (GLenum)stencilFail, (GLenum)stencilPassDepthFail, (GLenum)stencilDepthPass);
+		StencilOps ops = { (uint32_t)stencilFail, (uint32_t)stencilPassDepthFail, (uint32_t)stencilDepthPass };
+
+		bool changed = false;
+		if (face != Face::Back)
+			changed |= update(s_State.stencil_ops[0], ops);
+		if (face != Face::Front)
+			changed |= update(s_State.stencil_ops[1], ops);
+
+		if (track(StateCall::Raster, changed))
+			glStencilOpSeparate((GLenum)face, (GLenum)stencilFail, (GLenum)stencilPassDepthFail, (GLenum)stencilDepthPass);
 	}
 
 	void Graphics::set_stencil_mask(uint8_t mask)
 	{
-		glStencilMask(mask);
+		if (track(StateCall::Raster, update(s_State.stencil_write_mask, (uint32_t)mask)))
+			glStencilMask(mask);
 	}
 
 	void Graphics::clear(const Color& color, float depth)
 	{
-		glClearDepth(depth);
-		glClearColor(color.r, color.g, color.b, color.a);
-		glColorMask(1, 1, 1, 1); // TODO: save state prob
-		glDepthMask(true);		 // TODO: save state prob
+		if (track(StateCall::Raster, update(s_State.clear_depth, std::bit_cast<uint32_t>(depth))))
+			glClearDepth(depth);
+
+		const float channels[] = { color.r, color.g, color.b, color.a };
+		bool changed = false;
+		for (uint32_t i = 0; i < 4; i++)
+			changed |= update(s_State.clear_color[i], std::bit_cast<uint32_t>(channels[i]));
+		if (track(StateCall::Raster, changed))
+			glClearColor(color.r, color.g, color.b, color.a);
+
+		// clears respect the write masks, everything has to be writable
+		changed = false;
+		for (uint32_t& mask : s_State.color_masks)
+			changed |= update(mask, 0xfu);
+		if (track(StateCall::Raster, changed))
+			glColorMask(1, 1, 1, 1);
+		set_depth_mask(true);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 	}
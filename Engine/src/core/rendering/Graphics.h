@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Extensions.h"
+
 namespace Engine {
 
 	enum class Face
@@ -50,11 +52,63 @@ namespace Engine {
 #ifndef GL_TEXTURE_FETCH_BARRIER_BIT
 	#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
 #endif
+#ifndef GL_TEXTURE_UPDATE_BARRIER_BIT
+	#define GL_TEXTURE_UPDATE_BARRIER_BIT 0x00000100
+#endif
+
+	enum class StateCall
+	{
+		Program = 0,
+		VertexArray,
+		Texture,
+		Image,
+		StorageBuffer,
+		UniformBuffer,
+		Framebuffer,
+		Raster,
+		Count
+	};
 
+	// GL calls that went through vs. the ones the state cache skipped, per frame
+	struct StateCacheStats
+	{
+		uint32_t issued[(size_t)StateCall::Count]{};
+		uint32_t filtered[(size_t)StateCall::Count]{};
+
+		uint32_t get_issued() const { uint32_t sum = 0; for (uint32_t n : issued) sum += n; return sum; }
+		uint32_t get_filtered() const { uint32_t sum = 0; for (uint32_t n : filtered) sum += n; return sum; }
+	};
+
+	// all binds and raster state go through the shadow state cache in here, calls that wouldn't change
+	// anything never reach the driver. touching GL state directly means calling invalidate_state_cache()
 	class Graphics
 	{
 	public:
 		static void init();
+		static const ExtensionsQuery& get_extensions() { return s_Extensions; }
+
+		// rolls the state cache counters over, once per frame
+		static void end_frame();
+
+		static void invalidate_state_cache();
+		static const StateCacheStats& get_state_stats() { return s_LastFrameStats; } // previous frame
+		static void log_state_stats();
+
+		static void bind_program(uint32_t program);
+		static void bind_vertex_array(uint32_t vertex_array);
+		static void bind_texture_unit(uint32_t slot, uint32_t texture);
+		static void bind_image_texture(uint32_t slot, uint32_t texture, uint32_t mip, uint32_t access, uint32_t format);
+		static void bind_storage_buffer(uint32_t slot, uint32_t buffer);
+		static void bind_uniform_buffer(uint32_t slot, uint32_t buffer);
+		static void bind_draw_framebuffer(uint32_t framebuffer);
+		static void set_framebuffer_draw_buffers(uint32_t framebuffer, const uint32_t* buffers, uint32_t count);
+
+		// call before deleting the object, GL hands its name out again
+		static void forget_program(uint32_t program);
+		static void forget_vertex_array(uint32_t vertex_array);
+		static void forget_texture(uint32_t texture);
+		static void forget_buffer(uint32_t buffer);
+		static void forget_framebuffer(uint32_t framebuffer);
 
 		static void clear(const Color& color, float depth = 0.0f);
 		static void draw_indexed(uint32_t count);
@@ -89,6 +143,13 @@ namespace Engine {
 		static void draw_text(const std::string& text, const owning_ptr<class Font>& font, float tracking = 0.0f);
 
 		static void resize_viewport(uint32_t x, uint32_t y);
+	private:
+		static bool track(StateCall call, bool changed);
+	private:
+		static inline ExtensionsQuery s_Extensions;
+
+		static inline StateCacheStats s_FrameStats;
+		static inline StateCacheStats s_LastFrameStats;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "pch.h"
+
+#include "ProgramCache.h"
+
+#include "utils/MappedFile.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <fstream>
+
+namespace Engine {
+
+	static constexpr uint32_t ProgramFileMagic = 0x47525056; // 'VPRG'
+	static constexpr uint32_t ProgramFileVersion = 1;
+
+	struct ProgramFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t binary_format;
+		uint32_t binary_size; // of the payload following the header
+		uint32_t checksum;    // FNV-1a of the payload
+		uint32_t padding;
+	};
+
+	static uint64_t fnv1a64(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	static uint32_t fnv1a(const uint8_t* data, size_t size)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ data[i]) * 16777619u;
+		return hash;
+	}
+
+	void ProgramCache::init(const std::filesystem::path& directory)
+	{
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		if (formatCount == 0)
+		{
+			LOG("program cache: driver has no program binary formats, disabled");
+			return;
+		}
+
+		s_Directory = directory;
+		std::error_code error;
+		std::filesystem::create_directories(s_Directory, error);
+		if (error)
+		{
+			LOG("program cache: couldn't create '{}' ({}), disabled", s_Directory.string(), error.message());
+			return;
+		}
+
+		// binaries are only good for the exact driver that produced them
+		s_DriverHash = 14695981039346656037ull;
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION })
+		{
+			const char* string = (const char*)glGetString(name);
+			if (string)
+				s_DriverHash = fnv1a64(s_DriverHash, string, strlen(string) + 1);
+		}
+
+		s_Enabled = true;
+	}
+
+	uint64_t ProgramCache::hash_stage(uint64_t key, uint32_t type, const std::string& source)
+	{
+		key = fnv1a64(key, &type, sizeof(type));
+		return fnv1a64(key, source.data(), source.size() + 1);
+	}
+
+	std::filesystem::path ProgramCache::get_program_path(uint64_t key)
+	{
+		return s_Directory / std::format("{:016x}.program", key);
+	}
+
+	uint32_t ProgramCache::load(uint64_t key)
+	{
+		if (!s_Enabled)
+			return 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		auto file = MappedFile::open(get_program_path(key));
+		if (!file || file->get_size() < sizeof(ProgramFileHeader))
+			return 0;
+
+		ProgramFileHeader header;
+		memcpy(&header, file->get_data(), sizeof(header));
+		const uint8_t* payload = file->get_data() + sizeof(header);
+
+		bool valid = header.magic == ProgramFileMagic && header.version == ProgramFileVersion && header.key == key
+			&& header.binary_size == file->get_size() - sizeof(header)
+			&& header.checksum == fnv1a(payload, header.binary_size);
+		if (!valid)
+		{
+			LOG("program cache: ignoring invalid file for {:016x}", key);
+			s_Stats.rejected++;
+			return 0;
+		}
+
+		// the driver may still refuse it (its own versioning), that's just a miss
+		uint32_t program = glCreateProgram();
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glProgramBinary(program, header.binary_format, payload, header.binary_size);
+
+		int isLinked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+		if (!isLinked)
+		{
+			glDeleteProgram(program);
+			s_Stats.rejected++;
+			return 0;
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		s_Stats.hits++;
+		s_Stats.load_ms += elapsed.count();
+
+		return program;
+	}
+
+	void ProgramCache::store(uint64_t key, uint32_t program)
+	{
+		if (!s_Enabled)
+			return;
+
+		GLint binarySize = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+		if (binarySize <= 0)
+			return;
+
+		std::vector<uint8_t> binary(binarySize);
+		GLenum binaryFormat = 0;
+		glGetProgramBinary(program, binarySize, &binarySize, &binaryFormat, binary.data());
+
+		ProgramFileHeader header{};
+		header.magic = ProgramFileMagic;
+		header.version = ProgramFileVersion;
+		header.key = key;
+		header.binary_format = binaryFormat;
+		header.binary_size = (uint32_t)binarySize;
+		header.checksum = fnv1a(binary.data(), binarySize);
+
+		std::filesystem::path path = get_program_path(key);
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp";
+
+		{
+			std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!out)
+			{
+				LOG("program cache: couldn't write '{}'", tempPath.string());
+				return;
+			}
+
+			out.write((const char*)&header, sizeof(header));
+			out.write((const char*)binary.data(), binarySize);
+		}
+
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+		{
+			LOG("program cache: couldn't move '{}' into place ({})", path.string(), error.message());
+			return;
+		}
+
+		s_Stats.writes++;
+	}
+
+	void ProgramCache::log_stats()
+	{
+		const ProgramCacheStats& stats = s_Stats;
+		LOG("program cache: {} programs loaded from cache in {:.2f}ms, {} compiled in {:.2f}ms ({} rejected, {} written)",
+			stats.hits, stats.load_ms, stats.misses, stats.compile_ms, stats.rejected, stats.writes);
+	}
+
+	void ProgramCache::clear()
+	{
+		if (s_Directory.empty())
+			return;
+
+		std::error_code error;
+		std::filesystem::remove_all(s_Directory, error);
+		std::filesystem::create_directories(s_Directory, error);
+	}
+
+}
\ No newline at end of file
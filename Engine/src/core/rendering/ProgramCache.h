@@ -0,0 +1,48 @@
+#pragma once
+
+namespace Engine {
+
+	struct ProgramCacheStats
+	{
+		uint32_t hits = 0, misses = 0, writes = 0;
+		uint32_t rejected = 0;    // files the driver wouldn't take anymore (driver update etc.)
+		double load_ms = 0.0;     // hits, read + glProgramBinary
+		double compile_ms = 0.0;  // misses, compile + link from source
+	};
+
+	// on-disk cache of linked program binaries (glGetProgramBinary), one file per program
+	// keyed by the fully preprocessed sources of every stage plus the vendor/renderer/version strings,
+	// so a shader edit or driver update simply misses and recompiles. GL thread only
+	class ProgramCache
+	{
+	public:
+		// after the context exists, stays disabled if the driver has no binary formats
+		static void init(const std::filesystem::path& directory);
+		static bool is_enabled() { return s_Enabled; }
+
+		// start with get_driver_key(), then add every stage
+		static uint64_t get_driver_key() { return s_DriverHash; }
+		static uint64_t hash_stage(uint64_t key, uint32_t type, const std::string& source);
+
+		// linked program or 0 if there's nothing valid for key
+		static uint32_t load(uint64_t key);
+		// program has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+		static void store(uint64_t key, uint32_t program);
+
+		static void add_compile_time(double ms) { s_Stats.compile_ms += ms; s_Stats.misses++; }
+
+		static const ProgramCacheStats& get_stats() { return s_Stats; }
+		static void reset_stats() { s_Stats = {}; }
+		static void log_stats();
+
+		static void clear();
+	private:
+		static std::filesystem::path get_program_path(uint64_t key);
+	private:
+		static inline bool s_Enabled = false;
+		static inline std::filesystem::path s_Directory;
+		static inline uint64_t s_DriverHash = 0;
+		static inline ProgramCacheStats s_Stats;
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "pch.h"
+
+#include "ReadbackBuffer.h"
+#include "Texture.h"
+
+#include <glad/glad.h>
+
+namespace Engine {
+
+	// coherent, so a signalled fence is all it takes before the CPU reads
+	static constexpr GLbitfield ReadbackFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	ReadbackBuffer::ReadbackBuffer(size_t size)
+		: m_Size(size)
+	{
+		glCreateBuffers(1, &m_ID);
+		glNamedBufferStorage(m_ID, size, nullptr, ReadbackFlags);
+		m_Mapped = (const uint8_t*)glMapNamedBufferRange(m_ID, 0, size, ReadbackFlags);
+		ASSERT(m_Mapped);
+	}
+
+	ReadbackBuffer::~ReadbackBuffer()
+	{
+		if (m_Fence)
+			glDeleteSync((GLsync)m_Fence);
+
+		glUnmapNamedBuffer(m_ID);
+		glDeleteBuffers(1, &m_ID);
+	}
+
+	void ReadbackBuffer::read_texture(const Texture3D& texture, uint32_t mip)
+	{
+		Int3 dimensions = texture.get_mip_dimensions(mip);
+		size_t size = (size_t)dimensions.x * dimensions.y * dimensions.z;
+		ASSERT(size <= m_Size);
+
+		// with a pack buffer bound the pointer is an offset into it
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_ID);
+		texture.get_data(nullptr, size, mip);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (m_Fence)
+			glDeleteSync((GLsync)m_Fence);
+		m_Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	bool ReadbackBuffer::is_ready() const
+	{
+		if (!m_Fence)
+			return false;
+
+		// the flush makes sure the fence actually reaches the GPU
+		GLenum status = glClientWaitSync((GLsync)m_Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+	}
+
+	owning_ptr<ReadbackBuffer> ReadbackBuffer::create(size_t size)
+	{
+		return owning_ptr<ReadbackBuffer>(new ReadbackBuffer(size));
+	}
+
+}
\ No newline at end of file
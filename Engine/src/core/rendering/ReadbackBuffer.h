@@ -0,0 +1,33 @@
+#pragma once
+
+namespace Engine {
+
+	class Texture3D;
+
+	// persistently mapped GL_PIXEL_PACK_BUFFER for texture readbacks that don't stall,
+	// read_texture only queues the copy, the data shows up a frame or two later
+	class ReadbackBuffer
+	{
+	private:
+		ReadbackBuffer(size_t size);
+	public:
+		~ReadbackBuffer();
+
+		// whole mip, has to fit into the buffer
+		void read_texture(const Texture3D& texture, uint32_t mip);
+
+		// never stalls, false until the GPU has written the last read_texture
+		bool is_ready() const;
+		// stays mapped, only valid once is_ready (safe to read from any thread then)
+		const uint8_t* get_data() const { return m_Mapped; }
+		size_t get_size() const { return m_Size; }
+
+		static owning_ptr<ReadbackBuffer> create(size_t size);
+	private:
+		uint32_t m_ID = 0;
+		size_t m_Size = 0;
+		const uint8_t* m_Mapped = nullptr;
+		void* m_Fence = nullptr; // GLsync
+	};
+
+}
\ No newline at end of file
@@ -11,15 +11,29 @@ namespace Engine {
 		m_ViewMatrix = view;
 		m_ProjectionMatrix = projection;
 		m_ViewProjectionMatrix = projection * view;
+
+		CameraUniforms camera;
+		camera.View = view;
+		camera.Projection = projection;
+		camera.ViewProjection = m_ViewProjectionMatrix;
+		camera.InverseView = glm::inverse(view);
+		camera.InverseProjection = glm::inverse(projection);
+		camera.Position = camera.InverseView[3];
+
+		if (!m_CameraBuffer)
+			m_CameraBuffer = UniformBuffer::create(sizeof(CameraUniforms));
+
+		m_CameraBuffer->set_data(&camera, sizeof(camera));
+		m_CameraBuffer->bind(CameraUniformBinding);
 	}
 
-	void RenderPipeline::init_pass(const RenderPass& pass)
+	bool RenderPipeline::init_pass(const RenderPass& pass)
 	{
 		auto shader = pass.pShader;
-		if (shader) {
-			shader->bind();
-			shader->set("u_ViewProjection", m_ViewProjectionMatrix);
-		}
+		if (shader && !shader->is_ready())
+			return false;
+		if (shader)
+			shader->bind(); // camera matrices come from the camera block
 
 		Graphics::set_face_cull(pass.CullFace);
 		Graphics::set_depth_test(pass.Depth.Test);
@@ -46,6 +60,7 @@ namespace Engine {
 
 		//glBlendFunc(pass.Blend.SFactor, pass.Blend.DFactor);
 		Graphics::toggle_blend(pass.Blend.Enable);
+		return true;
 	}
 
 }
\ No newline at end of file
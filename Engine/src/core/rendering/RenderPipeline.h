@@ -2,12 +2,27 @@
 
 #include "Graphics.h"
 #include "Framebuffer.h"
+#include "Buffer.h"
 
 namespace Engine {
 
+	// std140 mirror of CameraBlock in resources/shaders/camera.glinc
+	struct CameraUniforms
+	{
+		Matrix4 View;
+		Matrix4 Projection;
+		Matrix4 ViewProjection;
+		Matrix4 InverseView;
+		Matrix4 InverseProjection;
+		Float4 Position; // xyz, w unused (vec3 pads to 16 bytes anyway)
+	};
+	static_assert(sizeof(CameraUniforms) == 5 * 64 + 16);
+
 	// threw this together in a jif, improve later
 	struct RenderPass
 	{
+		const char* Name = "RenderPass"; // profiler zone
+
 		Matrix4 ViewMatrix;
 		Matrix4 ProjectionMatrix;
 
@@ -51,18 +66,25 @@ namespace Engine {
 	class RenderPipeline
 	{
 	public:
+		static constexpr uint32_t CameraUniformBinding = 0;
+
+		// uploads the camera block and binds it for everything drawn/dispatched this frame
 		void begin(const Matrix4& view, const Matrix4& projection);
 
 		template<typename F>
 		void submit_pass(const RenderPass& pass, F command)
 		{
-			init_pass(pass);
+			PROFILE_GPU_SCOPE(pass.Name);
+			if (!init_pass(pass))
+				return;
 			command();
 		}
 	private:
-		void init_pass(const RenderPass& pass);
+		bool init_pass(const RenderPass& pass); // false while the pass shader is still building, skip it
 	public:
 		Matrix4 m_ViewMatrix = Matrix4(1.0f), m_ProjectionMatrix = Matrix4(1.0f), m_ViewProjectionMatrix = Matrix4(1.0f);
+	private:
+		owning_ptr<UniformBuffer> m_CameraBuffer; // created on first begin, pipelines tend to exist before the context
 	};
 
 }
\ No newline at end of file
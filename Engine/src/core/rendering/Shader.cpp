@@ -2,115 +2,102 @@
 
 #include "Shader.h"
 #include "Texture.h"
+#include "Graphics.h"
+#include "ProgramCache.h"
+
+#include "threading/JobSystem.h"
 
 #include <glad/glad.h>
+#include <chrono>
 #include <fstream>
+#include <regex>
 
-namespace Engine {
-
-	Shader::~Shader()
-	{
-		glDeleteProgram(m_ID);
-	}
-
-	void Shader::bind() const
-	{
-		glUseProgram(m_ID);
-	}
-
-	int Shader::get_or_cache_uniform_location(const std::string& name)
-	{
-		int location = -1;
-		if (!m_UniformLocations.count(name))
-			m_UniformLocations[name] = glGetUniformLocation(m_ID, name.c_str());
+#ifndef GL_COMPLETION_STATUS_KHR
+	#define GL_COMPLETION_STATUS_KHR 0x91B1 // GL_KHR_parallel_shader_compile, not in our glad
+#endif
 
-		location = m_UniformLocations[name];
-		//if (location == -1)
-		//	LOG("couldn't get uniform '{}' location in shader", name);
-
-		return location;
-	}
+namespace Engine {
 
 	template<>
-	void Shader::set(const std::string& name, const int& v)
+	void Shader::set(UniformID id, const int& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform1i(m_ID, location, v);
 	}
 	template<>
-	void Shader::set(const std::string& name, const bool& v)
+	void Shader::set(UniformID id, const bool& v)
 	{
-		set(name, static_cast<int>(v));
+		set(id, static_cast<int>(v));
 	}
 	template<>
-	void Shader::set(const std::string& name, const uint32_t& v)
+	void Shader::set(UniformID id, const uint32_t& v)
 	{
-		set(name, static_cast<int>(v));
+		set(id, static_cast<int>(v));
 	}
 	template<>
-	void Shader::set(const std::string& name, const uint64_t& v)
+	void Shader::set(UniformID id, const uint64_t& v)
 	{
-		set(name, static_cast<int>(v));
+		set(id, static_cast<int>(v));
 	}
 	template<>
-	void Shader::set(const std::string& name, const Int2& v)
+	void Shader::set(UniformID id, const Int2& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform2i(m_ID, location, v.x, v.y);
 	}
 	template<>
-	void Shader::set(const std::string& name, const Int3& v)
+	void Shader::set(UniformID id, const Int3& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform3i(m_ID, location, v.x, v.y, v.z);
 	}
 
 	template<>
-	void Shader::set(const std::string& name, const Int4& v)
+	void Shader::set(UniformID id, const Int4& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform4i(m_ID, location, v.x, v.y, v.z, v.w);
 	}
 
 	template<>
-	void Shader::set(const std::string& name, const float& value)
+	void Shader::set(UniformID id, const float& value)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform1f(m_ID, location, value);
 	}
 
 	template<>
-	void Shader::set(const std::string& name, const Float2& v)
+	void Shader::set(UniformID id, const Float2& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform2f(m_ID, location, v.x, v.y);
 	}
 
 	template<>
-	void Shader::set(const std::string& name, const Float3& v)
+	void Shader::set(UniformID id, const Float3& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform3f(m_ID, location, v.x, v.y, v.z);
 	}
 
 	template<>
-	void Shader::set(const std::string& name, const Float4& v)
+	void Shader::set(UniformID id, const Float4& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniform4f(m_ID, location, v.x, v.y, v.z, v.w);
 	}
 
 	template<>
-	void Shader::set(const std::string& name, const Matrix4& v)
+	void Shader::set(UniformID id, const Matrix4& v)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniformMatrix4fv(m_ID, location, 1, false, glm::value_ptr(v));
 	}
 
 	template<>
-	void Shader::set(const std::string& name, const std::initializer_list<uint64_t>& bindless_textures)
+	void Shader::set(UniformID id, const std::initializer_list<uint64_t>& bindless_textures)
 	{
-		int location = get_or_cache_uniform_location(name);
+		int location = get_or_cache_uniform_location(id);
 		glProgramUniformHandleui64vARB(m_ID, location, bindless_textures.size(), bindless_textures.begin());
 	}
 
@@ -142,53 +129,140 @@ namespace Engine {
 		return contents;
 	}
 
-	// kind of scuffed preprocessing system - but does the job for now
-	// mostly to support "#include"s and stuff in shaders organization
-	static std::array<std::string, 2> preprocess_shader_string(const std::string& source, const std::filesystem::path& directory)
+	// "#type" splits the stages, "#include" is recursive and relative to the including file,
+	// "#pragma once" holds per stage since every stage is its own compile unit
+	// "#line" directives keep driver errors pointing at the file they came from, files[n] is source string n
+	struct PreprocessedShader
+	{
+		std::array<std::string, 2> stages; // vertex (or compute), fragment
+		std::vector<std::filesystem::path> files; // canonical, [0] is the shader itself
+	};
+
+	static constexpr uint32_t MaxIncludeDepth = 32;
+
+	struct PreprocessState
 	{
-		std::array<std::string, 2> result; // vertex, fragment
-		result[0].reserve(source.length());
-		result[1].reserve(source.length());
+		PreprocessedShader result;
+		size_t stage = 0;
+		bool versionSeen = false; // nothing may come before #version, #line included
+		std::string defines; // variant defines, right after every #version
+		std::vector<std::filesystem::path> onceFiles; // "#pragma once" files already in the current stage
+	};
+
+	static size_t get_file_index(PreprocessedShader& shader, const std::filesystem::path& filepath)
+	{
+		auto it = std::find(shader.files.begin(), shader.files.end(), filepath);
+		if (it != shader.files.end())
+			return it - shader.files.begin();
+
+		shader.files.push_back(filepath);
+		return shader.files.size() - 1;
+	}
 
-		const char PreprocessorToken = '#';
+	static void preprocess_file(PreprocessState& state, const std::filesystem::path& filepath, uint32_t depth)
+	{
+		size_t fileIndex = get_file_index(state.result, filepath);
+		std::string source = read_file(filepath);
 
-		size_t currentShaderType = 0; // vertex
-		for (size_t i = 0; i < source.length(); i++)
+		std::string_view remaining = source;
+		uint32_t lineNumber = 0;
+		while (!remaining.empty())
 		{
-			char current = source[i];
+			size_t lineEnd = remaining.find('\n');
+			std::string_view line = remaining.substr(0, lineEnd);
+			remaining = lineEnd == std::string_view::npos ? std::string_view() : remaining.substr(lineEnd + 1);
+			lineNumber++;
 
-			if (strncmp(&source[i], "#type ", 6) == 0)
+			std::string_view directive = line.substr(glm::min(line.find_first_not_of(" \t"), line.size()));
+			std::string& output = state.result.stages[state.stage];
+
+			if (directive.starts_with("#type ") && depth == 0)
 			{
-				const char* type = &source[i + 6];
-				if (strncmp(type, "vertex", 6) == 0) {
-					currentShaderType = 0;
-					i += 12;
-				}
-				else if (strncmp(type, "fragment", 8) == 0) {
-					currentShaderType = 1;
-					i += 14;
-				}
+				state.stage = directive.substr(6).starts_with("fragment") ? 1 : 0;
+				state.versionSeen = false;
+				state.onceFiles.clear();
+			}
+			else if (directive.starts_with("#version"))
+			{
+				output += line;
+				output += '\n';
+				output += state.defines;
+				output += std::format("#line {} {}\n", lineNumber + 1, fileIndex);
+				state.versionSeen = true;
+			}
+			else if (directive.starts_with("#pragma once"))
+			{
+				state.onceFiles.push_back(filepath);
+				output += '\n';
 			}
-			else if (strncmp(&source[i], "#include ", 9) == 0)
+			else if (directive.starts_with("#include "))
 			{
-				const char* file = &source[i + 10];
-				std::string fileName = std::string(std::string_view(file, find_nth_index_of_char(file, 0, '"')));
+				size_t open = directive.find('"');
+				size_t close = open == std::string_view::npos ? open : directive.find('"', open + 1);
+				if (close == std::string_view::npos)
+				{
+					LOG("malformed #include in '{}' line {}", filepath.string(), lineNumber);
+					output += '\n';
+					continue;
+				}
 
-				auto filePath = directory / fileName;
-				std::string fileSource = read_file(filePath.string());
-				result[currentShaderType] += fileSource;
+				std::filesystem::path includePath = std::filesystem::weakly_canonical(filepath.parent_path() / directive.substr(open + 1, close - open - 1));
+				if (std::find(state.onceFiles.begin(), state.onceFiles.end(), includePath) != state.onceFiles.end())
+				{
+					output += '\n';
+					continue;
+				}
+				if (depth >= MaxIncludeDepth)
+				{
+					LOG("#include of '{}' nested too deep in '{}', missing #pragma once?", includePath.string(), filepath.string());
+					output += '\n';
+					continue;
+				}
 
-				i += 10 + fileName.length();
+				if (state.versionSeen)
+					output += std::format("#line 1 {}\n", get_file_index(state.result, includePath));
+				preprocess_file(state, includePath, depth + 1);
+				if (state.versionSeen)
+					state.result.stages[state.stage] += std::format("#line {} {}\n", lineNumber + 1, fileIndex);
 			}
 			else
 			{
-				result[currentShaderType] += current;
+				output += line;
+				output += '\n';
 			}
 		}
+	}
+
+	static PreprocessedShader preprocess_shader(const std::filesystem::path& filepath, const std::string& defines)
+	{
+		PreprocessState state;
+		state.defines = defines;
+		preprocess_file(state, std::filesystem::weakly_canonical(filepath), 0);
+		return std::move(state.result);
+	}
+
+	// drivers report "<source>(<line>)" (nvidia) or "<source>:<line>" (mesa, amd, intel), swap the source number for the file
+	static std::string map_info_log(const char* log, const std::vector<std::filesystem::path>& files)
+	{
+		static const std::regex Location(R"((^|\n)(ERROR: |WARNING: )?(\d+)[:(](\d+)\)?)");
+
+		std::string result;
+		const char* cursor = log;
+		for (std::cregex_iterator it(log, log + strlen(log), Location), end; it != end; ++it)
+		{
+			const std::cmatch& match = *it;
+			result.append(cursor, match[0].first);
+			cursor = match[0].second;
+
+			size_t index = std::stoul(match[3].str());
+			if (index < files.size())
+				result += std::format("{}{}{}:{}", match[1].str(), match[2].str(), files[index].filename().string(), match[4].str());
+			else
+				result += match[0].str();
+		}
+		result += cursor;
 
-		result[0].shrink_to_fit();
-		result[1].shrink_to_fit();
-		return { result[0], result[1] };
+		return result;
 	}
 
 	static const char* shader_type_to_string(ShaderType type)
@@ -201,137 +275,543 @@ namespace Engine {
 		}
 	}
 
-	static uint32_t create_and_attach_shader_to_program(uint32_t program, ShaderType type, const std::string& source, const std::string& name)
+	// sorted by name, first define not less than name
+	static auto find_define(auto& defines, const std::string& name)
+	{
+		return std::lower_bound(defines.begin(), defines.end(), name, [](const auto& define, const std::string& name) { return define.first < name; });
+	}
+
+	ShaderDefines::ShaderDefines(std::initializer_list<std::pair<const char*, int32_t>> defines)
+	{
+		for (const auto& [name, value] : defines)
+			set(name, value);
+	}
+
+	ShaderDefines& ShaderDefines::set(const std::string& name, int32_t value)
+	{
+		return set_value(name, std::to_string(value));
+	}
+
+	ShaderDefines& ShaderDefines::set(const std::string& name, float value)
+	{
+		// always a float literal in GLSL, "10" would be an int
+		std::string literal = std::format("{:.8g}", value);
+		if (literal.find_first_of(".en") == std::string::npos)
+			literal += ".0";
+		return set_value(name, std::move(literal));
+	}
+
+	ShaderDefines& ShaderDefines::set_value(const std::string& name, std::string value)
+	{
+		auto it = find_define(m_Defines, name);
+		if (it != m_Defines.end() && it->first == name)
+			it->second = std::move(value);
+		else
+			m_Defines.insert(it, { name, std::move(value) });
+
+		return *this;
+	}
+
+	bool ShaderDefines::has(const std::string& name) const
+	{
+		auto it = find_define(m_Defines, name);
+		return it != m_Defines.end() && it->first == name;
+	}
+
+	int32_t ShaderDefines::get_int(const std::string& name, int32_t fallback) const
+	{
+		auto it = find_define(m_Defines, name);
+		if (it == m_Defines.end() || it->first != name)
+			return fallback;
+
+		return std::stoi(it->second);
+	}
+
+	std::string ShaderDefines::get_source() const
+	{
+		std::string source;
+		for (const auto& [name, value] : m_Defines)
+			source += std::format("#define {} {}\n", name, value);
+
+		return source;
+	}
+
+	uint64_t ShaderDefines::get_key() const
+	{
+		return UniformID::hash_name(get_source().c_str());
+	}
+
+	static uint64_t get_variant_key(const std::filesystem::path& filepath, const ShaderDefines& defines)
+	{
+		return UniformID::hash_name(filepath.generic_string().c_str()) ^ (defines.get_key() * 1099511628211ull);
+	}
+
+	struct ShaderStage
+	{
+		ShaderType type;
+		const std::string* source;
+	};
+
+	// a program handed to the driver whose status nobody asked for yet
+	struct PendingProgram
+	{
+		uint64_t cacheKey = 0;
+		uint32_t program = 0;
+		std::vector<std::pair<ShaderType, uint32_t>> shaders; // empty when it came out of the program cache
+		double submitMs = 0.0;
+	};
+
+	// a valid binary in the program cache skips compiling entirely, otherwise compile and link are only issued here.
+	// querying any status right away would block on the compiler, this way the driver works on every submitted
+	// program at once (on its own threads with parallel_shader_compile)
+	static PendingProgram submit_program(const PreprocessedShader& preprocessed, bool compute)
+	{
+		ShaderStage stages[2];
+		uint32_t stageCount = 0;
+		if (compute)
+		{
+			stages[stageCount++] = { ShaderType::Compute, &preprocessed.stages[0] };
+		}
+		else
+		{
+			stages[stageCount++] = { ShaderType::Vertex, &preprocessed.stages[0] };
+			if (!preprocessed.stages[1].empty())
+				stages[stageCount++] = { ShaderType::Fragment, &preprocessed.stages[1] };
+		}
+
+		PendingProgram pending;
+		pending.cacheKey = ProgramCache::get_driver_key();
+		for (uint32_t i = 0; i < stageCount; i++)
+			pending.cacheKey = ProgramCache::hash_stage(pending.cacheKey, (uint32_t)stages[i].type, *stages[i].source);
+
+		pending.program = ProgramCache::load(pending.cacheKey);
+		if (pending.program)
+			return pending;
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		pending.program = glCreateProgram();
+		for (uint32_t i = 0; i < stageCount; i++)
+		{
+			uint32_t shader = glCreateShader((GLenum)stages[i].type);
+
+			const char* src = stages[i].source->c_str();
+			glShaderSource(shader, 1, &src, 0);
+			glCompileShader(shader);
+			glAttachShader(pending.program, shader);
+
+			pending.shaders.push_back({ stages[i].type, shader });
+		}
+
+		if (ProgramCache::is_enabled())
+			glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(pending.program);
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		pending.submitMs = elapsed.count();
+
+		return pending;
+	}
+
+	static bool is_program_complete(const PendingProgram& pending)
+	{
+		// without the extension there's no asking without blocking, the status query will wait
+		if (pending.shaders.empty() || !Graphics::get_extensions().parallel_shader_compile)
+			return true;
+
+		int isComplete = 0;
+		glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &isComplete);
+		return isComplete;
+	}
+
+	static void discard_program(PendingProgram& pending)
 	{
-		uint32_t shader = glCreateShader((GLenum)type);
+		for (auto [type, shader] : pending.shaders)
+		{
+			glDetachShader(pending.program, shader);
+			glDeleteShader(shader);
+		}
+		pending.shaders.clear();
 
-		const char* src = source.c_str();
-		glShaderSource(shader, 1, &src, 0);
-		glCompileShader(shader);
+		glDeleteProgram(pending.program);
+		pending.program = 0;
+	}
 
-		int isCompiled = 0;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+	// blocks if the driver isn't done yet, 0 if it didn't compile or link, the log says why
+	static uint32_t finish_program(PendingProgram& pending, const PreprocessedShader& preprocessed)
+	{
+		if (pending.shaders.empty())
+			return pending.program;
 
-		if (!isCompiled)
+		auto start = std::chrono::high_resolution_clock::now();
+		std::string name = preprocessed.files[0].filename().string();
+
+		bool isCompiled = true;
+		for (auto [type, shader] : pending.shaders)
 		{
+			int status = 0;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status)
+				continue;
+
 			int maxLength = 0;
 			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
 
-			std::vector<char> infoLog(maxLength);
+			std::vector<char> infoLog(maxLength + 1);
 			glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
 
+			LOG("{} shader compilation failure (\"{}\")", shader_type_to_string(type), name);
+			LOG(map_info_log(infoLog.data(), preprocessed.files));
+			isCompiled = false;
+		}
+
+		int isLinked = 0;
+		glGetProgramiv(pending.program, GL_LINK_STATUS, &isLinked);
+		if (!isLinked && isCompiled)
+		{
+			int maxLength = 0;
+			glGetProgramiv(pending.program, GL_INFO_LOG_LENGTH, &maxLength);
+
+			std::vector<char> infoLog(maxLength + 1);
+			glGetProgramInfoLog(pending.program, maxLength, &maxLength, &infoLog[0]);
+
+			LOG("shader link failure (\"{}\")", name);
+			LOG(map_info_log(infoLog.data(), preprocessed.files));
+		}
+
+		if (!isLinked)
+		{
+			discard_program(pending);
+			return 0;
+		}
+
+		for (auto [type, shader] : pending.shaders)
+		{
+			glDetachShader(pending.program, shader);
 			glDeleteShader(shader);
+		}
+		pending.shaders.clear();
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		ProgramCache::add_compile_time(pending.submitMs + elapsed.count());
+		ProgramCache::store(pending.cacheKey, pending.program);
+
+		return pending.program;
+	}
+
+	struct Shader::PendingBuild
+	{
+		Shader* shader = nullptr;
+		JobFuture<PreprocessedShader> preprocessed; // file reads and preprocessing run on the job system
+		PendingProgram program;
+		bool submitted = false;
+	};
+
+	std::vector<Shader::PendingBuild> Shader::s_PendingBuilds;
 
-			LOG("shader compilation failure (\"{}\")", name);
-			LOG(infoLog.data());
-			ASSERT(false);
+	Shader::Shader()
+	{
+		s_Shaders.push_back(this);
+	}
+
+	Shader::~Shader()
+	{
+		std::erase(s_Shaders, this);
+
+		auto it = std::find_if(s_PendingBuilds.begin(), s_PendingBuilds.end(), [this](const PendingBuild& build) { return build.shader == this; });
+		if (it != s_PendingBuilds.end())
+		{
+			if (it->submitted)
+				discard_program(it->program);
+			s_PendingBuilds.erase(it);
 		}
 
-		glAttachShader(program, shader);
-		return shader;
+		Graphics::forget_program(m_ID);
+		glDeleteProgram(m_ID);
+	}
+
+	void Shader::bind()
+	{
+		if (!m_ID)
+			wait();
+
+		Graphics::bind_program(m_ID);
 	}
 
-	owning_ptr<Shader> Shader::create(const std::filesystem::path& filepath)
+	int Shader::get_or_cache_uniform_location(UniformID id)
 	{
-		auto result = owning_ptr<Shader>(new Shader());
+		auto it = m_UniformLocations.find(id.hash);
+		if (it != m_UniformLocations.end())
+			return it->second;
 
-		constexpr uint32_t ShaderTypeCount = 2;
-		std::string fileContents = read_file(filepath);
+		// no program to ask yet, a rebuilding shader keeps answering for its current one
+		if (!m_ID)
+			wait();
 
-		std::array<std::string, 2> shaderSources = preprocess_shader_string(fileContents, filepath.parent_path());
-		bool noFragmentShader = shaderSources[1].empty();
+		int location = glGetUniformLocation(m_ID, id.name);
+		//if (location == -1)
+		//	LOG("couldn't get uniform '{}' location in shader", id.name);
 
-		uint32_t program = glCreateProgram();
-		std::vector<uint32_t> shaderIDs;
-		shaderIDs.reserve(ShaderTypeCount);
+		m_UniformLocations.emplace(id.hash, location);
+		return location;
+	}
 
-		for (int i = 0; i < ShaderTypeCount - noFragmentShader; i++)
+	void Shader::begin_build()
+	{
+		auto it = std::find_if(s_PendingBuilds.begin(), s_PendingBuilds.end(), [this](const PendingBuild& build) { return build.shader == this; });
+		if (it != s_PendingBuilds.end())
 		{
-			uint32_t shader = create_and_attach_shader_to_program(program, i == 0 ? ShaderType::Vertex : ShaderType::Fragment, shaderSources[i], filepath.filename().string());
-			shaderIDs.push_back(shader);
+			if (it->submitted)
+				discard_program(it->program);
+			s_PendingBuilds.erase(it);
 		}
 
-		result->m_ID = program;
-		glLinkProgram(program);
+		PendingBuild& build = s_PendingBuilds.emplace_back();
+		build.shader = this;
+		build.preprocessed = JobSystem::async([filepath = m_Filepath, defines = m_Defines.get_source()]() { return preprocess_shader(filepath, defines); });
+	}
 
-		int isLinked = 0;
-		glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
-		if (!isLinked)
+	void Shader::submit_build(PendingBuild& build)
+	{
+		build.program = submit_program(build.preprocessed.get(), build.shader->m_IsCompute);
+		build.submitted = true;
+	}
+
+	bool Shader::finish_build(PendingBuild& build)
+	{
+		Shader* shader = build.shader;
+		const PreprocessedShader& preprocessed = build.preprocessed.get();
+		shader->m_Dependencies = preprocessed.files;
+
+		uint32_t program = finish_program(build.program, preprocessed);
+		if (!program)
 		{
-			int maxLength = 0;
-			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+			if (shader->m_ID)
+				LOG("keeping the previous program of '{}'", shader->m_Filepath.string());
+			return false;
+		}
+
+		// new program, new locations
+		Graphics::forget_program(shader->m_ID);
+		glDeleteProgram(shader->m_ID);
+		shader->m_ID = program;
+		shader->m_UniformLocations.clear();
 
-			std::vector<char> infoLog(maxLength);
-			glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+		return true;
+	}
+
+	bool Shader::is_ready()
+	{
+		auto it = std::find_if(s_PendingBuilds.begin(), s_PendingBuilds.end(), [this](const PendingBuild& build) { return build.shader == this; });
+		if (it == s_PendingBuilds.end())
+			return m_ID != 0;
 
-			glDeleteProgram(program);
-			
-			for (auto id : shaderIDs)
-				glDeleteShader(id);
+		if (!it->submitted && it->preprocessed.is_ready())
+			submit_build(*it);
 
-			LOG(infoLog.data());
-			ASSERT(false && "failed to link shader");
-			
-			return nullptr;
+		if (it->submitted && is_program_complete(it->program))
+		{
+			finish_build(*it);
+			s_PendingBuilds.erase(it);
 		}
 
-		for (uint32_t id : shaderIDs)
+		return m_ID != 0;
+	}
+
+	bool Shader::wait()
+	{
+		auto it = std::find_if(s_PendingBuilds.begin(), s_PendingBuilds.end(), [this](const PendingBuild& build) { return build.shader == this; });
+		if (it == s_PendingBuilds.end())
+			return m_ID != 0;
+
+		// everyone else ready to go gets submitted first, the driver can work on them while we block
+		size_t index = it - s_PendingBuilds.begin();
+		for (PendingBuild& build : s_PendingBuilds)
 		{
-			glDetachShader(program, id);
-			glDeleteShader(id);
+			if (!build.submitted && build.preprocessed.is_ready())
+				submit_build(build);
 		}
 
-		return result;
+		PendingBuild& build = s_PendingBuilds[index];
+		if (!build.submitted)
+			submit_build(build); // waits for the preprocessing, helping out with other jobs meanwhile
+
+		bool succeeded = finish_build(build);
+		s_PendingBuilds.erase(s_PendingBuilds.begin() + index);
+
+		return succeeded;
 	}
 
-	ComputeShader::~ComputeShader()
+	void Shader::update_builds()
 	{
-		glDeleteProgram(m_ID);
+		// submit everything first, only then start asking
+		for (PendingBuild& build : s_PendingBuilds)
+		{
+			if (!build.submitted && build.preprocessed.is_ready())
+				submit_build(build);
+		}
+
+		for (size_t i = 0; i < s_PendingBuilds.size();)
+		{
+			PendingBuild& build = s_PendingBuilds[i];
+			if (build.submitted && is_program_complete(build.program))
+			{
+				finish_build(build);
+				s_PendingBuilds.erase(s_PendingBuilds.begin() + i);
+			}
+			else
+			{
+				i++;
+			}
+		}
 	}
 
-	void ComputeShader::dispatch(uint32_t x, uint32_t y, uint32_t z) const
+	uint32_t Shader::wait_for_builds()
 	{
-		glUseProgram(m_ID);
-		glDispatchCompute(x, y, z);
-		//glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		for (PendingBuild& build : s_PendingBuilds)
+		{
+			if (!build.submitted)
+				submit_build(build);
+		}
+
+		uint32_t succeeded = 0;
+		for (PendingBuild& build : s_PendingBuilds)
+			succeeded += finish_build(build);
+		s_PendingBuilds.clear();
+
+		return succeeded;
 	}
 
-	owning_ptr<ComputeShader> ComputeShader::create(const std::filesystem::path& filepath)
+	uint32_t Shader::get_pending_build_count()
 	{
-		auto compute = owning_ptr<ComputeShader>(new ComputeShader());
+		return (uint32_t)s_PendingBuilds.size();
+	}
+
+	bool Shader::reload()
+	{
+		begin_build();
+		return wait();
+	}
 
-		constexpr uint32_t ShaderTypeCount = 2;
-		std::string fileContents = read_file(filepath);
+	bool Shader::depends_on(const std::filesystem::path& filepath) const
+	{
+		return std::find(m_Dependencies.begin(), m_Dependencies.end(), filepath) != m_Dependencies.end();
+	}
 
-		uint32_t program = glCreateProgram();
-		uint32_t shader = create_and_attach_shader_to_program(program, ShaderType::Compute, fileContents, filepath.filename().string());
+	uint32_t Shader::reload_all()
+	{
+		for (Shader* shader : s_Shaders)
+			shader->begin_build();
 
-		compute->m_ID = program;
-		glLinkProgram(program);
+		return wait_for_builds();
+	}
 
-		int isLinked = 0;
-		glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
-		if (!isLinked)
+	uint32_t Shader::reload_changed(const std::vector<std::filesystem::path>& filepaths)
+	{
+		bool anyChanged = false;
+		for (Shader* shader : s_Shaders)
 		{
-			int maxLength = 0;
-			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+			bool changed = std::any_of(filepaths.begin(), filepaths.end(), [&](const std::filesystem::path& filepath) { return shader->depends_on(filepath); });
+			if (!changed)
+				continue;
 
-			std::vector<char> infoLog(maxLength);
-			glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+			LOG("reloading '{}'", shader->m_Filepath.string());
+			shader->begin_build();
+			anyChanged = true;
+		}
 
-			glDeleteProgram(program);
-			glDeleteShader(shader);
+		return anyChanged ? wait_for_builds() : 0;
+	}
+
+	owning_ptr<Shader> Shader::create(const std::filesystem::path& filepath, const ShaderDefines& defines)
+	{
+		auto result = create_async(filepath, defines);
+		if (!result->wait())
+		{
+			ASSERT(false && "failed to build shader");
+			return nullptr;
+		}
+
+		return result;
+	}
+
+	owning_ptr<Shader> Shader::create_async(const std::filesystem::path& filepath, const ShaderDefines& defines)
+	{
+		auto result = owning_ptr<Shader>(new Shader());
+		result->m_Filepath = filepath;
+		result->m_Defines = defines;
+		result->begin_build();
+
+		return result;
+	}
+
+	Shader* Shader::get_variant(const std::filesystem::path& filepath, const ShaderDefines& defines)
+	{
+		auto& variant = s_Variants[get_variant_key(filepath, defines)];
+		if (!variant)
+			variant = create_async(filepath, defines);
+
+		return variant.get();
+	}
+
+	ComputeShader::~ComputeShader()
+	{
+		Graphics::forget_program(m_ID);
+		glDeleteProgram(m_ID);
+	}
 
-			LOG(infoLog.data());
-			ASSERT(false && "failed to link shader");
+	void ComputeShader::dispatch(uint32_t x, uint32_t y, uint32_t z)
+	{
+		PROFILE_GPU_SCOPE(m_ProfileName);
+		bind();
+		glDispatchCompute(x, y, z);
+		//glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
 
+	void ComputeShader::dispatch_threads(uint32_t x, uint32_t y, uint32_t z)
+	{
+		dispatch(
+			(x + m_LocalSize.x - 1) / m_LocalSize.x,
+			(y + m_LocalSize.y - 1) / m_LocalSize.y,
+			(z + m_LocalSize.z - 1) / m_LocalSize.z
+		);
+	}
+
+	owning_ptr<ComputeShader> ComputeShader::create(const std::filesystem::path& filepath, const ShaderDefines& defines)
+	{
+		auto compute = create_async(filepath, defines);
+		if (!compute->wait())
+		{
+			ASSERT(false && "failed to build shader");
 			return nullptr;
 		}
 
-		glDetachShader(program, shader);
-		glDeleteShader(shader);
+		return compute;
+	}
+
+	owning_ptr<ComputeShader> ComputeShader::create_async(const std::filesystem::path& filepath, const ShaderDefines& defines)
+	{
+		auto compute = owning_ptr<ComputeShader>(new ComputeShader());
+		compute->m_ProfileName = Profiler::intern(filepath.stem().string());
+		compute->m_Filepath = filepath;
+		compute->m_IsCompute = true; // no #type in compute shaders, everything lands in the first stage
+
+		compute->m_Defines = defines;
+		compute->m_LocalSize = Int3(defines.get_int("LOCAL_SIZE_X", 1), defines.get_int("LOCAL_SIZE_Y", 1), defines.get_int("LOCAL_SIZE_Z", 1));
+		compute->m_Defines.set("LOCAL_SIZE_X", compute->m_LocalSize.x).set("LOCAL_SIZE_Y", compute->m_LocalSize.y).set("LOCAL_SIZE_Z", compute->m_LocalSize.z);
+
+		compute->begin_build();
 
 		return compute;
 	}
 
+	ComputeShader* ComputeShader::get_variant(const std::filesystem::path& filepath, const ShaderDefines& defines)
+	{
+		auto& variant = s_Variants[get_variant_key(filepath, defines)];
+		if (!variant)
+			variant = create_async(filepath, defines);
+
+		return variant.get();
+	}
+
 }
\ No newline at end of file
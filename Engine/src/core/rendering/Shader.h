@@ -9,24 +9,121 @@ namespace Engine {
 		Compute = 0x91B9,
 	};
 
+	// uniform name hashed at compile time (FNV-1a), so string literals never become std::strings
+	// runtime names (std::format) still work, they're hashed on the spot
+	struct UniformID
+	{
+		uint64_t hash = 0;
+		const char* name = nullptr; // only used to resolve the location the first time
+
+		consteval UniformID(const char* uniform_name)
+			: hash(hash_name(uniform_name)), name(uniform_name)
+		{
+		}
+		UniformID(const std::string& uniform_name)
+			: hash(hash_name(uniform_name.c_str())), name(uniform_name.c_str())
+		{
+		}
+
+		static constexpr uint64_t hash_name(const char* string)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (; *string; string++)
+				hash = (hash ^ (uint8_t)*string) * 1099511628211ull;
+			return hash;
+		}
+
+		// for maps keyed by the hash, it's already hashed
+		struct Hash
+		{
+			size_t operator()(uint64_t hash) const { return (size_t)hash; }
+		};
+	};
+
+	// "#define NAME value" lines of one shader variant, injected right after #version in every stage
+	// kept sorted by name so the same set gives the same key whatever order it was put together in
+	class ShaderDefines
+	{
+	public:
+		ShaderDefines() = default;
+		ShaderDefines(std::initializer_list<std::pair<const char*, int32_t>> defines);
+
+		ShaderDefines& set(const std::string& name, int32_t value);
+		ShaderDefines& set(const std::string& name, float value);
+
+		bool has(const std::string& name) const;
+		int32_t get_int(const std::string& name, int32_t fallback = 0) const;
+
+		std::string get_source() const;
+		uint64_t get_key() const;
+	private:
+		ShaderDefines& set_value(const std::string& name, std::string value);
+	private:
+		std::vector<std::pair<std::string, std::string>> m_Defines;
+	};
+
+	// programs build asynchronously: files are read and preprocessed on the job system, compile and link are
+	// submitted for every pending shader before any status is asked for, so the driver can build them side by side
+	// (GL_KHR_parallel_shader_compile). a shader without a program waits for its own build on first use only
 	class Shader
 	{
 	protected:
-		Shader() = default;
+		Shader();
 	public:
 		~Shader();
 
-		void bind() const;
+		void bind();
 
 		template<typename T>
-		void set(const std::string& name, const T& v);
+		void set(UniformID id, const T& v);
+
+		int get_or_cache_uniform_location(UniformID id);
+
+		// has a program to use, never blocks: picks up a finished build on the way
+		bool is_ready();
+		// blocks until this shader's build is done, false if it failed
+		bool wait();
+
+		// rebuilds from the same file in place, the previous program stays if the new one doesn't build
+		bool reload();
+		bool depends_on(const std::filesystem::path& filepath) const; // canonical path
+		const std::filesystem::path& get_filepath() const { return m_Filepath; }
 
-		int get_or_cache_uniform_location(const std::string& name);
+		static owning_ptr<Shader> create(const std::filesystem::path& filepath, const ShaderDefines& defines = {});
+		static owning_ptr<Shader> create_async(const std::filesystem::path& filepath, const ShaderDefines& defines = {});
+		// one shared variant per file and define set, owned by the cache. starts building on the first request
+		static Shader* get_variant(const std::filesystem::path& filepath, const ShaderDefines& defines);
+
+		// GL thread, once per frame: submits whatever finished preprocessing, then picks up what the driver finished
+		static void update_builds();
+		// everything in flight, returns how many built
+		static uint32_t wait_for_builds();
+		static uint32_t get_pending_build_count();
+
+		// every live shader, compute ones included, as one batch. returns how many rebuilt
+		static uint32_t reload_all();
+		// only the ones including one of filepaths (canonical, e.g. from FileWatcher), directly or not
+		static uint32_t reload_changed(const std::vector<std::filesystem::path>& filepaths);
+	protected:
+		void begin_build(); // replaces a build already in flight
+	private:
+		struct PendingBuild;
 
-		static owning_ptr<Shader> create(const std::filesystem::path& filepath);
+		static void submit_build(PendingBuild& build);
+		static bool finish_build(PendingBuild& build);
 	protected:
 		uint32_t m_ID = 0;
-		std::unordered_map<std::string, int> m_UniformLocations;
+		std::unordered_map<uint64_t, int, UniformID::Hash> m_UniformLocations;
+
+		std::filesystem::path m_Filepath;
+		ShaderDefines m_Defines;
+		std::vector<std::filesystem::path> m_Dependencies; // the file itself and everything it includes
+		bool m_IsCompute = false;
+
+		static inline std::vector<Shader*> s_Shaders; // live ones, for reloading
+		static inline std::unordered_map<uint64_t, owning_ptr<Shader>> s_Variants;
+	private:
+		static std::vector<PendingBuild> s_PendingBuilds;
 	};
 
 	class ComputeShader : protected Shader
@@ -38,10 +135,27 @@ namespace Engine {
 
 		using Shader::bind;
 		using Shader::set;
+		using Shader::is_ready;
+		using Shader::wait;
+		using Shader::reload;
+		using Shader::get_filepath;
 
-		void dispatch(uint32_t x, uint32_t y, uint32_t z = 1) const;
+		void dispatch(uint32_t x, uint32_t y, uint32_t z = 1);
+		// enough groups to cover x * y * z invocations
+		void dispatch_threads(uint32_t x, uint32_t y = 1, uint32_t z = 1);
+
+		// LOCAL_SIZE_X/Y/Z from the defines (1 if missing, they're always defined for the shader)
+		// so the GLSL layout and the C++ group counts can't drift apart
+		const Int3& get_local_size() const { return m_LocalSize; }
+
+		static owning_ptr<ComputeShader> create(const std::filesystem::path& filepath, const ShaderDefines& defines = {});
+		static owning_ptr<ComputeShader> create_async(const std::filesystem::path& filepath, const ShaderDefines& defines = {});
+		static ComputeShader* get_variant(const std::filesystem::path& filepath, const ShaderDefines& defines);
+	private:
+		const char* m_ProfileName = "Compute";
+		Int3 m_LocalSize = Int3(1);
 
-		static owning_ptr<ComputeShader> create(const std::filesystem::path& filepath);
+		static inline std::unordered_map<uint64_t, owning_ptr<ComputeShader>> s_Variants;
 	};
 
 }
\ No newline at end of file
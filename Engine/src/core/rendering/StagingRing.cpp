@@ -0,0 +1,177 @@
+#include "pch.h"
+
+#include "StagingRing.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+
+namespace Engine {
+
+	void StagingRing::init(size_t capacity)
+	{
+		ASSERT(s_Buffer == 0);
+
+		constexpr GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &s_Buffer);
+		glNamedBufferStorage(s_Buffer, capacity, nullptr, Flags);
+		s_Mapped = (uint8_t*)glMapNamedBufferRange(s_Buffer, 0, capacity, Flags);
+
+		if (!s_Mapped)
+		{
+			LOG("staging ring: couldn't map {}MB, uploading directly", capacity / (1024 * 1024));
+			glDeleteBuffers(1, &s_Buffer);
+			s_Buffer = 0;
+			return;
+		}
+
+		s_Capacity = capacity;
+		s_Head = s_SegmentBegin = 0;
+	}
+
+	void StagingRing::shutdown()
+	{
+		if (!s_Buffer)
+			return;
+
+		for (Segment& segment : s_InFlight)
+			glDeleteSync((GLsync)segment.fence);
+		s_InFlight.clear();
+
+		glUnmapNamedBuffer(s_Buffer);
+		glDeleteBuffers(1, &s_Buffer);
+		s_Buffer = 0;
+		s_Mapped = nullptr;
+		s_Capacity = 0;
+	}
+
+	void StagingRing::fence_segment()
+	{
+		if (s_Head == s_SegmentBegin)
+			return;
+
+		Segment segment;
+		segment.begin = s_SegmentBegin;
+		segment.end = s_Head;
+		segment.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		s_InFlight.push_back(segment);
+
+		s_SegmentBegin = s_Head;
+	}
+
+	void StagingRing::end_frame()
+	{
+		fence_segment();
+
+		// retire whatever the GPU is done with, never blocks
+		while (!s_InFlight.empty())
+		{
+			GLenum status = glClientWaitSync((GLsync)s_InFlight.front().fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+
+			glDeleteSync((GLsync)s_InFlight.front().fence);
+			s_InFlight.pop_front();
+		}
+
+		s_Stats.last_frame_bytes = s_FrameBytes;
+		s_Stats.peak_frame_bytes = glm::max(s_Stats.peak_frame_bytes, (uint64_t)s_FrameBytes);
+		s_FrameBytes = 0;
+	}
+
+	void StagingRing::wait_for_range(size_t begin, size_t end)
+	{
+		// can't stop at the first segment that doesn't overlap, alignment padding may have skipped a small one
+		// ahead of one that does. fences signal in order, so waiting on the newest overlapping segment covers all older ones
+		size_t retire = 0;
+		for (size_t i = 0; i < s_InFlight.size(); i++)
+		{
+			const Segment& segment = s_InFlight[i];
+			if (segment.begin < end && segment.end > begin)
+				retire = i + 1;
+		}
+
+		if (retire == 0)
+			return;
+
+		GLsync fence = (GLsync)s_InFlight[retire - 1].fence;
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			while (true)
+			{
+				constexpr GLuint64 TimeoutNanoseconds = 1000000;
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, TimeoutNanoseconds);
+				if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED)
+					break;
+			}
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			s_Stats.stalls++;
+			s_Stats.stall_ms += elapsed.count();
+		}
+
+		for (size_t i = 0; i < retire; i++)
+		{
+			glDeleteSync((GLsync)s_InFlight.front().fence);
+			s_InFlight.pop_front();
+		}
+	}
+
+	size_t StagingRing::stage(const void* data, size_t size, size_t alignment)
+	{
+		s_Stats.uploads++;
+		s_FrameBytes += size;
+
+		if (!s_Mapped || size > s_Capacity)
+		{
+			s_Stats.bytes_direct += size;
+			return NotStaged;
+		}
+
+		size_t offset = (s_Head + alignment - 1) / alignment * alignment;
+		if (offset + size > s_Capacity)
+		{
+			// wrap, whatever was written up to here gets its own fence
+			fence_segment();
+			offset = 0;
+			s_SegmentBegin = 0;
+		}
+
+		wait_for_range(offset, offset + size);
+
+		memcpy(s_Mapped + offset, data, size);
+		s_Head = offset + size;
+		s_Stats.bytes_staged += size;
+
+		return offset;
+	}
+
+	void StagingRing::upload_buffer(uint32_t buffer, size_t offset, const void* data, size_t size)
+	{
+		size_t staged = stage(data, size, 4);
+		if (staged == NotStaged)
+		{
+			glNamedBufferSubData(buffer, offset, size, data);
+			return;
+		}
+
+		glCopyNamedBufferSubData(s_Buffer, buffer, staged, offset, size);
+	}
+
+	void StagingRing::bind_unpack(bool bind)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, bind ? s_Buffer : 0);
+	}
+
+	void StagingRing::log_stats()
+	{
+		const StagingStats& stats = s_Stats;
+		LOG("staging ring: {:.1f}MB staged, {:.1f}MB direct in {} uploads, {} stalls ({:.2f}ms)",
+			stats.bytes_staged / (1024.0 * 1024.0), stats.bytes_direct / (1024.0 * 1024.0), stats.uploads, stats.stalls, stats.stall_ms);
+		LOG("staging ring: {:.2f}MB last frame, {:.2f}MB peak, budget {:.1f}MB",
+			stats.last_frame_bytes / (1024.0 * 1024.0), stats.peak_frame_bytes / (1024.0 * 1024.0), s_FrameBudget / (1024.0 * 1024.0));
+	}
+
+}
\ No newline at end of file
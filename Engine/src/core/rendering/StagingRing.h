@@ -0,0 +1,92 @@
+#pragma once
+
+#include <deque>
+
+namespace Engine {
+
+	struct StagingStats
+	{
+		uint64_t bytes_staged = 0;  // went through the ring
+		uint64_t bytes_direct = 0;  // too big for the ring, uploaded from client memory
+		uint64_t uploads = 0;
+		uint64_t stalls = 0;        // waits for the GPU to release ring space
+		double stall_ms = 0.0;
+		uint64_t last_frame_bytes = 0;
+		uint64_t peak_frame_bytes = 0;
+	};
+
+	// persistently mapped, coherent upload buffer used as a ring
+	// uploads copy into the ring and the GPU pulls from there (glCopyNamedBufferSubData / pixel unpack buffer),
+	// so the driver neither copies nor stalls on client memory. the space is fenced per frame and reused
+	// once the GPU is done with it. GL thread only
+	class StagingRing
+	{
+	public:
+		static constexpr size_t NotStaged = ~(size_t)0;
+
+		static void init(size_t capacity = 64 * 1024 * 1024);
+		static void shutdown();
+
+		// fences this frame's uploads and resets the budget, once per frame after rendering
+		static void end_frame();
+
+		// copies data into the ring, returns its offset in the ring buffer
+		// NotStaged if it's larger than the ring (or the ring isn't initialised), upload directly then
+		static size_t stage(const void* data, size_t size, size_t alignment = 16);
+
+		// GPU side copy into a buffer object, falls back to glNamedBufferSubData
+		static void upload_buffer(uint32_t buffer, size_t offset, const void* data, size_t size);
+
+		// calls upload(pixels) with the ring bound as GL_PIXEL_UNPACK_BUFFER and pixels being the offset into it,
+		// or with the client pointer if it couldn't be staged
+		template<typename TUpload>
+		static void upload_pixels(const void* data, size_t size, const TUpload& upload)
+		{
+			size_t offset = stage(data, size);
+			if (offset == NotStaged)
+			{
+				upload(data);
+				return;
+			}
+
+			bind_unpack(true);
+			upload((const void*)offset);
+			bind_unpack(false);
+		}
+
+		// bytes per frame streaming code should stay under (uploads past it still go through)
+		static void set_frame_budget(size_t bytes) { s_FrameBudget = bytes; }
+		static size_t get_frame_budget() { return s_FrameBudget; }
+		static size_t get_frame_budget_remaining() { return s_FrameBytes < s_FrameBudget ? s_FrameBudget - s_FrameBytes : 0; }
+
+		static const StagingStats& get_stats() { return s_Stats; }
+		static void reset_stats() { s_Stats = {}; }
+		static void log_stats();
+
+		static uint32_t get_handle() { return s_Buffer; }
+		static size_t get_capacity() { return s_Capacity; }
+	private:
+		static void bind_unpack(bool bind);
+		static void fence_segment();
+		static void wait_for_range(size_t begin, size_t end);
+	private:
+		struct Segment
+		{
+			size_t begin = 0, end = 0;
+			void* fence = nullptr; // GLsync
+		};
+
+		static inline uint32_t s_Buffer = 0;
+		static inline uint8_t* s_Mapped = nullptr;
+		static inline size_t s_Capacity = 0;
+
+		static inline size_t s_Head = 0;         // next free byte
+		static inline size_t s_SegmentBegin = 0; // start of the not yet fenced uploads
+		static inline std::deque<Segment> s_InFlight; // oldest first
+
+		static inline size_t s_FrameBudget = 16 * 1024 * 1024;
+		static inline size_t s_FrameBytes = 0;
+		static inline StagingStats s_Stats;
+	};
+
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <glad/glad.h>
 #include "Texture.h"
+#include "Graphics.h"
+#include "StagingRing.h"
 
 #include <stb_image/stb_image.h>
 
@@ -22,12 +24,13 @@ namespace Engine {
 		case TextureFormat::RGB8:    return GL_RGB;
 		case TextureFormat::RGBA8:   return GL_RGBA;
 		case TextureFormat::R8UI:    return GL_RED_INTEGER;
+		case TextureFormat::RG32UI:  return GL_RG_INTEGER;
 		}
 	}
 	
 	static bool is_integer_format(TextureFormat format)
 	{
-		return format == TextureFormat::R8UI;
+		return format == TextureFormat::R8UI || format == TextureFormat::RG32UI;
 	}
 
 	Texture2D::Texture2D(uint32_t width, uint32_t height, TextureFormat format, uint32_t mips)
@@ -41,17 +44,18 @@ namespace Engine {
 
 	Texture2D::~Texture2D()
 	{
+		Graphics::forget_texture(m_ID);
 		glDeleteTextures(1, &m_ID);
 	}
 
 	void Texture2D::bind(uint32_t slot) const
 	{
-		glBindTextureUnit(slot, m_ID);
+		Graphics::bind_texture_unit(slot, m_ID);
 	}
 
 	void Texture2D::bind_as_image(uint32_t slot, TextureAccessMode mode) const
 	{
-		glBindImageTexture(slot, m_ID, 0, GL_FALSE, 0, (GLenum)mode, (uint32_t)m_InternalFormat);
+		Graphics::bind_image_texture(slot, m_ID, 0, (uint32_t)mode, (uint32_t)m_InternalFormat);
 	}	
 
 	void Texture2D::set_filter_mode(TextureFilterMode mode)
@@ -122,7 +126,7 @@ namespace Engine {
 	}
 
 	Texture3D::Texture3D(uint32_t width, uint32_t height, uint32_t depth, TextureFormat format, uint32_t mips, bool sparse)
-		: m_Width(width), m_Height(height), m_Depth(depth), m_InternalFormat((GLenum)format)
+		: m_Width(width), m_Height(height), m_Depth(depth), m_Mips(mips), m_InternalFormat((GLenum)format)
 	{
 		m_DataFormat = gl_data_format_from_internal_format(format);
 
@@ -134,6 +138,7 @@ namespace Engine {
 
 	Texture3D::~Texture3D()
 	{
+		Graphics::forget_texture(m_ID);
 		glDeleteTextures(1, &m_ID);
 	}
 
@@ -150,20 +155,77 @@ namespace Engine {
 		glTextureParameteri(m_ID, GL_TEXTURE_WRAP_R, (GLenum)mode);
 	}
 
-	void Texture3D::set_data(const void* data, uint32_t x, uint32_t y, uint32_t z, uint32_t mip)
+	static GLenum get_texture3d_data_type(uint32_t data_format)
 	{
-		GLenum dataType;
-		switch (m_DataFormat)
+		switch (data_format)
+		{
+		case GL_RED: return GL_UNSIGNED_BYTE;
+		case GL_RG: return GL_UNSIGNED_SHORT;
+		case GL_RGB: return GL_UNSIGNED_INT;
+		case GL_RGBA: return GL_UNSIGNED_INT_8_8_8_8;
+		case GL_RED_INTEGER: return GL_UNSIGNED_BYTE;
+		case GL_RG_INTEGER: return GL_UNSIGNED_INT;
+		}
+		return GL_UNSIGNED_BYTE;
+	}
+
+	// bytes per texel of client data, matches the types above
+	static size_t get_texture3d_pixel_size(uint32_t data_format)
+	{
+		switch (data_format)
 		{
-		case GL_RED: dataType = GL_UNSIGNED_BYTE; break;
-		case GL_RG: dataType = GL_UNSIGNED_SHORT; break;
-		case GL_RGB: dataType = GL_UNSIGNED_INT; break;
-		case GL_RGBA: dataType = GL_UNSIGNED_INT_8_8_8_8; break;
-		case GL_RED_INTEGER: dataType = GL_UNSIGNED_BYTE; break;
+		case GL_RED: return 1;
+		case GL_RG: return 2 * 2;
+		case GL_RGB: return 3 * 4;
+		case GL_RGBA: return 4;
+		case GL_RED_INTEGER: return 1;
+		case GL_RG_INTEGER: return 2 * 4;
 		}
+		return 1;
+	}
+
+	void Texture3D::set_data(const void* data, uint32_t x, uint32_t y, uint32_t z, uint32_t mip)
+	{
+		set_region(data, Int3(x, y, z), get_mip_dimensions(mip), mip);
+	}
+
+	void Texture3D::set_region(const void* data, Int3 offset, Int3 size, uint32_t mip)
+	{
+		size_t bytes = (size_t)size.x * size.y * size.z * get_texture3d_pixel_size(m_DataFormat);
 
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glTextureSubImage3D(m_ID, mip, x, y, z, m_Width, m_Height, m_Depth, m_DataFormat, dataType, data);
+		StagingRing::upload_pixels(data, bytes, [&](const void* pixels)
+		{
+			glTextureSubImage3D(m_ID, mip, offset.x, offset.y, offset.z, size.x, size.y, size.z, m_DataFormat, get_texture3d_data_type(m_DataFormat), pixels);
+		});
+	}
+
+	void Texture3D::get_region(void* data, size_t data_size, Int3 offset, Int3 size, uint32_t mip) const
+	{
+		ASSERT(m_DataFormat == GL_RED_INTEGER || m_DataFormat == GL_RG_INTEGER);
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTextureSubImage(m_ID, mip, offset.x, offset.y, offset.z, size.x, size.y, size.z, m_DataFormat, get_texture3d_data_type(m_DataFormat), data_size, data);
+	}
+
+	void Texture3D::get_data(void* data, size_t size, uint32_t mip) const
+	{
+		// only used for R8UI volumes & RG32UI occlusion bricks atm
+		ASSERT(m_DataFormat == GL_RED_INTEGER || m_DataFormat == GL_RG_INTEGER);
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTextureImage(m_ID, mip, m_DataFormat, m_DataFormat == GL_RG_INTEGER ? GL_UNSIGNED_INT : GL_UNSIGNED_BYTE, size, data);
+	}
+
+	void Texture3D::clear(uint32_t mip)
+	{
+		// null data clears to zero
+		glClearTexImage(m_ID, mip, m_DataFormat, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	Int3 Texture3D::get_mip_dimensions(uint32_t mip) const
+	{
+		return glm::max(Int3(m_Width >> mip, m_Height >> mip, m_Depth >> mip), Int3(1));
 	}
 
 	void Texture3D::generate_mips()
@@ -173,12 +235,12 @@ namespace Engine {
 
 	void Texture3D::bind(uint32_t slot) const
 	{
-		glBindTextureUnit(slot, m_ID);
+		Graphics::bind_texture_unit(slot, m_ID);
 	}
 	
 	void Texture3D::bind_as_image(uint32_t slot, TextureAccessMode mode, uint32_t mip) const
 	{
-		glBindImageTexture(slot, m_ID, mip, GL_FALSE, 0, (GLenum)mode, m_InternalFormat);
+		Graphics::bind_image_texture(slot, m_ID, mip, (uint32_t)mode, m_InternalFormat);
 	}
 
 	uint64_t Texture3D::get_bindless_image_handle(uint32_t mip) const
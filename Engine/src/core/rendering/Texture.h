@@ -5,6 +5,7 @@ namespace Engine {
 	enum class TextureFormat
 	{
 		R8UI   = 0x8232,
+		RG32UI = 0x823C,
 
 		R8     = 0x8229,
 		R16    = 0x822A,
@@ -90,11 +91,19 @@ namespace Engine {
 		void set_filter_mode(TextureFilterMode mode);
 		void set_wrap_mode(TextureWrapMode mode);
 		void set_data(const void* data, uint32_t x = 0, uint32_t y = 0, uint32_t z = 0, uint32_t mip = 0);
+		void get_data(void* data, size_t size, uint32_t mip = 0) const; // blocking readback, unless a pack buffer is bound (see ReadbackBuffer)
+		void clear(uint32_t mip = 0); // zeroes the mip
+
+		// tightly packed sub boxes of a mip
+		void set_region(const void* data, Int3 offset, Int3 size, uint32_t mip = 0);
+		void get_region(void* data, size_t data_size, Int3 offset, Int3 size, uint32_t mip = 0) const; // blocking readback
 
 		uint32_t get_width() const { return m_Width; }
 		uint32_t get_height() const { return m_Height; }
 		uint32_t get_depth() const { return m_Depth; }
 		Int3 get_dimensions() const { return Int3(m_Width, m_Height, m_Depth); }
+		Int3 get_mip_dimensions(uint32_t mip) const;
+		uint32_t get_mip_count() const { return m_Mips; }
 
 		void generate_mips();
 
@@ -114,6 +123,7 @@ namespace Engine {
 	private:
 		uint32_t m_ID = 0;
 		uint32_t m_Width = 0, m_Height = 0, m_Depth = 0;
+		uint32_t m_Mips = 1;
 		bool m_Sparse = false;
 
 		uint32_t m_InternalFormat, m_DataFormat;
@@ -0,0 +1,48 @@
+#include "pch.h"
+
+#include "TimerQuery.h"
+
+#include <glad/glad.h>
+
+namespace Engine {
+
+	TimerQuery::TimerQuery()
+	{
+		glCreateQueries(GL_TIME_ELAPSED, 1, &m_ID);
+	}
+
+	TimerQuery::~TimerQuery()
+	{
+		glDeleteQueries(1, &m_ID);
+	}
+
+	void TimerQuery::begin()
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_ID);
+	}
+
+	void TimerQuery::end()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+
+	bool TimerQuery::is_available() const
+	{
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(m_ID, GL_QUERY_RESULT_AVAILABLE, &available);
+		return available == GL_TRUE;
+	}
+
+	float TimerQuery::get_elapsed_ms() const
+	{
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(m_ID, GL_QUERY_RESULT, &nanoseconds);
+		return nanoseconds / 1e6f;
+	}
+
+	owning_ptr<TimerQuery> TimerQuery::create()
+	{
+		return owning_ptr<TimerQuery>(new TimerQuery());
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace Engine {
+
+	// GL_TIME_ELAPSED query, results show up a frame or two later
+	// begin/end pairs can't be nested (GL restriction)
+	class TimerQuery
+	{
+	private:
+		TimerQuery();
+	public:
+		~TimerQuery();
+
+		void begin();
+		void end();
+
+		// never stalls, false until the GPU has finished the timed commands
+		bool is_available() const;
+		float get_elapsed_ms() const; // stalls if not available
+
+		static owning_ptr<TimerQuery> create();
+	private:
+		uint32_t m_ID = 0;
+	};
+
+}
\ No newline at end of file
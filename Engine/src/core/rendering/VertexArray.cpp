@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "VertexArray.h"
+#include "Graphics.h"
 
 #include <glad/glad.h>
 
@@ -13,6 +14,7 @@ namespace Engine {
 
 	VertexArray::~VertexArray()
 	{
+		Graphics::forget_vertex_array(m_ID);
 		glDeleteVertexArrays(1, &m_ID);
 	}
 
@@ -58,7 +60,7 @@ namespace Engine {
 
 	void VertexArray::add_vertex_buffer(owning_ptr<VertexBuffer> vbo)
 	{
-		glBindVertexArray(m_ID);
+		Graphics::bind_vertex_array(m_ID);
 
 		auto& layout = vbo->get_layout();
 		for (BufferLayoutElement& element : layout.m_Elements)
@@ -80,7 +82,7 @@ namespace Engine {
 
 	void VertexArray::bind() const
 	{
-		glBindVertexArray(m_ID);
+		Graphics::bind_vertex_array(m_ID);
 	}
 
 	owning_ptr<VertexArray> VertexArray::create()
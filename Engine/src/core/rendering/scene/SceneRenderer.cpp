@@ -114,93 +114,4 @@ namespace Engine {
 	//	}
 	//}
 
-	TracedRay SceneRenderer::trace_ray_through_scene(Float3 origin, Float3 direction, float maxDistanceMeters)
-	{
-		//Int3 mapDimensions = s_ShadowMap->get_dimensions();
-		Int3 mapDimensions{};
-
-		Float3 worldspaceExtents = (Float3(mapDimensions) * VoxelScaleMeters) / 2.0f;
-		Float3 boundsMin = -worldspaceExtents;
-
-		Float3 voxelsPerUnit = Float3(1.0f / VoxelScaleMeters);
-
-		Float3 entry = (origin - boundsMin) * voxelsPerUnit;
-		Float3 step = glm::sign(direction);
-		Int3 iStep = Int3(step);
-
-		Float3 delta = glm::abs(1.0f / direction);
-		Int3 pos = Int3(glm::clamp(glm::floor(entry), Float3(0.0f), Float3(mapDimensions) - 1.0f));
-		Float3 tMax = (Float3(pos) - entry + glm::max(step, 0.0f)) / direction;
-
-		TracedRay result;
-		result.direction = direction;
-		 
-		// early exit
-		if (glm::any(glm::lessThan(pos, Int3(0))) || glm::any(glm::greaterThan(pos, mapDimensions))) {
-			result.t = maxDistanceMeters;
-			return result;
-		}
-
-		int maxSteps = (int)(maxDistanceMeters / VoxelScaleMeters);
-		for (int i = 0; i < maxSteps; i++) {
-			Int3 uv = 
-			{ 
-				pos.x,
-				pos.y,
-				pos.z,
-			};
-			uint8_t sample = sample_shadow_map(uv);
-			if (sample != 0) {
-				// Find which axis we just crossed
-				int axis = (tMax.x < tMax.y) ? ((tMax.x < tMax.z) ? 0 : 2) : ((tMax.y < tMax.z) ? 1 : 2);
-				result.t = (tMax[axis] - delta[axis]) * VoxelScaleMeters;
-				result.hitpoint = origin + direction * result.t;
-				result.sample = sample;
-				result.hit = true;
-				result.cell = pos - mapDimensions / 2;
-				return result;
-			}
-
-			if (tMax.x < tMax.y) {
-				if (tMax.x < tMax.z) {
-					// Step X
-					pos.x += iStep.x;
-					tMax.x += delta.x;
-				}
-				else {
-					// Step Z
-					pos.z += iStep.z;
-					tMax.z += delta.z;
-				}
-			}
-			else {
-				if (tMax.y < tMax.z) {
-					// Step Y
-					pos.y += iStep.y;
-					tMax.y += delta.y;
-				}
-				else {
-					// Step Z
-					pos.z += iStep.z;
-					tMax.z += delta.z;
-				}
-			}
-
-			// exit map?? :(
-			if (glm::any(glm::lessThan(pos, Int3(0))) || glm::any(glm::greaterThanEqual(pos, mapDimensions))) {
-				break;
-			}
-		}
-
-		result.t = float(maxDistanceMeters);
-		return result;
-	}
-
-	uint8_t SceneRenderer::sample_shadow_map(Int3 cell)
-	{
-		//size_t index = flatten_index_3d(cell, s_ShadowMap->get_dimensions());
-		//return s_ShadowMap->m_PixelData[index];
-		return 0;
-	}
-
 }
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "pch.h"
+
+#include "JobSystem.h"
+
+#include <thread>
+#include <deque>
+#include <condition_variable>
+
+namespace Engine {
+
+	struct Job;
+
+	struct JobCounter
+	{
+		std::atomic<uint32_t> pending = 0;
+
+		std::mutex mutex;
+		std::vector<Job*> continuations; // jobs waiting for this counter to hit zero
+	};
+
+	struct Job
+	{
+		JobSystem::JobFunction function;
+		std::shared_ptr<JobCounter> counter;
+		std::atomic<uint32_t> unmet_dependencies = 0;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Job*> jobs;
+	};
+
+	static std::vector<std::thread> s_Workers;
+	static std::vector<owning_ptr<WorkerQueue>> s_Queues;
+	static std::atomic<bool> s_Running = false;
+
+	static std::atomic<uint32_t> s_QueuedJobs = 0;
+	static std::atomic<uint32_t> s_NextQueue = 0;
+	static std::mutex s_SleepMutex;
+	static std::condition_variable s_WakeCondition;
+
+	static thread_local int32_t t_WorkerIndex = -1;
+
+	static void complete(Job* job);
+
+	static void enqueue(Job* job)
+	{
+		if (s_Queues.empty())
+		{
+			// no workers, just run it
+			job->function();
+			complete(job);
+			return;
+		}
+
+		// workers push onto their own deque, everyone else round-robins
+		uint32_t queueIndex = t_WorkerIndex >= 0 ? (uint32_t)t_WorkerIndex : s_NextQueue++ % (uint32_t)s_Queues.size();
+
+		s_QueuedJobs++;
+
+		WorkerQueue& queue = *s_Queues[queueIndex];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(job);
+		}
+
+		{ std::lock_guard<std::mutex> lock(s_SleepMutex); }
+		s_WakeCondition.notify_one();
+	}
+
+	static void complete(Job* job)
+	{
+		JobCounter& counter = *job->counter;
+		if (--counter.pending == 0)
+		{
+			std::vector<Job*> continuations;
+			{
+				std::lock_guard<std::mutex> lock(counter.mutex);
+				continuations.swap(counter.continuations);
+			}
+
+			for (Job* continuation : continuations)
+			{
+				if (--continuation->unmet_dependencies == 0)
+					enqueue(continuation);
+			}
+		}
+
+		delete job;
+	}
+
+	static Job* pop_job()
+	{
+		if (s_Queues.empty())
+			return nullptr;
+
+		// own queue first (LIFO, still hot in cache)
+		if (t_WorkerIndex >= 0)
+		{
+			WorkerQueue& own = *s_Queues[t_WorkerIndex];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.jobs.empty())
+			{
+				Job* job = own.jobs.back();
+				own.jobs.pop_back();
+				return job;
+			}
+		}
+
+		// steal the oldest job from someone else
+		uint32_t queueCount = (uint32_t)s_Queues.size();
+		uint32_t start = t_WorkerIndex >= 0 ? (uint32_t)t_WorkerIndex + 1 : 0;
+		for (uint32_t i = 0; i < queueCount; i++)
+		{
+			WorkerQueue& victim = *s_Queues[(start + i) % queueCount];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty())
+			{
+				Job* job = victim.jobs.front();
+				victim.jobs.pop_front();
+				return job;
+			}
+		}
+
+		return nullptr;
+	}
+
+	bool JobSystem::try_run_one()
+	{
+		Job* job = pop_job();
+		if (!job)
+			return false;
+
+		s_QueuedJobs--;
+		job->function();
+		complete(job);
+
+		return true;
+	}
+
+	static void worker_loop(uint32_t index)
+	{
+		t_WorkerIndex = (int32_t)index;
+		Profiler::set_thread_name(Profiler::intern(std::format("Worker {}", index)));
+
+		while (s_Running)
+		{
+			if (JobSystem::try_run_one())
+				continue;
+
+			std::unique_lock<std::mutex> lock(s_SleepMutex);
+			s_WakeCondition.wait(lock, []() { return s_QueuedJobs > 0 || !s_Running; });
+		}
+	}
+
+	void JobSystem::init(uint32_t worker_count)
+	{
+		ASSERT(!s_Running);
+
+		if (worker_count == 0)
+			worker_count = glm::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+		s_Running = true;
+		s_Queues.reserve(worker_count);
+		for (uint32_t i = 0; i < worker_count; i++)
+			s_Queues.push_back(make_owning<WorkerQueue>());
+
+		s_Workers.reserve(worker_count);
+		for (uint32_t i = 0; i < worker_count; i++)
+			s_Workers.emplace_back(worker_loop, i);
+
+		LOG("job system: {} workers", worker_count);
+	}
+
+	void JobSystem::shutdown()
+	{
+		if (!s_Running)
+			return;
+
+		// drain whatever is left so nobody waits forever
+		while (try_run_one());
+
+		s_Running = false;
+		{ std::lock_guard<std::mutex> lock(s_SleepMutex); }
+		s_WakeCondition.notify_all();
+
+		for (std::thread& worker : s_Workers)
+			worker.join();
+
+		s_Workers.clear();
+		s_Queues.clear();
+	}
+
+	JobHandle JobSystem::submit(JobFunction function)
+	{
+		return submit(std::move(function), {});
+	}
+
+	JobHandle JobSystem::submit(JobFunction function, std::initializer_list<JobHandle> dependencies)
+	{
+		auto counter = std::make_shared<JobCounter>();
+		counter->pending = 1;
+
+		Job* job = new Job();
+		job->function = std::move(function);
+		job->counter = counter;
+		job->unmet_dependencies = (uint32_t)dependencies.size() + 1; // +1 so it can't start while registering
+
+		for (const JobHandle& dependency : dependencies)
+		{
+			JobCounter* dependencyCounter = dependency.m_Counter.get();
+			if (dependencyCounter)
+			{
+				std::lock_guard<std::mutex> lock(dependencyCounter->mutex);
+				if (dependencyCounter->pending != 0)
+				{
+					dependencyCounter->continuations.push_back(job);
+					continue;
+				}
+			}
+
+			job->unmet_dependencies--; // already done
+		}
+
+		if (--job->unmet_dependencies == 0)
+			enqueue(job);
+
+		return JobHandle(counter);
+	}
+
+	JobHandle JobSystem::parallel_for(uint32_t count, uint32_t batch_size, const RangeFunction& fn)
+	{
+		if (count == 0)
+			return {};
+
+		batch_size = glm::max(batch_size, 1u);
+		uint32_t batchCount = (count + batch_size - 1) / batch_size;
+
+		auto counter = std::make_shared<JobCounter>();
+		counter->pending = batchCount;
+
+		for (uint32_t batch = 0; batch < batchCount; batch++)
+		{
+			uint32_t begin = batch * batch_size;
+			uint32_t end = glm::min(begin + batch_size, count);
+
+			Job* job = new Job();
+			job->function = [fn, begin, end]() { fn(begin, end); };
+			job->counter = counter;
+			enqueue(job);
+		}
+
+		return JobHandle(counter);
+	}
+
+	uint32_t JobSystem::get_worker_count()
+	{
+		return (uint32_t)s_Workers.size();
+	}
+
+	bool JobSystem::is_worker_thread()
+	{
+		return t_WorkerIndex >= 0;
+	}
+
+	bool JobHandle::is_done() const
+	{
+		return !m_Counter || m_Counter->pending == 0;
+	}
+
+	void JobHandle::wait() const
+	{
+		while (!is_done())
+		{
+			if (!JobSystem::try_run_one())
+				std::this_thread::yield();
+		}
+	}
+
+}
\ No newline at end of file
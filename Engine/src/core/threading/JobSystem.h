@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace Engine {
+
+	struct JobCounter;
+
+	// handle to a submitted job (or group of jobs), cheap to copy
+	// an empty handle counts as done
+	class JobHandle
+	{
+	public:
+		JobHandle() = default;
+
+		bool is_done() const;
+		void wait() const; // runs other jobs while waiting
+
+		bool empty() const { return !m_Counter; }
+	private:
+		JobHandle(std::shared_ptr<JobCounter> counter)
+			: m_Counter(std::move(counter))
+		{}
+	private:
+		std::shared_ptr<JobCounter> m_Counter;
+		friend class JobSystem;
+	};
+
+	// a JobHandle that also carries the job's return value
+	template<typename T>
+	class JobFuture
+	{
+	public:
+		JobFuture() = default;
+
+		bool is_ready() const { return m_Handle.is_done(); }
+		void wait() const { m_Handle.wait(); }
+
+		// void futures only wait
+		decltype(auto) get()
+		{
+			m_Handle.wait();
+			if constexpr (!std::is_void_v<T>)
+				return (*m_Value);
+		}
+
+		const JobHandle& get_handle() const { return m_Handle; }
+	private:
+		JobHandle m_Handle;
+		std::shared_ptr<std::conditional_t<std::is_void_v<T>, char, T>> m_Value; // unused for void
+		friend class JobSystem;
+	};
+
+	// work-stealing job system
+	// each worker owns a deque: it pushes/pops at the back, idle workers steal from the front of others
+	class JobSystem
+	{
+	public:
+		using JobFunction = std::function<void()>;
+		using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+		static void init(uint32_t worker_count = 0); // 0 = hardware threads - 1
+		static void shutdown();
+
+		static JobHandle submit(JobFunction job);
+		// job only starts once all dependencies are done
+		static JobHandle submit(JobFunction job, std::initializer_list<JobHandle> dependencies);
+
+		// splits [0, count) into batches of batch_size and runs them across the workers
+		static JobHandle parallel_for(uint32_t count, uint32_t batch_size, const RangeFunction& fn);
+
+		template<typename F>
+		static auto async(F&& fn) -> JobFuture<std::invoke_result_t<F>>
+		{
+			using T = std::invoke_result_t<F>;
+
+			JobFuture<T> future;
+			if constexpr (std::is_void_v<T>)
+			{
+				future.m_Handle = submit(std::forward<F>(fn));
+			}
+			else
+			{
+				future.m_Value = std::make_shared<T>();
+				future.m_Handle = submit([value = future.m_Value, fn = std::forward<F>(fn)]() mutable
+				{
+					*value = fn();
+				});
+			}
+			return future;
+		}
+
+		static void wait(const JobHandle& handle) { handle.wait(); }
+
+		// runs a single queued job on the calling thread if there is one
+		static bool try_run_one();
+
+		static uint32_t get_worker_count();
+		static bool is_worker_thread();
+	};
+
+}
\ No newline at end of file
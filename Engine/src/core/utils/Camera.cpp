@@ -54,6 +54,14 @@ namespace Engine {
 		recalculate_projection();
 	}
 
+	float Camera::get_pixels_per_meter(float distance, float viewport_height) const
+	{
+		if (m_Type == ProjectionType::Orthographic)
+			return viewport_height / m_OrthoSize;
+
+		return viewport_height / (2.0f * glm::max(distance, m_Near) * glm::tan(glm::radians(m_FOV) * 0.5f));
+	}
+
 	void Camera::recalculate_projection()
 	{
 		if (m_Type == ProjectionType::Orthographic)
@@ -30,6 +30,9 @@ namespace Engine {
 		float get_aspect_ratio() const { return m_AspectRatio; }
 
 		const Matrix4& get_projection() const { return m_Projection; }
+
+		// on-screen pixels covered by one meter at the given view distance
+		float get_pixels_per_meter(float distance, float viewport_height) const;
 	private:
 		void recalculate_projection();
 	private:
@@ -0,0 +1,175 @@
+#include "pch.h"
+
+#include "Compression.h"
+
+namespace Engine {
+
+	static constexpr size_t MinMatch = 4;
+	static constexpr size_t LastLiterals = 5; // sequences never end in a match
+	static constexpr size_t MatchSearchLimit = 12; // stop looking for matches this close to the end
+	static constexpr size_t MaxOffset = 0xFFFF;
+	static constexpr uint32_t HashBits = 16;
+
+	static inline uint32_t read32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint32_t hash_sequence(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	static inline uint8_t* write_length(uint8_t* op, size_t length)
+	{
+		while (length >= 255)
+		{
+			*op++ = 255;
+			length -= 255;
+		}
+		*op++ = (uint8_t)length;
+		return op;
+	}
+
+	static uint8_t* write_sequence(uint8_t* op, const uint8_t* literals, size_t literal_count, size_t offset, size_t match_length)
+	{
+		uint8_t* token = op++;
+		*token = (uint8_t)(glm::min(literal_count, (size_t)15) << 4);
+		if (literal_count >= 15)
+			op = write_length(op, literal_count - 15);
+
+		memcpy(op, literals, literal_count);
+		op += literal_count;
+
+		// last sequence is literals only
+		if (match_length == 0)
+			return op;
+
+		*op++ = (uint8_t)(offset & 0xFF);
+		*op++ = (uint8_t)(offset >> 8);
+
+		size_t matchCode = match_length - MinMatch;
+		*token |= (uint8_t)glm::min(matchCode, (size_t)15);
+		if (matchCode >= 15)
+			op = write_length(op, matchCode - 15);
+
+		return op;
+	}
+
+	size_t lz_compress_bound(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	size_t lz_compress(const uint8_t* source, size_t size, uint8_t* dest, size_t dest_capacity)
+	{
+		ASSERT(dest_capacity >= lz_compress_bound(size));
+
+		std::vector<uint32_t> table(1 << HashBits, 0);
+
+		uint8_t* op = dest;
+		size_t anchor = 0;
+		size_t ip = 0;
+		uint32_t misses = 0;
+
+		while (size >= MatchSearchLimit && ip <= size - MatchSearchLimit)
+		{
+			uint32_t sequence = read32(source + ip);
+			uint32_t& slot = table[hash_sequence(sequence)];
+			size_t candidate = slot;
+			slot = (uint32_t)ip;
+
+			if (candidate >= ip || ip - candidate > MaxOffset || read32(source + candidate) != sequence)
+			{
+				// skip faster through data that doesn't compress
+				ip += 1 + (misses++ >> 6);
+				continue;
+			}
+			misses = 0;
+
+			size_t matchLength = MinMatch;
+			size_t matchLimit = size - LastLiterals;
+			while (ip + matchLength < matchLimit && source[candidate + matchLength] == source[ip + matchLength])
+				matchLength++;
+
+			op = write_sequence(op, source + anchor, ip - anchor, ip - candidate, matchLength);
+
+			ip += matchLength;
+			anchor = ip;
+		}
+
+		op = write_sequence(op, source + anchor, size - anchor, 0, 0);
+		return (size_t)(op - dest);
+	}
+
+	bool lz_decompress(const uint8_t* source, size_t size, uint8_t* dest, size_t dest_size)
+	{
+		const uint8_t* ip = source;
+		const uint8_t* ipEnd = source + size;
+		uint8_t* op = dest;
+		uint8_t* opEnd = dest + dest_size;
+
+		auto read_length = [&](size_t& length) -> bool
+		{
+			uint8_t b;
+			do
+			{
+				if (ip >= ipEnd)
+					return false;
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+			return true;
+		};
+
+		while (ip < ipEnd)
+		{
+			uint8_t token = *ip++;
+
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !read_length(literalCount))
+				return false;
+
+			if (literalCount > (size_t)(ipEnd - ip) || literalCount > (size_t)(opEnd - op))
+				return false;
+
+			memcpy(op, ip, literalCount);
+			ip += literalCount;
+			op += literalCount;
+
+			if (ip == ipEnd)
+				break;
+
+			if (ipEnd - ip < 2)
+				return false;
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+
+			size_t matchLength = token & 0xF;
+			if (matchLength == 15 && !read_length(matchLength))
+				return false;
+			matchLength += MinMatch;
+
+			if (offset == 0 || offset > (size_t)(op - dest) || matchLength > (size_t)(opEnd - op))
+				return false;
+
+			const uint8_t* match = op - offset;
+			if (offset >= matchLength)
+			{
+				memcpy(op, match, matchLength);
+				op += matchLength;
+			}
+			else
+			{
+				// overlapping, repeats the last offset bytes
+				for (size_t i = 0; i < matchLength; i++)
+					*op++ = match[i];
+			}
+		}
+
+		return op == opEnd;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+namespace Engine {
+
+	// small LZ77 byte codec (LZ4-style block format: token, literals, 16 bit offset, match length)
+	// built for speed over ratio, works best on already run-length encoded data
+
+	// worst case compressed size for size bytes of input
+	size_t lz_compress_bound(size_t size);
+
+	// returns the compressed size, dest must hold at least lz_compress_bound(size) bytes
+	size_t lz_compress(const uint8_t* source, size_t size, uint8_t* dest, size_t dest_capacity);
+
+	// dest_size has to be the exact decompressed size, returns false on malformed input
+	bool lz_decompress(const uint8_t* source, size_t size, uint8_t* dest, size_t dest_size);
+
+}
\ No newline at end of file
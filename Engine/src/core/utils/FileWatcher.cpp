@@ -0,0 +1,172 @@
+#include "pch.h"
+
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+namespace Engine {
+
+#ifdef _WIN32
+	static constexpr DWORD NotifyFilter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+	static constexpr size_t NotifyBufferSize = 64 * 1024;
+
+	static bool queue_directory_changes(HANDLE directory, OVERLAPPED* overlapped, std::vector<uint8_t>& buffer)
+	{
+		return ReadDirectoryChangesW(directory, buffer.data(), (DWORD)buffer.size(), TRUE, NotifyFilter, nullptr, overlapped, nullptr);
+	}
+#else
+	// editors either rewrite in place (close_write) or write a temp file and rename it over (moved_to)
+	static constexpr uint32_t WatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+	static void add_watch(int descriptor, const std::filesystem::path& directory, std::unordered_map<int, std::filesystem::path>& watches)
+	{
+		int watch = inotify_add_watch(descriptor, directory.c_str(), WatchMask);
+		if (watch < 0)
+		{
+			LOG("file watcher: couldn't watch '{}'", directory.string());
+			return;
+		}
+
+		watches[watch] = directory;
+	}
+#endif
+
+	FileWatcher::~FileWatcher()
+	{
+#ifdef _WIN32
+		if (m_DirectoryHandle)
+		{
+			// the pending read writes into m_NotifyBuffer, it has to be gone before that's freed
+			CancelIo(m_DirectoryHandle);
+			if (m_Overlapped && !HasOverlappedIoCompleted((OVERLAPPED*)m_Overlapped))
+			{
+				DWORD bytes = 0;
+				GetOverlappedResult(m_DirectoryHandle, (OVERLAPPED*)m_Overlapped, &bytes, TRUE);
+			}
+			CloseHandle(m_DirectoryHandle);
+		}
+		if (m_Overlapped)
+		{
+			CloseHandle(((OVERLAPPED*)m_Overlapped)->hEvent);
+			delete (OVERLAPPED*)m_Overlapped;
+		}
+#else
+		if (m_Descriptor >= 0)
+			::close(m_Descriptor);
+#endif
+	}
+
+	owning_ptr<FileWatcher> FileWatcher::create(const std::filesystem::path& directory)
+	{
+		std::error_code error;
+		std::filesystem::path canonical = std::filesystem::canonical(directory, error);
+		if (error || !std::filesystem::is_directory(canonical))
+		{
+			LOG("file watcher: '{}' isn't a directory", directory.string());
+			return nullptr;
+		}
+
+		auto watcher = owning_ptr<FileWatcher>(new FileWatcher());
+		watcher->m_Directory = canonical;
+
+#ifdef _WIN32
+		HANDLE handle = CreateFileW(canonical.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+		if (handle == INVALID_HANDLE_VALUE)
+			return nullptr;
+		watcher->m_DirectoryHandle = handle;
+
+		OVERLAPPED* overlapped = new OVERLAPPED{};
+		overlapped->hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+		watcher->m_Overlapped = overlapped;
+
+		watcher->m_NotifyBuffer.resize(NotifyBufferSize);
+		if (!queue_directory_changes(handle, overlapped, watcher->m_NotifyBuffer))
+			return nullptr;
+#else
+		watcher->m_Descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (watcher->m_Descriptor < 0)
+			return nullptr;
+
+		// inotify isn't recursive, every directory gets its own watch
+		add_watch(watcher->m_Descriptor, canonical, watcher->m_Watches);
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(canonical, error))
+		{
+			if (entry.is_directory())
+				add_watch(watcher->m_Descriptor, entry.path(), watcher->m_Watches);
+		}
+#endif
+
+		return watcher;
+	}
+
+	std::vector<std::filesystem::path> FileWatcher::poll()
+	{
+		std::vector<std::filesystem::path> changed;
+
+#ifdef _WIN32
+		OVERLAPPED* overlapped = (OVERLAPPED*)m_Overlapped;
+		DWORD bytes = 0;
+		if (!GetOverlappedResult(m_DirectoryHandle, overlapped, &bytes, FALSE))
+			return changed; // ERROR_IO_INCOMPLETE, nothing yet
+
+		// 0 bytes means the buffer overflowed and the changes are lost, nothing to do about it
+		const uint8_t* cursor = m_NotifyBuffer.data();
+		while (bytes > 0)
+		{
+			const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)cursor;
+			if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+				changed.push_back(m_Directory / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+
+			if (info->NextEntryOffset == 0)
+				break;
+			cursor += info->NextEntryOffset;
+		}
+
+		ResetEvent(overlapped->hEvent);
+		queue_directory_changes(m_DirectoryHandle, overlapped, m_NotifyBuffer);
+#else
+		alignas(inotify_event) char buffer[4096];
+		while (true)
+		{
+			ssize_t length = ::read(m_Descriptor, buffer, sizeof(buffer));
+			if (length <= 0)
+				break; // EAGAIN, drained
+
+			for (char* cursor = buffer; cursor < buffer + length; cursor += sizeof(inotify_event) + ((inotify_event*)cursor)->len)
+			{
+				const inotify_event* event = (const inotify_event*)cursor;
+				auto it = m_Watches.find(event->wd);
+				if (it == m_Watches.end() || event->len == 0)
+					continue;
+
+				std::filesystem::path path = it->second / event->name;
+				if (event->mask & IN_ISDIR)
+				{
+					if (event->mask & (IN_CREATE | IN_MOVED_TO))
+						add_watch(m_Descriptor, path, m_Watches);
+				}
+				else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+				{
+					changed.push_back(path);
+				}
+			}
+		}
+#endif
+
+		// a single save tends to show up more than once
+		std::sort(changed.begin(), changed.end());
+		changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+		return changed;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace Engine {
+
+	// reports files written under a directory tree without ever blocking,
+	// inotify on linux, ReadDirectoryChangesW on windows
+	class FileWatcher
+	{
+	private:
+		FileWatcher() = default;
+	public:
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		// canonical paths of the files changed since the last call, each once
+		std::vector<std::filesystem::path> poll();
+
+		// nullptr if the directory can't be watched
+		static owning_ptr<FileWatcher> create(const std::filesystem::path& directory);
+	private:
+		std::filesystem::path m_Directory;
+
+		int m_Descriptor = -1;                                     // linux only
+		std::unordered_map<int, std::filesystem::path> m_Watches; // linux only, watch descriptor -> directory
+
+		void* m_DirectoryHandle = nullptr;   // windows only
+		void* m_Overlapped = nullptr;        // windows only, OVERLAPPED of the pending ReadDirectoryChangesW
+		std::vector<uint8_t> m_NotifyBuffer; // windows only, filled by the pending ReadDirectoryChangesW
+	};
+
+}
\ No newline at end of file
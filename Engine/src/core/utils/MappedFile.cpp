@@ -0,0 +1,81 @@
+#include "pch.h"
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace Engine {
+
+	MappedFile::~MappedFile()
+	{
+#ifdef _WIN32
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_MappingHandle)
+			CloseHandle(m_MappingHandle);
+		if (m_FileHandle)
+			CloseHandle(m_FileHandle);
+#else
+		if (m_Data)
+			munmap((void*)m_Data, m_Size);
+#endif
+	}
+
+	owning_ptr<MappedFile> MappedFile::open(const std::filesystem::path& filepath)
+	{
+		auto file = owning_ptr<MappedFile>(new MappedFile());
+
+#ifdef _WIN32
+		HANDLE handle = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (handle == INVALID_HANDLE_VALUE)
+			return nullptr;
+		file->m_FileHandle = handle;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+			return nullptr;
+		file->m_Size = (size_t)size.QuadPart;
+
+		file->m_MappingHandle = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!file->m_MappingHandle)
+			return nullptr;
+
+		file->m_Data = (const uint8_t*)MapViewOfFile(file->m_MappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (!file->m_Data)
+			return nullptr;
+#else
+		int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return nullptr;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			::close(fd);
+			return nullptr;
+		}
+		file->m_Size = (size_t)info.st_size;
+
+		// the mapping keeps the file alive, fd isn't needed anymore
+		void* data = mmap(nullptr, file->m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED)
+			return nullptr;
+
+		madvise(data, file->m_Size, MADV_SEQUENTIAL);
+		file->m_Data = (const uint8_t*)data;
+#endif
+
+		return file;
+	}
+
+}
\ No newline at end of file
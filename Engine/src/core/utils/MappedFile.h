@@ -0,0 +1,29 @@
+#pragma once
+
+namespace Engine {
+
+	// read-only memory mapped file, unmapped on destruction
+	class MappedFile
+	{
+	private:
+		MappedFile() = default;
+	public:
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8_t* get_data() const { return m_Data; }
+		size_t get_size() const { return m_Size; }
+
+		// nullptr if the file doesn't exist or can't be mapped
+		static owning_ptr<MappedFile> open(const std::filesystem::path& filepath);
+	private:
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+
+		void* m_FileHandle = nullptr;    // windows only
+		void* m_MappingHandle = nullptr; // windows only
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "pch.h"
+
+#include "Profiler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+namespace Engine {
+
+	void Profiler::ThreadBuffer::push(const ProfileEvent& event)
+	{
+		uint64_t index = written.load(std::memory_order_relaxed);
+		events[index % ThreadEventCapacity] = event;
+		written.store(index + 1, std::memory_order_release);
+	}
+
+	void Profiler::ThreadBuffer::snapshot(std::vector<ProfileEvent>& out) const
+	{
+		uint64_t end = written.load(std::memory_order_acquire);
+		uint64_t begin = end > ThreadEventCapacity ? end - ThreadEventCapacity : 0;
+
+		size_t first = out.size();
+		for (uint64_t i = begin; i < end; i++)
+			out.push_back(events[i % ThreadEventCapacity]);
+
+		// the writer may have lapped us while copying (+1 for the slot it's writing right now), drop those
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = written.load(std::memory_order_relaxed) + 1;
+		uint64_t validBegin = after > ThreadEventCapacity ? after - ThreadEventCapacity : 0;
+		if (validBegin > begin)
+			out.erase(out.begin() + first, out.begin() + first + (size_t)glm::min(validBegin - begin, end - begin));
+	}
+
+	Profiler::ThreadBuffer& Profiler::get_thread_buffer()
+	{
+		static thread_local ThreadBuffer* t_ThreadBuffer = nullptr;
+		if (!t_ThreadBuffer)
+		{
+			std::lock_guard<std::mutex> lock(s_ThreadsMutex);
+			ThreadBuffer& buffer = s_Threads.emplace_back();
+			buffer.id = (uint32_t)s_Threads.size();
+			t_ThreadBuffer = &buffer;
+		}
+
+		return *t_ThreadBuffer;
+	}
+
+	void Profiler::init()
+	{
+		set_thread_name("Main");
+
+		{
+			std::lock_guard<std::mutex> lock(s_ThreadsMutex);
+			s_GpuTimeline = &s_Threads.emplace_back();
+			s_GpuTimeline->id = (uint32_t)s_Threads.size();
+			s_GpuTimeline->name = "GPU";
+		}
+
+		s_GpuEnabled = true;
+		s_FrameStartNs = now_ns();
+	}
+
+	void Profiler::shutdown()
+	{
+		for (GpuFrame& frame : s_GpuFrames)
+		{
+			if (!frame.queries.empty())
+				glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+			frame.queries.clear();
+			frame.zones.clear();
+			frame.pending = false;
+		}
+
+		s_GpuEnabled = false;
+	}
+
+	void Profiler::begin_frame()
+	{
+		s_FrameStartNs = now_ns();
+		if (!s_GpuEnabled)
+			return;
+
+		// the slot about to be reused was filled GpuLatencyFrames ago
+		s_GpuFrameIndex = (s_GpuFrameIndex + 1) % GpuLatencyFrames;
+		GpuFrame& frame = s_GpuFrames[s_GpuFrameIndex];
+		if (frame.pending)
+			resolve_gpu_frame(frame);
+
+		frame.zones.clear();
+		frame.pending = false;
+
+		// GL_TIMESTAMP doesn't wait for the GPU, it's the time commands issued now reach it
+		GLint64 gpuTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		frame.clock_offset_ns = (int64_t)now_ns() - gpuTime;
+
+		s_GpuDepth = 0;
+	}
+
+	void Profiler::end_frame()
+	{
+		uint64_t end = now_ns();
+		record("Frame", s_FrameStartNs, end);
+		s_FrameCpuMs = (end - s_FrameStartNs) / 1e6f;
+
+		if (s_GpuEnabled)
+		{
+			GpuFrame& frame = s_GpuFrames[s_GpuFrameIndex];
+			frame.pending = !frame.zones.empty();
+		}
+	}
+
+	uint64_t Profiler::now_ns()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Profiler::set_thread_name(const char* name)
+	{
+		get_thread_buffer().name = name;
+	}
+
+	void Profiler::record(const char* name, uint64_t start_ns, uint64_t end_ns)
+	{
+		get_thread_buffer().push({ name, start_ns, end_ns });
+	}
+
+	uint32_t Profiler::begin_gpu_zone(const char* name)
+	{
+		if (!s_GpuEnabled)
+			return NoGpuZone;
+
+		GpuFrame& frame = s_GpuFrames[s_GpuFrameIndex];
+		if (frame.zones.size() >= MaxGpuZonesPerFrame)
+			return NoGpuZone;
+
+		uint32_t zone = (uint32_t)frame.zones.size();
+		if (frame.queries.size() < (zone + 1) * 2)
+		{
+			uint32_t queries[2];
+			glCreateQueries(GL_TIMESTAMP, 2, queries);
+			frame.queries.push_back(queries[0]);
+			frame.queries.push_back(queries[1]);
+		}
+
+		frame.zones.push_back({ name, s_GpuDepth++, 0, 0 });
+		glQueryCounter(frame.queries[zone * 2], GL_TIMESTAMP);
+
+		return zone;
+	}
+
+	void Profiler::end_gpu_zone(uint32_t zone, uint64_t cpu_start_ns, uint64_t cpu_end_ns)
+	{
+		if (zone == NoGpuZone)
+			return;
+
+		GpuFrame& frame = s_GpuFrames[s_GpuFrameIndex];
+		ASSERT(zone < frame.zones.size());
+
+		glQueryCounter(frame.queries[zone * 2 + 1], GL_TIMESTAMP);
+		frame.zones[zone].cpu_start_ns = cpu_start_ns;
+		frame.zones[zone].cpu_end_ns = cpu_end_ns;
+		s_GpuDepth--;
+	}
+
+	void Profiler::resolve_gpu_frame(GpuFrame& frame)
+	{
+		// NO_WAIT leaves the value alone if the GPU is still behind, never stalls
+		std::vector<GLuint64> timestamps(frame.zones.size() * 2, 0);
+		for (size_t i = 0; i < timestamps.size(); i++)
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT_NO_WAIT, &timestamps[i]);
+
+		if (timestamps.back() == 0)
+		{
+			s_DroppedGpuFrames++;
+			return;
+		}
+
+		s_FrameZones.clear();
+		s_FrameGpuMs = 0.0f;
+
+		for (size_t i = 0; i < frame.zones.size(); i++)
+		{
+			const GpuZone& zone = frame.zones[i];
+			uint64_t gpuBegin = timestamps[i * 2], gpuEnd = timestamps[i * 2 + 1];
+			if (gpuBegin == 0 || gpuEnd < gpuBegin)
+				continue;
+
+			s_GpuTimeline->push({ zone.name, gpuBegin + frame.clock_offset_ns, gpuEnd + frame.clock_offset_ns });
+
+			float gpuMs = (gpuEnd - gpuBegin) / 1e6f;
+			float cpuMs = (zone.cpu_end_ns - zone.cpu_start_ns) / 1e6f;
+			if (zone.depth == 0)
+				s_FrameGpuMs += gpuMs;
+
+			auto it = std::find_if(s_FrameZones.begin(), s_FrameZones.end(), [&](const ProfileZoneStats& stats)
+				{ return strcmp(stats.name, zone.name) == 0; });
+			if (it == s_FrameZones.end())
+				it = s_FrameZones.insert(s_FrameZones.end(), { zone.name, zone.depth });
+
+			it->count++;
+			it->cpu_ms += cpuMs;
+			it->gpu_ms += gpuMs;
+		}
+	}
+
+	const char* Profiler::intern(const std::string& name)
+	{
+		static std::mutex s_Mutex;
+		static std::unordered_set<std::string> s_Names;
+
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		return s_Names.insert(name).first->c_str();
+	}
+
+	static void write_json_string(std::ofstream& out, const char* string)
+	{
+		out << '"';
+		for (const char* c = string ? string : "?"; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				out << '\\';
+			out << *c;
+		}
+		out << '"';
+	}
+
+	bool Profiler::write_chrome_trace(const std::filesystem::path& filepath)
+	{
+		std::vector<ThreadBuffer*> threads;
+		{
+			std::lock_guard<std::mutex> lock(s_ThreadsMutex);
+			for (ThreadBuffer& buffer : s_Threads)
+				threads.push_back(&buffer);
+		}
+
+		std::vector<std::vector<ProfileEvent>> events(threads.size());
+		uint64_t origin = ~0ull;
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i]->snapshot(events[i]);
+			for (const ProfileEvent& event : events[i])
+				origin = glm::min(origin, event.start_ns);
+		}
+
+		std::ofstream out(filepath, std::ios::out | std::ios::trunc);
+		if (!out)
+		{
+			LOG("profiler: couldn't write '{}'", filepath.string());
+			return false;
+		}
+
+		// complete ("X") events in microseconds, one tid per thread plus one for the GPU
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		size_t count = 0;
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			uint32_t tid = threads[i]->id;
+			std::string fallbackName = std::format("Thread {}", tid);
+
+			out << (first ? "\n" : ",\n") << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+			write_json_string(out, threads[i]->name ? threads[i]->name : fallbackName.c_str());
+			out << "}}";
+			first = false;
+
+			for (const ProfileEvent& event : events[i])
+			{
+				out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"name\":";
+				write_json_string(out, event.name);
+				out << std::format(",\"ts\":{:.3f},\"dur\":{:.3f}}}", (event.start_ns - origin) / 1e3, (event.end_ns - event.start_ns) / 1e3);
+			}
+			count += events[i].size();
+		}
+		out << "\n]}\n";
+
+		LOG("profiler: wrote {} events from {} threads to '{}'", count, threads.size(), filepath.string());
+		return true;
+	}
+
+}
\ No newline at end of file
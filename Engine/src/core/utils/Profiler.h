@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace Engine {
+
+	// names are never copied, pass literals or Profiler::intern() strings
+	struct ProfileEvent
+	{
+		const char* name = nullptr;
+		uint64_t start_ns = 0, end_ns = 0; // Profiler::now_ns() timeline
+	};
+
+	// one line of the per-pass breakdown, zones with the same name are merged
+	struct ProfileZoneStats
+	{
+		const char* name = nullptr;
+		uint32_t depth = 0;
+		uint32_t count = 0;
+		float cpu_ms = 0.0f; // time spent recording the commands
+		float gpu_ms = 0.0f; // time between the GL_TIMESTAMP pair
+	};
+
+	// scoped CPU zones go into a fixed size ring per thread: the owning thread is the only writer
+	// and publishes with a release store, readers take snapshots without ever blocking it
+	// GPU zones are GL_TIMESTAMP query pairs, resolved GpuLatencyFrames later so reading them never stalls
+	class Profiler
+	{
+	public:
+		static constexpr uint32_t ThreadEventCapacity = 1 << 14;
+		static constexpr uint32_t GpuLatencyFrames = 4;
+		static constexpr uint32_t MaxGpuZonesPerFrame = 1024;
+		static constexpr uint32_t NoGpuZone = ~0u;
+
+		// GL thread, enables GPU zones. CPU zones work without it (headless)
+		static void init();
+		static void shutdown();
+
+		// resolves the GPU zones of GpuLatencyFrames ago, once per frame before rendering
+		static void begin_frame();
+		static void end_frame();
+
+		static uint64_t now_ns();
+
+		static void set_thread_name(const char* name);
+		static void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+		static uint32_t begin_gpu_zone(const char* name);
+		static void end_gpu_zone(uint32_t zone, uint64_t cpu_start_ns, uint64_t cpu_end_ns);
+
+		// stable pointer for names that don't outlive their owner (shader file names)
+		static const char* intern(const std::string& name);
+
+		// breakdown of the newest frame whose GPU timings have arrived
+		static const std::vector<ProfileZoneStats>& get_frame_zones() { return s_FrameZones; }
+		static float get_frame_gpu_ms() { return s_FrameGpuMs; }
+		static float get_frame_cpu_ms() { return s_FrameCpuMs; } // previous frame, begin_frame to end_frame
+		static uint64_t get_dropped_gpu_frames() { return s_DroppedGpuFrames; }
+
+		// everything still in the rings, as chrome://tracing / Perfetto JSON
+		static bool write_chrome_trace(const std::filesystem::path& filepath);
+	private:
+		struct ThreadBuffer
+		{
+			ProfileEvent events[ThreadEventCapacity];
+			std::atomic<uint64_t> written = 0;
+			uint32_t id = 0;
+			const char* name = nullptr;
+
+			void push(const ProfileEvent& event);
+			void snapshot(std::vector<ProfileEvent>& out) const;
+		};
+
+		struct GpuZone
+		{
+			const char* name;
+			uint32_t depth;
+			uint64_t cpu_start_ns, cpu_end_ns;
+		};
+
+		struct GpuFrame
+		{
+			std::vector<GpuZone> zones;
+			std::vector<uint32_t> queries; // two per zone, only ever grows
+			int64_t clock_offset_ns;       // cpu - gpu time when the frame began
+			bool pending;
+		};
+
+		static ThreadBuffer& get_thread_buffer();
+		static void resolve_gpu_frame(GpuFrame& frame);
+	private:
+		static inline std::mutex s_ThreadsMutex;
+		static inline std::deque<ThreadBuffer> s_Threads; // never relocates, buffers outlive their threads
+		static inline ThreadBuffer* s_GpuTimeline = nullptr;
+
+		static inline bool s_GpuEnabled = false;
+		static inline GpuFrame s_GpuFrames[GpuLatencyFrames];
+		static inline uint32_t s_GpuFrameIndex = 0;
+		static inline uint32_t s_GpuDepth = 0;
+		static inline uint64_t s_FrameStartNs = 0;
+
+		static inline std::vector<ProfileZoneStats> s_FrameZones;
+		static inline float s_FrameGpuMs = 0.0f, s_FrameCpuMs = 0.0f;
+		static inline uint64_t s_DroppedGpuFrames = 0;
+	};
+
+	class ProfileScope
+	{
+	public:
+		ProfileScope(const char* name)
+			: m_Name(name), m_Start(Profiler::now_ns())
+		{
+		}
+		~ProfileScope()
+		{
+			Profiler::record(m_Name, m_Start, Profiler::now_ns());
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+	private:
+		const char* m_Name;
+		uint64_t m_Start;
+	};
+
+	// CPU zone plus a GL_TIMESTAMP pair around it, GL thread only
+	class GpuProfileScope
+	{
+	public:
+		GpuProfileScope(const char* name)
+			: m_Name(name), m_Start(Profiler::now_ns()), m_Zone(Profiler::begin_gpu_zone(name))
+		{
+		}
+		~GpuProfileScope()
+		{
+			uint64_t end = Profiler::now_ns();
+			Profiler::end_gpu_zone(m_Zone, m_Start, end);
+			Profiler::record(m_Name, m_Start, end);
+		}
+
+		GpuProfileScope(const GpuProfileScope&) = delete;
+		GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+	private:
+		const char* m_Name;
+		uint64_t m_Start;
+		uint32_t m_Zone;
+	};
+
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ::Engine::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ::Engine::GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "pch.h"
+
+#include "ChunkCache.h"
+
+#include "utils/Compression.h"
+#include "utils/MappedFile.h"
+
+#include <chrono>
+#include <fstream>
+
+namespace Engine {
+
+	static constexpr uint32_t ChunkFileMagic = 0x48435856; // 'VXCH'
+	static constexpr uint32_t ChunkFileVersion = 3;
+
+	struct ChunkFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t seed;
+		int32_t index_x, index_y;
+		uint32_t lod;
+		uint32_t generator;
+		uint32_t reduction;
+		int32_t width, height, depth;
+		uint32_t rle_size;        // size of the column RLE stream
+		uint32_t compressed_size; // size of the payload following the header
+		uint32_t checksum;        // FNV-1a of the payload
+	};
+
+	static uint32_t fnv1a(const uint8_t* data, size_t size)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ data[i]) * 16777619u;
+		return hash;
+	}
+
+	// every (x, z) column becomes (value, length) byte pairs running up y
+	// terrain columns are mostly a single solid run and a single air run
+	static void rle_encode_columns(const uint8_t* voxels, Int3 dimensions, std::vector<uint8_t>& out)
+	{
+		size_t strideY = dimensions.x;
+		size_t strideZ = (size_t)dimensions.x * dimensions.y;
+
+		out.clear();
+		out.reserve((size_t)dimensions.x * dimensions.z * 4);
+
+		for (int32_t z = 0; z < dimensions.z; z++)
+		for (int32_t x = 0; x < dimensions.x; x++)
+		{
+			const uint8_t* column = voxels + x + z * strideZ;
+
+			uint8_t value = column[0];
+			uint32_t length = 0;
+			for (int32_t y = 0; y < dimensions.y; y++)
+			{
+				uint8_t voxel = column[y * strideY];
+				if (voxel != value || length == 255)
+				{
+					out.push_back(value);
+					out.push_back((uint8_t)length);
+					value = voxel;
+					length = 0;
+				}
+				length++;
+			}
+
+			out.push_back(value);
+			out.push_back((uint8_t)length);
+		}
+	}
+
+	// the checksum only covers the payload, a corrupt header mustn't size the decode buffer
+	static size_t get_max_rle_size(Int3 dimensions)
+	{
+		return (size_t)dimensions.x * dimensions.y * dimensions.z * 2; // a run per voxel
+	}
+
+	static bool rle_decode_columns(const uint8_t* rle, size_t size, uint8_t* voxels, Int3 dimensions)
+	{
+		size_t strideY = dimensions.x;
+		size_t strideZ = (size_t)dimensions.x * dimensions.y;
+
+		const uint8_t* ip = rle;
+		const uint8_t* ipEnd = rle + size;
+
+		for (int32_t z = 0; z < dimensions.z; z++)
+		for (int32_t x = 0; x < dimensions.x; x++)
+		{
+			uint8_t* column = voxels + x + z * strideZ;
+
+			int32_t y = 0;
+			while (y < dimensions.y)
+			{
+				if (ipEnd - ip < 2)
+					return false;
+
+				uint8_t value = ip[0];
+				int32_t length = ip[1];
+				ip += 2;
+
+				if (length == 0 || y + length > dimensions.y)
+					return false;
+
+				for (int32_t end = y + length; y < end; y++)
+					column[y * strideY] = value;
+			}
+		}
+
+		return ip == ipEnd;
+	}
+
+	ChunkCache::ChunkCache(const std::filesystem::path& directory)
+		: m_Directory(directory)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(m_Directory, error);
+		if (error)
+			LOG("chunk cache: couldn't create '{}' ({})", m_Directory.string(), error.message());
+	}
+
+	std::filesystem::path ChunkCache::get_chunk_path(const ChunkCacheKey& key) const
+	{
+		return m_Directory / std::format("{:08x}_{}", key.seed, key.generator) / std::format("{}_{}_lod{}_r{}.chunk", key.index.x, key.index.y, key.lod, key.reduction);
+	}
+
+	bool ChunkCache::contains(const ChunkCacheKey& key) const
+	{
+		std::error_code error;
+		return std::filesystem::exists(get_chunk_path(key), error);
+	}
+
+	bool ChunkCache::load(const ChunkCacheKey& key, uint8_t* voxels, Int3 dimensions)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		auto file = MappedFile::open(get_chunk_path(key));
+		if (!file || file->get_size() < sizeof(ChunkFileHeader))
+		{
+			m_Misses++;
+			return false;
+		}
+
+		ChunkFileHeader header;
+		memcpy(&header, file->get_data(), sizeof(header));
+		const uint8_t* payload = file->get_data() + sizeof(header);
+
+		bool valid = header.magic == ChunkFileMagic && header.version == ChunkFileVersion
+			&& header.seed == key.seed && header.index_x == key.index.x && header.index_y == key.index.y && header.lod == key.lod && header.generator == key.generator && header.reduction == key.reduction
+			&& header.width == dimensions.x && header.height == dimensions.y && header.depth == dimensions.z
+			&& header.compressed_size == file->get_size() - sizeof(header)
+			&& header.rle_size <= get_max_rle_size(dimensions)
+			&& header.checksum == fnv1a(payload, header.compressed_size);
+
+		if (valid)
+		{
+			std::vector<uint8_t> rle(header.rle_size);
+			valid = lz_decompress(payload, header.compressed_size, rle.data(), rle.size())
+				&& rle_decode_columns(rle.data(), rle.size(), voxels, dimensions);
+		}
+
+		if (!valid)
+		{
+			// stale or corrupt, gets overwritten by the next store
+			LOG("chunk cache: ignoring invalid file for chunk [{}, {}] lod {}", key.index.x, key.index.y, key.lod);
+			m_Misses++;
+			return false;
+		}
+
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+		m_Hits++;
+		m_BytesLoaded += (uint64_t)dimensions.x * dimensions.y * dimensions.z;
+		m_BytesRead += file->get_size();
+		m_LoadNanoseconds += (uint64_t)elapsed.count();
+
+		return true;
+	}
+
+	void ChunkCache::store(const ChunkCacheKey& key, const uint8_t* voxels, Int3 dimensions)
+	{
+		std::vector<uint8_t> rle;
+		rle_encode_columns(voxels, dimensions, rle);
+
+		std::vector<uint8_t> compressed(lz_compress_bound(rle.size()));
+		size_t compressedSize = lz_compress(rle.data(), rle.size(), compressed.data(), compressed.size());
+
+		ChunkFileHeader header{};
+		header.magic = ChunkFileMagic;
+		header.version = ChunkFileVersion;
+		header.seed = key.seed;
+		header.index_x = key.index.x;
+		header.index_y = key.index.y;
+		header.lod = key.lod;
+		header.generator = key.generator;
+		header.reduction = key.reduction;
+		header.width = dimensions.x;
+		header.height = dimensions.y;
+		header.depth = dimensions.z;
+		header.rle_size = (uint32_t)rle.size();
+		header.compressed_size = (uint32_t)compressedSize;
+		header.checksum = fnv1a(compressed.data(), compressedSize);
+
+		std::filesystem::path path = get_chunk_path(key);
+		std::filesystem::path tempPath = path;
+		tempPath += std::format(".{}.tmp", m_TempFileCounter++); // unique, two stores of one key never share a temp file
+
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+
+		{
+			std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!out)
+			{
+				LOG("chunk cache: couldn't write '{}'", tempPath.string());
+				return;
+			}
+
+			out.write((const char*)&header, sizeof(header));
+			out.write((const char*)compressed.data(), compressedSize);
+		}
+
+		// readers never see half written files
+		std::filesystem::remove(path, error);
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+		{
+			LOG("chunk cache: couldn't move '{}' into place ({})", path.string(), error.message());
+			return;
+		}
+
+		m_Writes++;
+		m_BytesWritten += sizeof(header) + compressedSize;
+	}
+
+	void ChunkCache::clear()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_Directory, error);
+		std::filesystem::create_directories(m_Directory, error);
+	}
+
+	ChunkCacheStats ChunkCache::get_stats() const
+	{
+		ChunkCacheStats stats;
+		stats.hits = m_Hits;
+		stats.misses = m_Misses;
+		stats.writes = m_Writes;
+		stats.bytes_loaded = m_BytesLoaded;
+		stats.bytes_read = m_BytesRead;
+		stats.bytes_written = m_BytesWritten;
+		stats.load_seconds = m_LoadNanoseconds / 1e9;
+		return stats;
+	}
+
+	void ChunkCache::reset_stats()
+	{
+		m_Hits = m_Misses = m_Writes = 0;
+		m_BytesLoaded = m_BytesRead = m_BytesWritten = 0;
+		m_LoadNanoseconds = 0;
+	}
+
+	void ChunkCache::log_stats() const
+	{
+		ChunkCacheStats stats = get_stats();
+		float ratio = stats.bytes_read ? (float)stats.bytes_loaded / stats.bytes_read : 0.0f;
+
+		LOG("chunk cache: {} hits, {} misses ({:.1f}% hit rate), {} writes", stats.hits, stats.misses, stats.get_hit_ratio() * 100.0f, stats.writes);
+		LOG("chunk cache: loaded {:.1f}MB from {:.2f}MB on disk ({:.0f}:1) at {:.0f}MB/s",
+			stats.bytes_loaded / (1024.0 * 1024.0), stats.bytes_read / (1024.0 * 1024.0), ratio, stats.get_load_mb_per_second());
+	}
+
+}
\ No newline at end of file
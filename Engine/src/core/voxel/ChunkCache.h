@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+
+namespace Engine {
+
+	struct ChunkCacheKey
+	{
+		uint32_t seed = 0;
+		Int2 index{};
+		uint32_t lod = 0;
+		uint32_t generator = 0; // TerrainGenerationMode, modes produce different volumes
+		uint32_t reduction = 0; // VoxelMipReduction the LOD was downsampled with, 0 for LOD0
+	};
+
+	struct ChunkCacheStats
+	{
+		uint32_t hits = 0, misses = 0, writes = 0;
+		uint64_t bytes_loaded = 0; // decoded voxel bytes
+		uint64_t bytes_read = 0;   // compressed file bytes
+		uint64_t bytes_written = 0;
+		double load_seconds = 0.0;
+
+		float get_hit_ratio() const { return hits + misses ? (float)hits / (hits + misses) : 0.0f; }
+		float get_load_mb_per_second() const { return load_seconds > 0.0 ? (float)(bytes_loaded / (1024.0 * 1024.0) / load_seconds) : 0.0f; }
+	};
+
+	// on-disk cache of generated chunk volumes, one file per seed/generator/chunk/LOD/mip reduction
+	// files are per-column RLE (along y) followed by lz_compress, loaded through a memory mapping
+	// load/store are safe to call from job threads
+	class ChunkCache
+	{
+	public:
+		ChunkCache(const std::filesystem::path& directory);
+
+		// voxels is a tightly packed R8UI volume (x fastest, then y, then z)
+		bool load(const ChunkCacheKey& key, uint8_t* voxels, Int3 dimensions);
+		void store(const ChunkCacheKey& key, const uint8_t* voxels, Int3 dimensions);
+
+		bool contains(const ChunkCacheKey& key) const;
+		void clear();
+
+		ChunkCacheStats get_stats() const;
+		void reset_stats();
+		void log_stats() const;
+
+		const std::filesystem::path& get_directory() const { return m_Directory; }
+	private:
+		std::filesystem::path get_chunk_path(const ChunkCacheKey& key) const;
+	private:
+		std::filesystem::path m_Directory;
+
+		std::atomic<uint32_t> m_Hits = 0, m_Misses = 0, m_Writes = 0;
+		std::atomic<uint64_t> m_BytesLoaded = 0, m_BytesRead = 0, m_BytesWritten = 0;
+		std::atomic<uint64_t> m_LoadNanoseconds = 0;
+		std::atomic<uint32_t> m_TempFileCounter = 0;
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,577 @@
+#include "pch.h"
+
+#include "OcclusionBricks.h"
+
+#include "threading/JobSystem.h"
+
+#include <chrono>
+#include <random>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define OCCLUSION_BRICKS_AVX2 1
+#endif
+
+namespace Engine {
+
+	// 4 voxels -> 4 bits, bit i set if byte i is non zero
+	static inline uint32_t row_occupancy(const uint8_t* row)
+	{
+		uint32_t v;
+		memcpy(&v, row, sizeof(v));
+
+		// high bit of every non zero byte, then gather them into the top nibble
+		uint32_t nonZero = (((v & 0x7F7F7F7Fu) + 0x7F7F7F7Fu) | v) & 0x80808080u;
+		return ((nonZero >> 7) * 0x10204080u) >> 28;
+	}
+
+	// any solid voxel in the stride^3 block at base
+	static inline bool any_solid(const uint8_t* base, uint32_t stride, size_t strideY, size_t strideZ)
+	{
+		for (uint32_t z = 0; z < stride; z++)
+		for (uint32_t y = 0; y < stride; y++)
+		for (uint32_t x = 0; x < stride; x++)
+		{
+			if (base[x + y * strideY + z * strideZ])
+				return true;
+		}
+		return false;
+	}
+
+	static uint64_t encode_brick(const uint8_t* voxels, size_t strideY, size_t strideZ, Int3 brick, uint32_t stride)
+	{
+		const size_t span = OcclusionBrickSize * stride;
+		const uint8_t* base = voxels + brick.x * span + brick.y * span * strideY + brick.z * span * strideZ;
+
+		uint64_t bits = 0;
+		if (stride == 1)
+		{
+			for (uint32_t z = 0; z < 4; z++)
+			for (uint32_t y = 0; y < 4; y++)
+				bits |= (uint64_t)row_occupancy(base + y * strideY + z * strideZ) << (y * 4 + z * 16);
+			return bits;
+		}
+
+		for (uint32_t z = 0; z < 4; z++)
+		for (uint32_t y = 0; y < 4; y++)
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			if (any_solid(base + (x + y * strideY + z * strideZ) * stride, stride, strideY, strideZ))
+				bits |= 1ull << occlusion_brick_bit(Int3(x, y, z));
+		}
+		return bits;
+	}
+
+	void encode_occlusion_bricks_slab(const uint8_t* voxels, Int3 dimensions, uint64_t* bricks, uint32_t source_stride, uint32_t z_begin, uint32_t z_end)
+	{
+		const int32_t span = (int32_t)(OcclusionBrickSize * source_stride);
+		ASSERT(dimensions.x % span == 0 && dimensions.y % span == 0 && dimensions.z % span == 0);
+
+		const Int3 brickDimensions = dimensions / span;
+		const size_t strideY = dimensions.x;
+		const size_t strideZ = (size_t)dimensions.x * dimensions.y;
+
+#if OCCLUSION_BRICKS_AVX2
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i nibble = _mm256_set1_epi32(0xF);
+		const __m256i nibbleShifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+#endif
+
+		for (uint32_t bz = z_begin; bz < z_end; bz++)
+		for (int32_t by = 0; by < brickDimensions.y; by++)
+		{
+			uint64_t* out = bricks + (by + (size_t)bz * brickDimensions.y) * brickDimensions.x;
+
+			int32_t bx = 0;
+#if OCCLUSION_BRICKS_AVX2
+			// 32 voxels of a row cover 8 bricks: one movemask per row, then every brick takes its nibble
+			// bits of z 0-1 and z 2-3 are gathered as 32 bit lanes and interleaved into 64 bit bricks at the end
+			if (source_stride == 1)
+			{
+				for (; bx + 8 <= brickDimensions.x; bx += 8)
+				{
+					const uint8_t* base = voxels + bx * 4 + by * 4 * strideY + bz * 4 * strideZ;
+
+					__m256i low = zero, high = zero;
+					for (uint32_t z = 0; z < 4; z++)
+					for (uint32_t y = 0; y < 4; y++)
+					{
+						__m256i row = _mm256_loadu_si256((const __m256i*)(base + y * strideY + z * strideZ));
+						uint32_t solid = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(row, zero));
+
+						__m256i bits = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int32_t)solid), nibbleShifts), nibble);
+						bits = _mm256_sll_epi32(bits, _mm_cvtsi32_si128(y * 4 + (z & 1) * 16));
+						if (z < 2)
+							low = _mm256_or_si256(low, bits);
+						else
+							high = _mm256_or_si256(high, bits);
+					}
+
+					// per 128 bit lane: bricks 0 1 4 5 and 2 3 6 7
+					__m256i a = _mm256_unpacklo_epi32(low, high);
+					__m256i b = _mm256_unpackhi_epi32(low, high);
+					_mm256_storeu_si256((__m256i*)(out + bx), _mm256_permute2x128_si256(a, b, 0x20));
+					_mm256_storeu_si256((__m256i*)(out + bx + 4), _mm256_permute2x128_si256(a, b, 0x31));
+				}
+			}
+#endif
+			for (; bx < brickDimensions.x; bx++)
+				out[bx] = encode_brick(voxels, strideY, strideZ, Int3(bx, by, bz), source_stride);
+		}
+	}
+
+	bool validate_occlusion_brick_encoder()
+	{
+		// 72 voxels wide: two AVX2 groups of 8 bricks and a scalar tail in every row
+		const Int3 dimensions = Int3(72, 16, 16);
+		const Int3 brickDimensions = dimensions / (int)OcclusionBrickSize;
+		const size_t strideY = dimensions.x;
+		const size_t strideZ = (size_t)dimensions.x * dimensions.y;
+
+		std::vector<uint8_t> voxels(strideZ * dimensions.z);
+		std::vector<uint64_t> simd((size_t)brickDimensions.x * brickDimensions.y * brickDimensions.z), scalar(simd.size());
+
+		uint32_t patterns = 0, failed = 0;
+		auto check = [&](const char* pattern)
+		{
+			encode_occlusion_bricks_slab(voxels.data(), dimensions, simd.data(), 1, 0, brickDimensions.z);
+
+			size_t i = 0;
+			for (int32_t z = 0; z < brickDimensions.z; z++)
+			for (int32_t y = 0; y < brickDimensions.y; y++)
+			for (int32_t x = 0; x < brickDimensions.x; x++)
+				scalar[i++] = encode_brick(voxels.data(), strideY, strideZ, Int3(x, y, z), 1);
+
+			size_t mismatches = 0;
+			for (i = 0; i < simd.size(); i++)
+				mismatches += simd[i] != scalar[i];
+
+			patterns++;
+			if (mismatches)
+			{
+				LOG("occlusion encoder validation: {} - {} / {} bricks differ", pattern, mismatches, simd.size());
+				failed++;
+			}
+		};
+
+		// any non zero material is solid, including ones with the high bit set
+		std::mt19937 rng(1234);
+		for (uint32_t percent : { 5u, 50u, 95u })
+		{
+			for (uint8_t& voxel : voxels)
+				voxel = rng() % 100 < percent ? (uint8_t)(1 + rng() % 255) : 0;
+			check("random");
+		}
+
+		std::fill(voxels.begin(), voxels.end(), 0);
+		check("all empty");
+		std::fill(voxels.begin(), voxels.end(), 0xFF);
+		check("all solid");
+
+		// every corner of every brick along a row, the volume's corners are among them
+		for (int32_t by : { 0, brickDimensions.y - 1 })
+		for (int32_t bz : { 0, brickDimensions.z - 1 })
+		for (int32_t bx = 0; bx < brickDimensions.x; bx++)
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			Int3 voxel = Int3(bx, by, bz) * (int)OcclusionBrickSize + Int3(corner & 1, (corner >> 1) & 1, corner >> 2) * 3;
+			size_t index = voxel.x + voxel.y * strideY + voxel.z * strideZ;
+
+			std::fill(voxels.begin(), voxels.end(), 0);
+			voxels[index] = 1;
+			check("single voxel at a brick corner");
+		}
+
+		for (int32_t z = 0; z < dimensions.z; z++)
+		for (int32_t y = 0; y < dimensions.y; y++)
+			memset(voxels.data() + y * strideY + z * strideZ, (y + z) & 1, dimensions.x);
+		check("alternating rows");
+
+#if OCCLUSION_BRICKS_AVX2
+		LOG("occlusion encoder validation: {} / {} patterns match between AVX2 and scalar", patterns - failed, patterns);
+#else
+		LOG("occlusion encoder validation: built without AVX2, {} / {} patterns match", patterns - failed, patterns);
+#endif
+		return failed == 0;
+	}
+
+	void encode_occlusion_bricks(const uint8_t* voxels, Int3 dimensions, uint64_t* bricks, uint32_t source_stride)
+	{
+		constexpr uint32_t SlicesPerJob = 4;
+		JobSystem::parallel_for(dimensions.z / (OcclusionBrickSize * source_stride), SlicesPerJob, [=](uint32_t begin, uint32_t end)
+		{
+			encode_occlusion_bricks_slab(voxels, dimensions, bricks, source_stride, begin, end);
+		}).wait();
+	}
+
+	// 4x4x4 brick -> its 2x2x2 OR reduction at bits x + y * 4 + z * 16 (x, y, z in 0-1)
+	static inline uint64_t reduce_brick(uint64_t m)
+	{
+		m |= m >> 1;
+		m |= m >> 4;
+		m |= m >> 16;
+
+		// the even x, y, z bits hold the result, squeeze them together one axis at a time
+		m = (m & 0x0000010100000101ull) | ((m & 0x0000040400000404ull) >> 1);
+		m = (m & 0x0000000300000003ull) | ((m & 0x0000030000000300ull) >> 4);
+		m = (m & 0x0000000000000033ull) | ((m & 0x0000003300000000ull) >> 16);
+		return m;
+	}
+
+#if OCCLUSION_BRICKS_AVX2
+	static inline __m256i reduce_bricks(__m256i m)
+	{
+		m = _mm256_or_si256(m, _mm256_srli_epi64(m, 1));
+		m = _mm256_or_si256(m, _mm256_srli_epi64(m, 4));
+		m = _mm256_or_si256(m, _mm256_srli_epi64(m, 16));
+
+		auto squeeze = [](__m256i m, uint64_t keep, uint64_t move, int shift)
+		{
+			return _mm256_or_si256(_mm256_and_si256(m, _mm256_set1_epi64x(keep)), _mm256_srli_epi64(_mm256_and_si256(m, _mm256_set1_epi64x(move)), shift));
+		};
+		m = squeeze(m, 0x0000010100000101ull, 0x0000040400000404ull, 1);
+		m = squeeze(m, 0x0000000300000003ull, 0x0000030000000300ull, 4);
+		m = squeeze(m, 0x0000000000000033ull, 0x0000003300000000ull, 16);
+		return m;
+	}
+#endif
+
+	void downsample_occlusion_bricks_slab(const uint64_t* bricks, Int3 brick_dimensions, uint64_t* dest, uint32_t z_begin, uint32_t z_end)
+	{
+		const Int3 destDimensions = (brick_dimensions + 1) / 2;
+
+		for (uint32_t z = z_begin; z < z_end; z++)
+		for (int32_t y = 0; y < destDimensions.y; y++)
+		{
+			uint64_t* out = dest + (y + (size_t)z * destDimensions.y) * destDimensions.x;
+
+			// child brick rows of this dest row, missing ones at odd edges are skipped
+			const uint64_t* rows[4] = {};
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				Int3 child = Int3(0, y * 2 + (i & 1), z * 2 + (i >> 1));
+				if (child.y < brick_dimensions.y && child.z < brick_dimensions.z)
+					rows[i] = bricks + (child.y + (size_t)child.z * brick_dimensions.y) * brick_dimensions.x;
+			}
+
+			int32_t x = 0;
+#if OCCLUSION_BRICKS_AVX2
+			// 4 dest bricks from 8 consecutive child bricks per row, split into even & odd children
+			for (; x + 4 <= destDimensions.x && x * 2 + 8 <= brick_dimensions.x; x += 4)
+			{
+				__m256i result = _mm256_setzero_si256();
+				for (uint32_t i = 0; i < 4; i++)
+				{
+					if (!rows[i])
+						continue;
+
+					__m256i a = _mm256_loadu_si256((const __m256i*)(rows[i] + x * 2));
+					__m256i b = _mm256_loadu_si256((const __m256i*)(rows[i] + x * 2 + 4));
+					__m256i even = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0b11011000);
+					__m256i odd = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0b11011000);
+
+					int shift = (i & 1) * 8 + (i >> 1) * 32;
+					result = _mm256_or_si256(result, _mm256_sll_epi64(reduce_bricks(even), _mm_cvtsi32_si128(shift)));
+					result = _mm256_or_si256(result, _mm256_sll_epi64(reduce_bricks(odd), _mm_cvtsi32_si128(shift + 2)));
+				}
+				_mm256_storeu_si256((__m256i*)(out + x), result);
+			}
+#endif
+			for (; x < destDimensions.x; x++)
+			{
+				uint64_t result = 0;
+				for (uint32_t i = 0; i < 4; i++)
+				{
+					if (!rows[i])
+						continue;
+
+					int shift = (i & 1) * 8 + (i >> 1) * 32;
+					result |= reduce_brick(rows[i][x * 2]) << shift;
+					if (x * 2 + 1 < brick_dimensions.x)
+						result |= reduce_brick(rows[i][x * 2 + 1]) << (shift + 2);
+				}
+				out[x] = result;
+			}
+		}
+	}
+
+	void downsample_occlusion_bricks(const uint64_t* bricks, Int3 brick_dimensions, uint64_t* dest)
+	{
+		constexpr uint32_t SlicesPerJob = 4;
+		JobSystem::parallel_for((brick_dimensions.z + 1) / 2, SlicesPerJob, [=](uint32_t begin, uint32_t end)
+		{
+			downsample_occlusion_bricks_slab(bricks, brick_dimensions, dest, begin, end);
+		}).wait();
+	}
+
+	void OcclusionBrickVolume::build(const uint8_t* voxels, Int3 dimensions, uint32_t source_stride, uint32_t mip_count)
+	{
+		mips.resize(mip_count);
+		brick_dimensions.resize(mip_count);
+
+		Int3 d = dimensions / (int)(OcclusionBrickSize * source_stride);
+		for (uint32_t mip = 0; mip < mip_count; mip++)
+		{
+			brick_dimensions[mip] = d;
+			mips[mip].resize((size_t)d.x * d.y * d.z);
+
+			if (mip == 0)
+				encode_occlusion_bricks(voxels, dimensions, mips[0].data(), source_stride);
+			else
+				downsample_occlusion_bricks(mips[mip - 1].data(), brick_dimensions[mip - 1], mips[mip].data());
+
+			d = (d + 1) / 2;
+		}
+	}
+
+	void encode_occlusion_blocks(const uint8_t* voxels, Int3 dimensions, uint8_t* blocks)
+	{
+		const Int3 blockDimensions = dimensions / 2;
+		const size_t strideY = dimensions.x;
+		const size_t strideZ = (size_t)dimensions.x * dimensions.y;
+
+		for (int32_t z = 0; z < blockDimensions.z; z++)
+		for (int32_t y = 0; y < blockDimensions.y; y++)
+		for (int32_t x = 0; x < blockDimensions.x; x++)
+		{
+			const uint8_t* base = voxels + x * 2 + y * 2 * strideY + z * 2 * strideZ;
+
+			uint8_t block = 0;
+			for (uint32_t i = 0; i < 8; i++)
+				block |= (base[(i & 1) + ((i >> 1) & 1) * strideY + (i >> 2) * strideZ] != 0) << i;
+
+			blocks[x + (y + (size_t)z * blockDimensions.y) * blockDimensions.x] = block;
+		}
+	}
+
+	struct VoxelDDA
+	{
+		Int3 pos{};
+		Int3 step{};
+		Float3 tMax{};
+		Float3 delta{};
+
+		VoxelDDA(Float3 origin, Float3 direction)
+		{
+			pos = Int3(glm::floor(origin));
+			for (int a = 0; a < 3; a++)
+			{
+				step[a] = direction[a] > 0.0f ? 1 : (direction[a] < 0.0f ? -1 : 0);
+				delta[a] = step[a] != 0 ? glm::abs(1.0f / direction[a]) : FLT_MAX;
+				tMax[a] = step[a] != 0 ? ((float)pos[a] - origin[a] + (step[a] > 0 ? 1.0f : 0.0f)) / direction[a] : FLT_MAX;
+			}
+		}
+
+		// t at which the current voxel was entered
+		float get_entry_t(int axis) const { return axis < 0 ? 0.0f : tMax[axis] - delta[axis]; }
+
+		int advance()
+		{
+			int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+			pos[axis] += step[axis];
+			tMax[axis] += delta[axis];
+			return axis;
+		}
+
+		// SkipBrick in occlusion_bricks.glinc
+		int skip_brick()
+		{
+			Int3 local = pos & 3;
+			Int3 remaining;
+			Float3 tExit;
+			for (int a = 0; a < 3; a++)
+			{
+				remaining[a] = step[a] > 0 ? 3 - local[a] : (step[a] < 0 ? local[a] : 1 << 20);
+				tExit[a] = step[a] != 0 ? tMax[a] + delta[a] * remaining[a] : FLT_MAX;
+			}
+
+			int axis = tExit.x < tExit.y ? (tExit.x < tExit.z ? 0 : 2) : (tExit.y < tExit.z ? 1 : 2);
+			float tLeave = tExit[axis];
+
+			for (int a = 0; a < 3; a++)
+			{
+				if (step[a] == 0)
+					continue;
+
+				int crossings = a == axis ? remaining[a] + 1 : glm::clamp((int)glm::ceil((tLeave - tMax[a]) / delta[a]), 0, remaining[a]);
+				pos[a] += step[a] * crossings;
+				tMax[a] += delta[a] * crossings;
+			}
+
+			return axis;
+		}
+	};
+
+	static inline bool inside(Int3 pos, Int3 dimensions)
+	{
+		return pos.x >= 0 && pos.y >= 0 && pos.z >= 0 && pos.x < dimensions.x && pos.y < dimensions.y && pos.z < dimensions.z;
+	}
+
+	float raycast_occlusion_bricks(const uint64_t* bricks, Int3 brick_dimensions, Float3 origin, Float3 direction, float max_distance, OcclusionRayStats* stats)
+	{
+		Int3 dimensions = brick_dimensions * (int)OcclusionBrickSize;
+
+		VoxelDDA dda(origin, direction);
+		if (!inside(dda.pos, dimensions))
+			return max_distance;
+
+		OcclusionRayStats local;
+		Int3 cachedBrick = Int3(-1);
+		uint64_t brick = 0;
+		int axis = -1;
+
+		float result = max_distance;
+		while (dda.get_entry_t(axis) < max_distance)
+		{
+			local.steps++;
+
+			Int3 brickPos = dda.pos >> 2;
+			if (brickPos != cachedBrick)
+			{
+				cachedBrick = brickPos;
+				brick = bricks[brickPos.x + (brickPos.y + (size_t)brickPos.z * brick_dimensions.y) * brick_dimensions.x];
+				local.fetches++;
+			}
+
+			if (brick == 0)
+				axis = dda.skip_brick();
+			else if (occlusion_brick_test(brick, dda.pos & 3))
+			{
+				result = dda.get_entry_t(axis);
+				break;
+			}
+			else
+				axis = dda.advance();
+
+			if (!inside(dda.pos, dimensions))
+				break;
+		}
+
+		if (stats)
+		{
+			stats->fetches += local.fetches;
+			stats->steps += local.steps;
+		}
+		return glm::min(result, max_distance);
+	}
+
+	float raycast_occlusion_blocks(const uint8_t* blocks, Int3 block_dimensions, Float3 origin, Float3 direction, float max_distance, bool cache_fetches, OcclusionRayStats* stats)
+	{
+		Int3 dimensions = block_dimensions * 2;
+
+		VoxelDDA dda(origin, direction);
+		if (!inside(dda.pos, dimensions))
+			return max_distance;
+
+		OcclusionRayStats local;
+		Int3 cachedBlock = Int3(-1);
+		uint8_t block = 0;
+		int axis = -1;
+
+		float result = max_distance;
+		while (dda.get_entry_t(axis) < max_distance)
+		{
+			local.steps++;
+
+			Int3 blockPos = dda.pos >> 1;
+			if (!cache_fetches || blockPos != cachedBlock)
+			{
+				cachedBlock = blockPos;
+				block = blocks[blockPos.x + (blockPos.y + (size_t)blockPos.z * block_dimensions.y) * block_dimensions.x];
+				local.fetches++;
+			}
+
+			Int3 bit = dda.pos & 1;
+			if ((block >> (bit.x + bit.y * 2 + bit.z * 4)) & 1)
+			{
+				result = dda.get_entry_t(axis);
+				break;
+			}
+
+			axis = dda.advance();
+			if (!inside(dda.pos, dimensions))
+				break;
+		}
+
+		if (stats)
+		{
+			stats->fetches += local.fetches;
+			stats->steps += local.steps;
+		}
+		return glm::min(result, max_distance);
+	}
+
+	void benchmark_occlusion_formats(const uint8_t* voxels, Int3 dimensions, uint32_t ray_count, float ray_length)
+	{
+		Int3 brickDimensions = dimensions / (int)OcclusionBrickSize;
+		std::vector<uint64_t> bricks((size_t)brickDimensions.x * brickDimensions.y * brickDimensions.z);
+		encode_occlusion_bricks(voxels, dimensions, bricks.data());
+
+		Int3 blockDimensions = dimensions / 2;
+		std::vector<uint8_t> blocks((size_t)blockDimensions.x * blockDimensions.y * blockDimensions.z);
+		encode_occlusion_blocks(voxels, dimensions, blocks.data());
+
+		// rays start just above the surface of random columns, cosine-ish hemisphere around +y like the AO pass
+		struct Ray { Float3 origin, direction; };
+		std::vector<Ray> rays;
+		rays.reserve(ray_count);
+
+		std::mt19937 rng(1337);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		size_t strideZ = (size_t)dimensions.x * dimensions.y;
+		for (uint32_t attempts = 0; rays.size() < ray_count && attempts < ray_count * 4; attempts++)
+		{
+			int32_t x = (int32_t)(uniform(rng) * (dimensions.x - 1));
+			int32_t z = (int32_t)(uniform(rng) * (dimensions.z - 1));
+
+			int32_t top = -1;
+			for (int32_t y = dimensions.y - 1; y >= 0 && top < 0; y--)
+				top = voxels[x + y * dimensions.x + z * strideZ] ? y : -1;
+			if (top < 0 || top + 1 >= dimensions.y)
+				continue;
+
+			float r0 = uniform(rng), r1 = uniform(rng);
+			float sinTheta = glm::sqrt(r1), phi = 2.0f * glm::pi<float>() * r0;
+			Float3 direction = Float3(sinTheta * glm::cos(phi), glm::sqrt(1.0f - r1), sinTheta * glm::sin(phi));
+
+			// one voxel off the surface, like CastAmbientOcclusionRay
+			Float3 origin = Float3(x + 0.5f, top + 1.0f, z + 0.5f) + direction;
+			rays.push_back({ origin, direction });
+		}
+
+		if (rays.empty())
+		{
+			LOG("occlusion benchmark: no surface found");
+			return;
+		}
+
+		auto run = [&](const char* name, auto&& cast)
+		{
+			OcclusionRayStats stats;
+			uint32_t hits = 0;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (const Ray& ray : rays)
+				hits += cast(ray, stats) < ray_length;
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+			LOG("occlusion benchmark: {} - {:.2f} fetches/ray, {:.2f} steps/ray, {} hits, {:.1f}M rays/s",
+				name, (double)stats.fetches / rays.size(), (double)stats.steps / rays.size(), hits, rays.size() / elapsed.count() / 1000.0);
+		};
+
+		LOG("occlusion benchmark: {} rays of {:.0f} voxels through {}x{}x{}", rays.size(), ray_length, dimensions.x, dimensions.y, dimensions.z);
+		run("2x2x2 R8UI, fetch per step", [&](const Ray& ray, OcclusionRayStats& stats)
+		{
+			return raycast_occlusion_blocks(blocks.data(), blockDimensions, ray.origin, ray.direction, ray_length, false, &stats);
+		});
+		run("2x2x2 R8UI, cached", [&](const Ray& ray, OcclusionRayStats& stats)
+		{
+			return raycast_occlusion_blocks(blocks.data(), blockDimensions, ray.origin, ray.direction, ray_length, true, &stats);
+		});
+		run("4x4x4 RG32UI bricks", [&](const Ray& ray, OcclusionRayStats& stats)
+		{
+			return raycast_occlusion_bricks(bricks.data(), brickDimensions, ray.origin, ray.direction, ray_length, &stats);
+		});
+	}
+
+}
\ No newline at end of file
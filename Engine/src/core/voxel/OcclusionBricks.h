@@ -0,0 +1,78 @@
+#pragma once
+
+namespace Engine {
+
+	// 4x4x4 voxel occupancy in 64 bits, bit x + y * 4 + z * 16
+	// uploaded as RG32UI texels (r = low word), matches occlusion_bricks.glinc
+	static constexpr uint32_t OcclusionBrickSize = 4;
+
+	inline uint32_t occlusion_brick_bit(Int3 local) { return local.x + (local.y << 2) + (local.z << 4); }
+	inline bool occlusion_brick_test(uint64_t brick, Int3 local) { return (brick >> occlusion_brick_bit(local)) & 1; }
+
+	// CPU equivalent of Compute_GenShadowmapBase.glsl
+	// packs a tightly packed R8UI volume (x fastest, then y, then z) into bricks (same order)
+	// an occlusion voxel covers source_stride^3 source voxels and is solid if any of them is,
+	// dimensions / source_stride has to be a multiple of 4
+	void encode_occlusion_bricks(const uint8_t* voxels, Int3 dimensions, uint64_t* bricks, uint32_t source_stride = 1);
+
+	// same as above but only for brick z slices [z_begin, z_end)
+	void encode_occlusion_bricks_slab(const uint8_t* voxels, Int3 dimensions, uint64_t* bricks, uint32_t source_stride, uint32_t z_begin, uint32_t z_end);
+
+	// encodes random, empty, solid, single corner voxel & alternating row volumes through the AVX2 rows and brick by brick
+	// through the scalar path, logs every pattern that differs and returns false if any did
+	bool validate_occlusion_brick_encoder();
+
+	// CPU equivalent of Compute_GenOcclusionMip.glsl, a voxel is solid if any of its 2x2x2 children is
+	// dest has (brick_dimensions + 1) / 2 bricks, missing children at odd edges count as empty
+	void downsample_occlusion_bricks(const uint64_t* bricks, Int3 brick_dimensions, uint64_t* dest);
+
+	// same as above but only for dest z slices [z_begin, z_end)
+	void downsample_occlusion_bricks_slab(const uint64_t* bricks, Int3 brick_dimensions, uint64_t* dest, uint32_t z_begin, uint32_t z_end);
+
+	// packed occlusion of a volume plus its OR mip chain, same layout as a cascade slot on the GPU
+	struct OcclusionBrickVolume
+	{
+		std::vector<std::vector<uint64_t>> mips;
+		std::vector<Int3> brick_dimensions; // per mip
+
+		void build(const uint8_t* voxels, Int3 dimensions, uint32_t source_stride, uint32_t mip_count);
+
+		uint32_t get_mip_count() const { return (uint32_t)mips.size(); }
+		Int3 get_voxel_dimensions(uint32_t mip) const { return brick_dimensions[mip] * (int)OcclusionBrickSize; }
+
+		uint64_t get_brick(uint32_t mip, Int3 brick) const
+		{
+			const Int3& d = brick_dimensions[mip];
+			return mips[mip][brick.x + (brick.y + (size_t)brick.z * d.y) * d.x];
+		}
+
+		// out of bounds is empty
+		bool is_solid(uint32_t mip, Int3 voxel) const
+		{
+			Int3 d = get_voxel_dimensions(mip);
+			if (voxel.x < 0 || voxel.y < 0 || voxel.z < 0 || voxel.x >= d.x || voxel.y >= d.y || voxel.z >= d.z)
+				return false;
+			return occlusion_brick_test(get_brick(mip, voxel >> 2), voxel & 3);
+		}
+	};
+
+	// the previous format, 2x2x2 voxels per R8UI texel with bit x + y * 2 + z * 4, kept for comparisons
+	void encode_occlusion_blocks(const uint8_t* voxels, Int3 dimensions, uint8_t* blocks);
+
+	struct OcclusionRayStats
+	{
+		uint64_t fetches = 0; // texel fetches
+		uint64_t steps = 0;   // DDA iterations (brick skips count as one)
+	};
+
+	// CPU versions of the AO ray march in ComputeAO.glsl, origin & max_distance are in voxels
+	// returns the distance to the first solid voxel or max_distance
+	float raycast_occlusion_bricks(const uint64_t* bricks, Int3 brick_dimensions, Float3 origin, Float3 direction, float max_distance, OcclusionRayStats* stats = nullptr);
+
+	// cache_fetches: only refetch when entering a new texel (TerrainShader did), otherwise every step fetches (ComputeAO did)
+	float raycast_occlusion_blocks(const uint8_t* blocks, Int3 block_dimensions, Float3 origin, Float3 direction, float max_distance, bool cache_fetches, OcclusionRayStats* stats = nullptr);
+
+	// casts hemisphere rays off random surface voxels through both formats of the volume, logs fetches per ray
+	void benchmark_occlusion_formats(const uint8_t* voxels, Int3 dimensions, uint32_t ray_count, float ray_length);
+
+}
\ No newline at end of file
@@ -4,96 +4,1276 @@
 
 #include "VoxelMesh.h"
 #include "Terrain.h"
+#include "TerrainNoise.h"
 
 #include "rendering/Shader.h"
 #include "rendering/Texture.h"
+#include "rendering/StagingRing.h"
 #include "rendering/scene/SceneRenderer.h"
+#include "utils/Camera.h"
+
+#include <chrono>
 
 namespace Engine {
 
-	static constexpr size_t ShadowMapNumMips = 3;
-	static constexpr size_t ShadowMapNumChunks = 3;
-	static constexpr size_t ShadowMapPackFactor = 2;
-	static constexpr size_t ShadowMapWidth = (TerrainChunk::Width * ShadowMapNumChunks) / ShadowMapPackFactor;
-	static constexpr size_t ShadowMapHeight = TerrainChunk::Height / ShadowMapPackFactor;
+	static constexpr size_t ShadowMapNumMips = 3;
+
+	struct OcclusionCascadeDesc
+	{
+		float voxel_scale;
+		uint32_t source_lod, source_stride;
+		int32_t grid;
+		uint32_t mips;
+	};
+
+	// 0.1m over 3x3 chunks (~154m), 0.4m over 12x12 (~614m), 1.6m over 48x48 (~2.5km)
+	// all are 384 bricks wide, the coarser ones are flatter since the terrain height is fixed
+	static constexpr OcclusionCascadeDesc OcclusionCascadeDescs[OcclusionCascade::Count] =
+	{
+		{ 0.1f, 0, 1, 3, ShadowMapNumMips },
+		{ 0.4f, 2, 1, 12, 1 },
+		{ 1.6f, 2, 4, 48, 1 },
+	};
+
+	// tightly packed sub box of a tightly packed volume
+	static void copy_voxel_box(const uint8_t* volume, Int3 dimensions, Int3 min, Int3 size, uint8_t* out)
+	{
+		for (int32_t z = 0; z < size.z; z++)
+		for (int32_t y = 0; y < size.y; y++)
+		{
+			const uint8_t* row = volume + min.x + (min.y + y + (size_t)(min.z + z) * dimensions.y) * dimensions.x;
+			memcpy(out + (y + (size_t)z * size.y) * size.x, row, size.x);
+		}
+	}
+
+	TerrainGenerator::TerrainGenerator(HeadlessTag)
+		: m_Headless(true)
+	{
+		for (uint32_t i = 0; i < OcclusionCascade::Count; i++)
+		{
+			const OcclusionCascadeDesc& desc = OcclusionCascadeDescs[i];
+			OcclusionCascade& cascade = m_OcclusionCascades[i];
+			cascade.voxel_scale = desc.voxel_scale;
+			cascade.source_lod = desc.source_lod;
+			cascade.source_stride = desc.source_stride;
+			cascade.grid = desc.grid;
+		}
+	}
+
+	owning_ptr<TerrainGenerator> TerrainGenerator::create_headless()
+	{
+		return owning_ptr<TerrainGenerator>(new TerrainGenerator(HeadlessTag{}));
+	}
+
+	void TerrainGenerator::add_placeholder_chunk(Int2 chunk_index, uint8_t generated_lods)
+	{
+		// would be drawn without a texture otherwise
+		ASSERT(m_Headless);
+
+		TerrainChunk chunk{};
+		chunk.index = chunk_index;
+		chunk.position = chunk_to_world_position(chunk_index);
+		chunk.transformation = Transformation(chunk.position, {}, Float3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width) * VoxelScaleMeters).get_transform();
+		chunk.generated_lods = generated_lods;
+		chunk.last_used_frame = m_StreamingFrame;
+
+		on_chunk_set_changed(chunk_index);
+		auto [it, inserted] = m_ChunkTable.insert_or_assign(chunk_index, std::move(chunk));
+		if (inserted)
+			m_SortedChunks.push_back(&it->second);
+	}
+
+	TerrainGenerator::TerrainGenerator()
+	{
+		// work group sizes only live here, the shaders get them as defines and dispatch_threads divides by them
+		ShaderDefines volumeGroup = { { "LOCAL_SIZE_X", 4 }, { "LOCAL_SIZE_Y", 4 }, { "LOCAL_SIZE_Z", 4 } };
+		ShaderDefines columnGroup = { { "LOCAL_SIZE_X", 8 }, { "LOCAL_SIZE_Y", 8 } };
+
+		m_TerrainShader = Shader::create_async("resources/shaders/TerrainShader.glsl");
+		m_TerrainShader_DepthPP = Shader::create_async("resources/shaders/TerrainShader_DepthPP.glsl");
+		m_ChunkGenerationShader = ComputeShader::create_async("resources/shaders/compute/Compute_GenerateTerrain.glsl", volumeGroup);
+		m_HeightmapGenerationShader = ComputeShader::create_async("resources/shaders/compute/Compute_GenerateTerrainHeightmap.glsl", columnGroup);
+		m_MipDownsampleShader = ComputeShader::create_async("resources/shaders/compute/Compute_DownsampleVoxelMip.glsl", volumeGroup);
+
+		m_TextureOcclusionMipGenerationShader = ComputeShader::create_async("resources/shaders/compute/Compute_GenOcclusionMip.glsl", volumeGroup);
+		m_ShadowMapBaseMipGenerationShader = ComputeShader::create_async("resources/shaders/compute/Compute_GenShadowmapBase.glsl", volumeGroup);
+
+		Int3 chunk_dimensions = Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width);
+		m_ChunkGenerationShader->set("u_ChunkDimensions", chunk_dimensions);
+
+		// grows in resort_chunks
+		m_ChunkSSBO = ShaderStorageBuffer::create<ChunkInstanceData>(nullptr, 32);
+
+		for (uint32_t i = 0; i < OcclusionCascade::Count; i++)
+		{
+			const OcclusionCascadeDesc& desc = OcclusionCascadeDescs[i];
+			OcclusionCascade& cascade = m_OcclusionCascades[i];
+			cascade.voxel_scale = desc.voxel_scale;
+			cascade.source_lod = desc.source_lod;
+			cascade.source_stride = desc.source_stride;
+			cascade.grid = desc.grid;
+			cascade.chunk_voxels = (chunk_dimensions >> (int)desc.source_lod) / (int)desc.source_stride;
+			cascade.slots.resize(desc.grid * desc.grid, { Int2(0), 0, false });
+
+			Int3 bricks = cascade.chunk_voxels / (int)OcclusionBrickSize * Int3(desc.grid, 1, desc.grid);
+			cascade.texture = Texture3D::create(bricks.x, bricks.y, bricks.z, TextureFormat::RG32UI, desc.mips);
+
+			// every slot starts out empty, so only chunks that exist get packed
+			for (uint32_t mip = 0; mip < desc.mips; mip++)
+				cascade.texture->clear(mip);
+		}
+	}
+
+	TerrainGenerator::~TerrainGenerator()
+	{
+		// jobs write to the chunk cache and read straight out of the readback buffers, both go with this
+		for (const auto& pending : m_PendingChunks)
+			pending->job.wait();
+		for (const auto& [index, store] : m_ChunkStores)
+			store.wait();
+		for (const TerrainReadback& readback : m_TerrainReadbacks)
+			readback.job.wait();
+		for (const VoxelQueryUpdate& update : m_VoxelQueryUpdates)
+			update.volume.wait();
+	}
+
+	void TerrainGenerator::set_generation_backend(TerrainGenerationBackend backend)
+	{
+		// occlusion is diffed against a CPU build that uses the AVX2 encoder, so that one gets checked against scalar first
+		if (backend == TerrainGenerationBackend::Validate && m_Backend != backend)
+			validate_occlusion_brick_encoder();
+		m_Backend = backend;
+	}
+
+	void TerrainGenerator::dispatch_terrain_lod_gen_compute(TerrainChunk& chunk, uint32_t lod)
+	{
+		dispatch_terrain_gen_compute(chunk.mesh.m_Texture.get(), chunk.position + m_NoiseOffset, lod, m_Mode);
+	}
+
+	void TerrainGenerator::dispatch_terrain_gen_compute(Texture3D* texture, Float3 chunk_position, uint32_t lod, TerrainGenerationMode mode)
+	{
+		texture->bind_as_image(0, TextureAccessMode::Write, lod);
+
+		uint32_t mipWidth = TerrainChunk::Width / glm::exp2(lod);
+		uint32_t mipHeight = TerrainChunk::Height / glm::exp2(lod);
+
+		auto& shader = mode == TerrainGenerationMode::Heightmap ? m_HeightmapGenerationShader : m_ChunkGenerationShader;
+		shader->set("u_ChunkDimensions", Int3(mipWidth, mipHeight, mipWidth));
+		shader->set("u_ChunkPositionWorld", chunk_position);
+		shader->set("u_MipLevel", lod);
+
+		// dispatch
+		if (mode == TerrainGenerationMode::Heightmap)
+			shader->dispatch_threads(mipWidth, mipWidth); // one invocation per column
+		else
+			shader->dispatch_threads(mipWidth, mipHeight, mipWidth);
+		Graphics::memory_barrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+	}
+
+	static void generate_terrain_cpu(TerrainGenerationMode mode, uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip)
+	{
+		if (mode == TerrainGenerationMode::Heightmap)
+			generate_terrain_heightmap_cpu(voxels, dimensions, chunk_position, mip);
+		else
+			generate_terrain_voxels_cpu(voxels, dimensions, chunk_position, mip);
+	}
+
+	void TerrainGenerator::generate_terrain_lod_cpu(TerrainChunk& chunk, uint32_t lod)
+	{
+		auto& texture = chunk.mesh.m_Texture;
+		Int3 mipDimensions = texture->get_mip_dimensions(lod);
+
+		auto voxels = std::make_shared<std::vector<uint8_t>>((size_t)mipDimensions.x * mipDimensions.y * mipDimensions.z);
+		generate_terrain_cpu(m_Mode, voxels->data(), mipDimensions, chunk.position + m_NoiseOffset, lod);
+
+		texture->set_data(voxels->data(), 0, 0, 0, lod);
+		store_terrain_lod_in_cache(chunk.index, lod, voxels); // only called for LODs that weren't cached
+		set_chunk_voxels(chunk, lod, std::move(voxels));
+	}
+
+	void TerrainGenerator::validate_terrain_lod(TerrainChunk& chunk, uint32_t lod)
+	{
+		auto& texture = chunk.mesh.m_Texture;
+		Int3 mipDimensions = texture->get_mip_dimensions(lod);
+		size_t voxelCount = (size_t)mipDimensions.x * mipDimensions.y * mipDimensions.z;
+
+		dispatch_terrain_lod_gen_compute(chunk, lod);
+
+		std::vector<uint8_t> gpuVoxels(voxelCount);
+		texture->get_data(gpuVoxels.data(), gpuVoxels.size(), lod);
+
+		std::vector<uint8_t> cpuVoxels(voxelCount);
+		generate_terrain_cpu(m_Mode, cpuVoxels.data(), mipDimensions, chunk.position + m_NoiseOffset, lod);
+
+		// storage isn't cleared before the dispatch (only solid voxels are written), so compare occupancy
+		size_t mismatches = 0;
+		Int3 firstMismatch = Int3(-1);
+		for (size_t i = 0; i < voxelCount; i++)
+		{
+			if ((gpuVoxels[i] != 0) == (cpuVoxels[i] != 0))
+				continue;
+
+			if (mismatches++ == 0)
+			{
+				size_t slice = (size_t)mipDimensions.x * mipDimensions.y;
+				firstMismatch = Int3(i % mipDimensions.x, (i % slice) / mipDimensions.x, i / slice);
+			}
+		}
+
+		if (mismatches == 0)
+		{
+			LOG("terrain validation: chunk [{}, {}] lod {} - CPU matches GPU", chunk.index.x, chunk.index.y, lod);
+			return;
+		}
+
+		LOG("terrain validation: chunk [{}, {}] lod {} - {} / {} voxels differ ({:.4f}%), first at [{}, {}, {}]",
+			chunk.index.x, chunk.index.y, lod, mismatches, voxelCount, 100.0 * mismatches / voxelCount,
+			firstMismatch.x, firstMismatch.y, firstMismatch.z);
+	}
+
+	void TerrainGenerator::benchmark_generation(uint32_t lod)
+	{
+		lod = glm::min(lod, TerrainChunk::LODCount - 1);
+
+		constexpr uint32_t Runs = 5;
+		auto scratch = Texture3D::create(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width, TextureFormat::R8UI, TerrainChunk::LODCount);
+		auto query = TimerQuery::create();
+
+		Int3 mipDimensions = scratch->get_mip_dimensions(lod);
+		std::vector<uint8_t> voxels((size_t)mipDimensions.x * mipDimensions.y * mipDimensions.z);
+		Float3 position = chunk_to_world_position(Int2(0)) + m_NoiseOffset;
+
+		// best of a few runs, the first dispatch also pays for shader warmup
+		for (TerrainGenerationMode mode : { TerrainGenerationMode::Volume, TerrainGenerationMode::Heightmap })
+		{
+			float gpuMS = FLT_MAX, cpuMS = FLT_MAX;
+			for (uint32_t i = 0; i < Runs; i++)
+			{
+				query->begin();
+				dispatch_terrain_gen_compute(scratch.get(), position, lod, mode);
+				query->end();
+				gpuMS = glm::min(gpuMS, query->get_elapsed_ms());
+
+				auto start = std::chrono::high_resolution_clock::now();
+				generate_terrain_cpu(mode, voxels.data(), mipDimensions, position, lod);
+				std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+				cpuMS = glm::min(cpuMS, elapsed.count());
+			}
+
+			LOG("terrain benchmark: {} lod {} ({}x{}x{}) - GPU {:.3f}ms, CPU {:.2f}ms ({} workers)",
+				mode == TerrainGenerationMode::Heightmap ? "heightmap" : "volume", lod,
+				mipDimensions.x, mipDimensions.y, mipDimensions.z, gpuMS, cpuMS, JobSystem::get_worker_count());
+		}
+	}
+
+	void TerrainGenerator::benchmark_occlusion_formats()
+	{
+		Int3 dimensions = Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width);
+		std::vector<uint8_t> voxels((size_t)dimensions.x * dimensions.y * dimensions.z);
+		generate_terrain_cpu(m_Mode, voxels.data(), dimensions, chunk_to_world_position(Int2(0)) + m_NoiseOffset, 0);
+
+		// AO ray length in ComputeAO.glsl, plus longer rays where skipping empty bricks pays off more
+		constexpr uint32_t RayCount = 100000;
+		for (float rayLength : { 10.0f, 64.0f })
+			Engine::benchmark_occlusion_formats(voxels.data(), dimensions, RayCount, rayLength);
+	}
+
+	void TerrainGenerator::set_seed(uint32_t seed)
+	{
+		m_Seed = seed;
+
+		// hash into a domain offset, kept within a few km so float precision stays the same
+		auto hash = [](uint32_t x)
+		{
+			x ^= x >> 16; x *= 0x7feb352d;
+			x ^= x >> 15; x *= 0x846ca68b;
+			x ^= x >> 16;
+			return x;
+		};
+
+		constexpr float OffsetRangeMeters = 4096.0f;
+		m_NoiseOffset = seed == 0 ? Float3(0.0f) : Float3(
+			(hash(seed) & 0xFFFF) / 65535.0f,
+			(hash(seed + 1) & 0xFFFF) / 65535.0f,
+			(hash(seed + 2) & 0xFFFF) / 65535.0f
+		) * OffsetRangeMeters;
+	}
+
+	bool TerrainGenerator::load_terrain_lod_from_cache(TerrainChunk& chunk, uint32_t lod)
+	{
+		if (!m_ChunkCache)
+			return false;
+
+		auto& texture = chunk.mesh.m_Texture;
+		Int3 mipDimensions = texture->get_mip_dimensions(lod);
+
+		// an eviction may still be writing this chunk's edits
+		get_chunk_store(chunk.index).wait();
+
+		auto voxels = std::make_shared<std::vector<uint8_t>>((size_t)mipDimensions.x * mipDimensions.y * mipDimensions.z);
+		if (!m_ChunkCache->load(get_cache_key(chunk.index, lod), voxels->data(), mipDimensions))
+			return false;
+
+		texture->set_data(voxels->data(), 0, 0, 0, lod);
+		set_chunk_voxels(chunk, lod, std::move(voxels));
+		return true;
+	}
+
+	void TerrainGenerator::store_terrain_lod_in_cache(Int2 chunk_index, uint32_t lod, std::shared_ptr<std::vector<uint8_t>> voxels)
+	{
+		if (!m_ChunkCache)
+			return;
+
+		ChunkCache* cache = m_ChunkCache.get();
+		ChunkCacheKey key = get_cache_key(chunk_index, lod);
+		Int3 dimensions = Int3(TerrainChunk::Width >> lod, TerrainChunk::Height >> lod, TerrainChunk::Width >> lod);
+		submit_chunk_store(chunk_index, [cache, key, voxels = std::move(voxels), dimensions]()
+		{
+			cache->store(key, voxels->data(), dimensions);
+		});
+	}
+
+	void TerrainGenerator::set_chunk_voxels(TerrainChunk& chunk, uint32_t lod, std::shared_ptr<std::vector<uint8_t>> voxels)
+	{
+		detach_terrain_readbacks(chunk.index, 1 << lod, false);
+		chunk.voxels[lod] = std::move(voxels);
+	}
+
+	void TerrainGenerator::read_back_terrain_lod(TerrainChunk& chunk, uint32_t lod, bool store_in_cache)
+	{
+		// a glGetTextureImage right here would wait for the whole pipeline (and the generation dispatch) to drain
+		set_chunk_voxels(chunk, lod, nullptr);
+
+		Int3 dimensions = chunk.mesh.m_Texture->get_mip_dimensions(lod);
+		owning_ptr<ReadbackBuffer> buffer;
+		auto& freeBuffers = m_FreeReadbackBuffers[lod];
+		if (!freeBuffers.empty())
+		{
+			buffer = std::move(freeBuffers.back());
+			freeBuffers.pop_back();
+		}
+		else
+		{
+			buffer = ReadbackBuffer::create((size_t)dimensions.x * dimensions.y * dimensions.z);
+		}
+
+		buffer->read_texture(*chunk.mesh.m_Texture, lod);
+
+		TerrainReadback readback;
+		readback.key = get_cache_key(chunk.index, lod);
+		readback.dimensions = dimensions;
+		readback.buffer = std::move(buffer);
+		readback.store_in_cache = store_in_cache && m_ChunkCache;
+		m_TerrainReadbacks.push_back(std::move(readback));
+	}
+
+	void TerrainGenerator::poll_terrain_readbacks()
+	{
+		ChunkCache* cache = m_ChunkCache.get();
+		for (size_t i = 0; i < m_TerrainReadbacks.size();)
+		{
+			TerrainReadback& readback = m_TerrainReadbacks[i];
+			if (readback.job.empty())
+			{
+				if (!readback.buffer->is_ready())
+				{
+					i++;
+					continue;
+				}
+
+				// the job reads straight out of the mapping, the buffer is only reused once it's done
+				const uint8_t* mapped = readback.buffer->get_data();
+				size_t size = (size_t)readback.dimensions.x * readback.dimensions.y * readback.dimensions.z;
+				readback.voxels = std::make_shared<std::vector<uint8_t>>();
+
+				ChunkCacheKey key = readback.key;
+				Int3 dimensions = readback.dimensions;
+				ChunkCache* target = readback.store_in_cache ? cache : nullptr;
+				readback.job = submit_chunk_store(key.index, [target, key, mapped, size, voxels = readback.voxels, dimensions]()
+				{
+					voxels->assign(mapped, mapped + size);
+					if (target)
+						target->store(key, voxels->data(), dimensions);
+				});
+			}
+
+			if (!readback.job.is_done())
+			{
+				i++;
+				continue;
+			}
+
+			auto it = m_ChunkTable.find(readback.key.index);
+			if (readback.becomes_copy && it != m_ChunkTable.end())
+				it->second.voxels[readback.key.lod] = std::move(readback.voxels);
+
+			m_FreeReadbackBuffers[readback.key.lod].push_back(std::move(readback.buffer));
+			m_TerrainReadbacks.erase(m_TerrainReadbacks.begin() + i);
+		}
+	}
+
+	void TerrainGenerator::detach_terrain_readbacks(Int2 chunk_index, uint32_t lod_mask, bool drop_stores)
+	{
+		for (size_t i = 0; i < m_TerrainReadbacks.size();)
+		{
+			TerrainReadback& readback = m_TerrainReadbacks[i];
+			if (readback.key.index != chunk_index || (lod_mask & (1 << readback.key.lod)) == 0)
+			{
+				i++;
+				continue;
+			}
+
+			readback.becomes_copy = false;
+
+			// ones already storing were submitted before anything newer and stay in order
+			if (!drop_stores || !readback.job.empty())
+			{
+				i++;
+				continue;
+			}
+
+			// the GPU may still be writing it, the next read_texture into it is ordered after that anyway
+			m_FreeReadbackBuffers[readback.key.lod].push_back(std::move(readback.buffer));
+			m_TerrainReadbacks.erase(m_TerrainReadbacks.begin() + i);
+		}
+	}
+
+	JobHandle TerrainGenerator::submit_chunk_store(Int2 chunk_index, JobSystem::JobFunction store)
+	{
+		// chained, otherwise a pristine LOD queued earlier could land after (and over) the edits
+		JobHandle& last = m_ChunkStores[chunk_index];
+		last = JobSystem::submit(std::move(store), { last });
+		return last;
+	}
+
+	JobHandle TerrainGenerator::get_chunk_store(Int2 chunk_index) const
+	{
+		auto it = m_ChunkStores.find(chunk_index);
+		return it != m_ChunkStores.end() ? it->second : JobHandle();
+	}
+
+	void TerrainGenerator::generate_terrain_lod(TerrainChunk& chunk, uint32_t lod)
+	{
+		if ((chunk.generated_lods & (1 << lod)) != 0)
+			return;
+
+		bool generated = !load_terrain_lod_from_cache(chunk, lod);
+		if (generated)
+		{
+			// the CPU backend caches straight from its buffer
+			switch (m_Backend)
+			{
+			case TerrainGenerationBackend::GPU:      dispatch_terrain_lod_gen_compute(chunk, lod); read_back_terrain_lod(chunk, lod, true); break;
+			case TerrainGenerationBackend::CPU:      generate_terrain_lod_cpu(chunk, lod); break;
+			case TerrainGenerationBackend::Validate: validate_terrain_lod(chunk, lod); read_back_terrain_lod(chunk, lod, true); break;
+			}
+		}
+
+		chunk.generated_lods |= 1 << lod;
+
+		// replaces the noise generated previews so every LOD agrees with LOD0
+		// cached as well, so streamed in previews match once LOD0 has been generated once
+		if (lod == 0)
+			build_terrain_mips(chunk, 0, generated);
+	}
+
+	TerrainChunkEdits* TerrainGenerator::begin_chunk_edit(TerrainChunk& chunk)
+	{
+		if (chunk.edits)
+			return chunk.edits.get();
+
+		// edits happen at full resolution, coarser LODs are downsampled from it
+		// GPU generated LODs arrive through the async readback, the edit waits for them instead of the texture
+		if ((chunk.generated_lods & 1) == 0)
+			generate_chunk_lod(chunk.index, 0);
+
+		for (const auto& voxels : chunk.voxels)
+		{
+			if (!voxels)
+				return nullptr;
+		}
+
+		chunk.edits = make_owning<TerrainChunkEdits>();
+		TerrainChunkEdits& edits = *chunk.edits;
+		// the edits supersede the generated LODs, they're cached on eviction instead
+		detach_terrain_readbacks(chunk.index, (1 << TerrainChunk::LODCount) - 1, true);
+
+		Int3 bricks = chunk.mesh.m_Texture->get_dimensions() / TerrainChunkEdits::BrickSize;
+		edits.dirty_bricks.resize(((size_t)bricks.x * bricks.y * bricks.z + 63) / 64);
+		return &edits;
+	}
+
+	// cache stores may still be reading the shared copy, writes go to a fresh one then
+	static std::vector<uint8_t>& get_writable_voxels(std::shared_ptr<std::vector<uint8_t>>& voxels)
+	{
+		if (voxels.use_count() > 1)
+			voxels = std::make_shared<std::vector<uint8_t>>(*voxels);
+		return *voxels;
+	}
+
+	static void get_voxel_edit_bounds(const VoxelBox& box, Float3& min, Float3& max)
+	{
+		min = box.min;
+		max = box.max;
+	}
+
+	static void get_voxel_edit_bounds(const VoxelSphere& sphere, Float3& min, Float3& max)
+	{
+		min = sphere.center - sphere.radius;
+		max = sphere.center + sphere.radius;
+	}
+
+	static bool is_inside_voxel_edit(const VoxelBox&, Float3)
+	{
+		return true;
+	}
+
+	static bool is_inside_voxel_edit(const VoxelSphere& sphere, Float3 p)
+	{
+		Float3 d = p - sphere.center;
+		return glm::dot(d, d) <= sphere.radius * sphere.radius;
+	}
+
+	template<typename TShape>
+	uint32_t TerrainGenerator::apply_voxel_edit(const TShape& shape, uint8_t material)
+	{
+		Float3 worldMin, worldMax;
+		get_voxel_edit_bounds(shape, worldMin, worldMax);
+
+		uint32_t changed = 0;
+		Int2 minChunk = world_to_chunk_index(worldMin);
+		Int2 maxChunk = world_to_chunk_index(worldMax);
+		for (int32_t cz = minChunk.y; cz <= maxChunk.y; cz++)
+		for (int32_t cx = minChunk.x; cx <= maxChunk.x; cx++)
+		{
+			auto it = m_ChunkTable.find(Int2(cx, cz));
+			if (it != m_ChunkTable.end())
+				changed += apply_chunk_voxel_edit(it->second, shape, material);
+		}
+
+		return changed;
+	}
+
+	template<typename TShape>
+	uint32_t TerrainGenerator::apply_chunk_voxel_edit(TerrainChunk& chunk, const TShape& shape, uint8_t material)
+	{
+		const Int3 dimensions = Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width);
+		const Int3 bricks = dimensions / TerrainChunkEdits::BrickSize;
+		const Float3 halfChunk = Float3(dimensions) * VoxelScaleMeters * 0.5f;
+
+		Float3 worldMin, worldMax;
+		get_voxel_edit_bounds(shape, worldMin, worldMax);
+
+		Float3 chunkMin = chunk.position - halfChunk;
+		Int3 lo = glm::max(Int3(glm::floor((worldMin - chunkMin) / VoxelScaleMeters)), Int3(0));
+		Int3 hi = glm::min(Int3(glm::ceil((worldMax - chunkMin) / VoxelScaleMeters)), dimensions);
+		if (hi.x <= lo.x || hi.y <= lo.y || hi.z <= lo.z)
+			return 0;
+
+		// edits of a chunk apply in order, so one waiting means this one waits too
+		bool waiting = std::any_of(m_DeferredEdits.begin(), m_DeferredEdits.end(), [&](const DeferredVoxelEdit& edit) { return edit.chunk == chunk.index; });
+		TerrainChunkEdits* edits = waiting ? nullptr : begin_chunk_edit(chunk);
+		if (!edits)
+		{
+			m_DeferredEdits.push_back({ chunk.index, shape, material });
+			return 0;
+		}
+
+		uint8_t* voxels = get_writable_voxels(chunk.voxels[0]).data();
+
+		uint32_t changed = 0;
+		for (int32_t z = lo.z; z < hi.z; z++)
+		for (int32_t y = lo.y; y < hi.y; y++)
+		for (int32_t x = lo.x; x < hi.x; x++)
+		{
+			uint8_t& voxel = voxels[x + (y + (size_t)z * dimensions.y) * dimensions.x];
+			if (voxel == material || !is_inside_voxel_edit(shape, chunkMin + (Float3(x, y, z) + 0.5f) * VoxelScaleMeters))
+				continue;
+
+			voxel = material;
+			changed++;
+
+			Int3 brick = Int3(x, y, z) / TerrainChunkEdits::BrickSize;
+			size_t bit = brick.x + (brick.y + (size_t)brick.z * bricks.y) * bricks.x;
+			edits->dirty_bricks[bit / 64] |= 1ull << (bit % 64);
+			edits->dirty_min = glm::min(edits->dirty_min, brick);
+			edits->dirty_max = glm::max(edits->dirty_max, brick + 1);
+		}
+
+		if (changed && std::find(m_EditedChunks.begin(), m_EditedChunks.end(), chunk.index) == m_EditedChunks.end())
+			m_EditedChunks.push_back(chunk.index);
+
+		m_EditStats.voxels_changed += changed;
+		return changed;
+	}
+
+	uint32_t TerrainGenerator::set_voxels(const VoxelBox& box, uint8_t material)
+	{
+		return apply_voxel_edit(box, material);
+	}
+
+	uint32_t TerrainGenerator::set_voxels(const VoxelSphere& sphere, uint8_t material)
+	{
+		return apply_voxel_edit(sphere, material);
+	}
+
+	void TerrainGenerator::flush_chunk_edits(TerrainChunk& chunk)
+	{
+		TerrainChunkEdits& edits = *chunk.edits;
+		if (edits.dirty_max.x <= edits.dirty_min.x)
+			return;
+
+		auto& texture = chunk.mesh.m_Texture;
+		const Int3 bricks = texture->get_dimensions() / TerrainChunkEdits::BrickSize;
+		auto test_and_clear = [&](int32_t x, int32_t y, int32_t z)
+		{
+			size_t bit = x + (y + (size_t)z * bricks.y) * bricks.x;
+			uint64_t mask = 1ull << (bit % 64);
+			bool dirty = edits.dirty_bricks[bit / 64] & mask;
+			edits.dirty_bricks[bit / 64] &= ~mask;
+			return dirty;
+		};
+
+		// runs of dirty bricks along x become one sub box per LOD, coarser LODs are downsampled on the CPU first
+		// a LOD0 brick is exactly one LOD2 voxel, so every LOD gets whole voxels
+		std::vector<uint8_t> scratch;
+		for (int32_t z = edits.dirty_min.z; z < edits.dirty_max.z; z++)
+		for (int32_t y = edits.dirty_min.y; y < edits.dirty_max.y; y++)
+		{
+			int32_t x = edits.dirty_min.x;
+			while (x < edits.dirty_max.x)
+			{
+				if (!test_and_clear(x, y, z))
+				{
+					x++;
+					continue;
+				}
+
+				int32_t runEnd = x + 1;
+				while (runEnd < edits.dirty_max.x && test_and_clear(runEnd, y, z))
+					runEnd++;
+
+				Int3 voxelMin = Int3(x, y, z) * TerrainChunkEdits::BrickSize;
+				Int3 voxelMax = Int3(runEnd, y + 1, z + 1) * TerrainChunkEdits::BrickSize;
+				for (uint32_t lod = 0; lod < TerrainChunk::LODCount; lod++)
+				{
+					Int3 lodMin = voxelMin >> (int)lod, lodMax = voxelMax >> (int)lod;
+					if (lod > 0)
+						downsample_voxel_mip_region(chunk.voxels[lod - 1]->data(), texture->get_mip_dimensions(lod - 1), get_writable_voxels(chunk.voxels[lod]).data(), m_MipReduction, lodMin, lodMax);
+
+					Int3 size = lodMax - lodMin;
+					scratch.resize((size_t)size.x * size.y * size.z);
+					copy_voxel_box(chunk.voxels[lod]->data(), texture->get_mip_dimensions(lod), lodMin, size, scratch.data());
+					texture->set_region(scratch.data(), lodMin, size, lod);
+
+					m_EditStats.bytes_uploaded += scratch.size();
+				}
+
+				m_EditStats.bricks_uploaded += runEnd - x;
+				x = runEnd;
+			}
+		}
+
+		// occlusion of the dirty bounds, in every cascade that holds the chunk already (others get it with the whole slot)
+		Int3 voxelMin = edits.dirty_min * TerrainChunkEdits::BrickSize;
+		Int3 voxelMax = edits.dirty_max * TerrainChunkEdits::BrickSize;
+		for (OcclusionCascade& cascade : m_OcclusionCascades)
+		{
+			Int2 slot = get_occlusion_slot(chunk.index, cascade.grid);
+			const OcclusionCascade::Slot& state = cascade.slots[slot.y * cascade.grid + slot.x];
+			if (state.dirty || state.chunk != chunk.index || (state.generated_lods & (1 << cascade.source_lod)) == 0)
+				continue;
+
+			// LOD0 voxels -> cascade bricks, aligned to the coarsest mip so the region's mips only depend on it
+			int32_t voxelsPerBrick = (int32_t)(OcclusionBrickSize * cascade.source_stride) << cascade.source_lod;
+			int32_t alignment = 1 << (cascade.texture->get_mip_count() - 1);
+			Int3 slotBricks = cascade.chunk_voxels / (int)OcclusionBrickSize;
+
+			Int3 brickMin = voxelMin / voxelsPerBrick / alignment * alignment;
+			Int3 brickMax = ((voxelMax + voxelsPerBrick - 1) / voxelsPerBrick + alignment - 1) / alignment * alignment;
+			brickMax = glm::min(brickMax, slotBricks);
+
+			Int3 brickSize = brickMax - brickMin;
+			update_occlusion_region(cascade, slot, &chunk, brickMin, brickSize);
+			m_EditStats.occlusion_bricks_rebuilt += (uint64_t)brickSize.x * brickSize.y * brickSize.z;
+		}
+
+		edits.dirty_min = Int3(INT32_MAX);
+		edits.dirty_max = Int3(INT32_MIN);
+	}
+
+	void TerrainGenerator::flush_voxel_edits()
+	{
+		PROFILE_SCOPE("FlushVoxelEdits");
+		if (m_EditedChunks.empty() && m_DeferredEdits.empty())
+			return;
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		// all of a chunk's deferred edits become ready together and replay in order
+		// chunks evicted in the meantime drop theirs, like edits of unloaded chunks
+		std::vector<DeferredVoxelEdit> ready;
+		for (size_t i = 0; i < m_DeferredEdits.size();)
+		{
+			auto it = m_ChunkTable.find(m_DeferredEdits[i].chunk);
+			if (it != m_ChunkTable.end() && !begin_chunk_edit(it->second))
+			{
+				i++;
+				continue;
+			}
+
+			if (it != m_ChunkTable.end())
+				ready.push_back(std::move(m_DeferredEdits[i]));
+			m_DeferredEdits.erase(m_DeferredEdits.begin() + i);
+		}
+
+		for (const DeferredVoxelEdit& edit : ready)
+		{
+			TerrainChunk& chunk = m_ChunkTable.at(edit.chunk);
+			std::visit([&](const auto& shape) { apply_chunk_voxel_edit(chunk, shape, edit.material); }, edit.shape);
+		}
+
+		if (m_EditedChunks.empty())
+			return;
+
+		for (Int2 index : m_EditedChunks)
+		{
+			auto it = m_ChunkTable.find(index);
+			if (it != m_ChunkTable.end() && it->second.edits)
+				flush_chunk_edits(it->second);
+		}
+		m_EditedChunks.clear();
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		m_EditStats.last_flush_ms = elapsed.count();
+	}
+
+	void TerrainGenerator::store_chunk_edits_in_cache(TerrainChunk& chunk)
+	{
+		if (!m_ChunkCache)
+			return;
+
+		// the job shares the copies, later edits write to fresh ones
+		ChunkCache* cache = m_ChunkCache.get();
+		for (uint32_t lod = 0; lod < TerrainChunk::LODCount; lod++)
+		{
+			Int3 dimensions = chunk.mesh.m_Texture->get_mip_dimensions(lod);
+			auto voxels = chunk.voxels[lod];
+			ChunkCacheKey key = get_cache_key(chunk.index, lod);
+			submit_chunk_store(chunk.index, [cache, key, voxels, dimensions]()
+			{
+				cache->store(key, voxels->data(), dimensions);
+			});
+		}
+	}
+
+	void TerrainGenerator::dispatch_downsample_compute(Texture3D* texture, uint32_t from_mip)
+	{
+		texture->bind_as_image(0, TextureAccessMode::Read, from_mip);
+		texture->bind_as_image(1, TextureAccessMode::Write, from_mip + 1);
+
+		Int3 writeDimensions = texture->get_mip_dimensions(from_mip + 1);
+		m_MipDownsampleShader->set("u_ReductionRule", (int32_t)m_MipReduction);
+
+		m_MipDownsampleShader->dispatch_threads(writeDimensions.x, writeDimensions.y, writeDimensions.z);
+		Graphics::memory_barrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+	}
+
+	void TerrainGenerator::build_terrain_mips(TerrainChunk& chunk, uint32_t from_lod, bool store_in_cache)
+	{
+		auto& texture = chunk.mesh.m_Texture;
+		uint32_t mipCount = texture->get_mip_count();
+		if (from_lod + 1 >= mipCount)
+			return;
+
+		// the CPU backend downsamples the copy it generated/loaded, without one it goes through the GPU like the others
+		// edited chunks always have theirs, and a readback mustn't replace it
+		if ((m_Backend == TerrainGenerationBackend::CPU || chunk.edits) && chunk.voxels[from_lod])
+		{
+			Int3 dimensions = texture->get_mip_dimensions(from_lod);
+			for (uint32_t mip = from_lod; mip + 1 < mipCount; mip++)
+			{
+				const std::vector<uint8_t>& source = *chunk.voxels[mip];
+				auto dest = std::make_shared<std::vector<uint8_t>>(source.size() / 8);
+				downsample_voxel_mip(source.data(), dimensions, dest->data(), m_MipReduction);
+				texture->set_data(dest->data(), 0, 0, 0, mip + 1);
+				if (store_in_cache)
+					store_terrain_lod_in_cache(chunk.index, mip + 1, dest);
+
+				set_chunk_voxels(chunk, mip + 1, std::move(dest));
+				dimensions /= 2;
+			}
+		}
+		else
+		{
+			for (uint32_t mip = from_lod; mip + 1 < mipCount; mip++)
+			{
+				dispatch_downsample_compute(texture.get(), mip);
+				read_back_terrain_lod(chunk, mip + 1, store_in_cache);
+			}
+		}
+
+		if (m_Backend == TerrainGenerationBackend::Validate)
+		{
+			for (uint32_t mip = from_lod; mip + 1 < mipCount; mip++)
+			{
+				Int3 dimensions = texture->get_mip_dimensions(mip);
+				std::vector<uint8_t> source((size_t)dimensions.x * dimensions.y * dimensions.z);
+				std::vector<uint8_t> gpu(source.size() / 8), cpu(source.size() / 8);
+				texture->get_data(source.data(), source.size(), mip);
+				texture->get_data(gpu.data(), gpu.size(), mip + 1);
+
+				downsample_voxel_mip(source.data(), dimensions, cpu.data(), m_MipReduction);
+
+				size_t mismatches = 0;
+				for (size_t i = 0; i < cpu.size(); i++)
+					mismatches += cpu[i] != gpu[i];
+
+				LOG("mip validation: chunk [{}, {}] lod {} -> {} - {} / {} voxels differ",
+					chunk.index.x, chunk.index.y, mip, mip + 1, mismatches, cpu.size());
+			}
+		}
+
+		for (uint32_t mip = from_lod + 1; mip < mipCount; mip++)
+			chunk.generated_lods |= 1 << mip;
+	}
+
+	void TerrainGenerator::rebuild_chunk_mips(Int2 chunk_index, uint32_t from_lod)
+	{
+		auto it = m_ChunkTable.find(chunk_index);
+		if (it == m_ChunkTable.end())
+			return;
+
+		TerrainChunk& chunk = it->second;
+		if ((chunk.generated_lods & (1 << from_lod)) == 0)
+			return;
+
+		build_terrain_mips(chunk, from_lod);
+		if (from_lod == 0)
+			invalidate_shadowmap_chunk(chunk_index);
+		on_chunk_set_changed(chunk_index);
+	}
+
+	TerrainChunk& TerrainGenerator::generate_chunk_lod(Int2 chunk_index, uint32_t lod)
+	{
+		ASSERT(m_ChunkTable.count(chunk_index));
+
+		TerrainChunk& chunk = m_ChunkTable[chunk_index];
+		generate_terrain_lod(chunk, lod);
+		on_chunk_set_changed(chunk_index);
+
+		return chunk;
+	}
+
+	Float3 TerrainGenerator::chunk_to_world_position(Int2 chunk_index)
+	{
+		Float3 worldPosition = Float3(chunk_index.x, 0.0f, chunk_index.y) * (float)TerrainChunk::Width;
+		return worldPosition * VoxelScaleMeters;
+	}
+
+	Int2 TerrainGenerator::world_to_chunk_index(Float3 position)
+	{
+		// chunk positions are centers
+		constexpr float ChunkSizeMeters = TerrainChunk::Width * VoxelScaleMeters;
+		Float2 chunk = glm::floor(Float2(position.x, position.z) / ChunkSizeMeters + 0.5f);
+		return Int2(chunk);
+	}
+
+	TerrainChunk TerrainGenerator::create_chunk(Int2 chunk_index)
+	{
+		TerrainChunk chunk{};
+		chunk.index = chunk_index;
+		chunk.mesh.m_Texture = Texture3D::create(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width, TextureFormat::R8UI, TerrainChunk::LODCount);
+		chunk.mesh.m_MaterialIndex = 1;
+		chunk.position = chunk_to_world_position(chunk_index);
+		chunk.transformation = Transformation(chunk.position, {}, Float3(chunk.mesh.m_Texture->get_dimensions()) * VoxelScaleMeters).get_transform();
+
+		return chunk;
+	}
+
+	TerrainChunk& TerrainGenerator::finalise_chunk(TerrainChunk&& chunk)
+	{
+		chunk.bindless_texture = chunk.mesh.m_Texture->get_bindless_texture();
+		chunk.bindless_texture.activate();
+		chunk.last_used_frame = m_StreamingFrame;
+
+		Int2 index = chunk.index;
+		on_chunk_set_changed(index);
+
+		auto [it, inserted] = m_ChunkTable.insert_or_assign(index, std::move(chunk));
+		if (inserted)
+			m_SortedChunks.push_back(&it->second); // sorted on the next resort
+
+		return it->second;
+	}
+
+	void TerrainGenerator::on_chunk_set_changed(Int2 chunk_index)
+	{
+		m_InstancesDirty = true;
+
+		// anywhere in the coarsest cascade
+		Int2 fromShadowMap = glm::abs(chunk_index - m_ShadowMapOrigin);
+		int32_t halfGrid = m_OcclusionCascades[OcclusionCascade::Count - 1].grid / 2;
+		if (fromShadowMap.x <= halfGrid && fromShadowMap.y <= halfGrid)
+			m_ShadowMapDirty = true;
+	}
+
+	void TerrainGenerator::evict_chunk(Int2 chunk_index)
+	{
+		auto it = m_ChunkTable.find(chunk_index);
+		if (it == m_ChunkTable.end())
+			return;
+
+		// edits would be lost otherwise, they come back from the cache next time
+		if (it->second.edits)
+			store_chunk_edits_in_cache(it->second);
+		// a chunk streamed back in under the same index mustn't pick up these
+		detach_terrain_readbacks(chunk_index, (1 << TerrainChunk::LODCount) - 1, false);
+
+		// handle has to go before the texture does
+		if (!m_Headless)
+			it->second.bindless_texture.deactivate();
+		// m_SortedChunks points into the table
+		std::erase(m_SortedChunks, &it->second);
+		m_ChunkTable.erase(it);
+		m_VoxelQuery.remove_chunk(chunk_index);
+
+		invalidate_shadowmap_chunk(chunk_index);
+		on_chunk_set_changed(chunk_index);
+	}
+
+	size_t TerrainGenerator::get_loaded_chunk_memory() const
+	{
+		size_t bytes = 0;
+		for (const auto& [index, chunk] : m_ChunkTable)
+		{
+			for (uint32_t mip = 0; mip < chunk.mesh.m_Texture->get_mip_count(); mip++)
+			{
+				Int3 dimensions = chunk.mesh.m_Texture->get_mip_dimensions(mip);
+				bytes += (size_t)dimensions.x * dimensions.y * dimensions.z;
+			}
+
+			for (const auto& voxels : chunk.voxels)
+				bytes += voxels ? voxels->size() : 0;
+		}
+
+		return bytes;
+	}
 
-	struct alignas(16) ChunkInstanceData
+	TerrainChunk& TerrainGenerator::generate_chunk(Int2 chunk_index)
 	{
-		Matrix4 transformation;
-		uint64_t voxel_texture;
-		Int2 index;
-		uint32_t lod;
-	};
+		TerrainChunk chunk = create_chunk(chunk_index);
+		generate_terrain_lod(chunk, 2);
 
-	TerrainGenerator::TerrainGenerator()
+		return finalise_chunk(std::move(chunk));
+	}
+
+	JobHandle TerrainGenerator::generate_chunk_async(Int2 chunk_index)
 	{
-		m_TerrainShader = Shader::create("resources/shaders/TerrainShader.glsl");
-		m_TerrainShader_DepthPP = Shader::create("resources/shaders/TerrainShader_DepthPP.glsl");
-		m_ChunkGenerationShader = ComputeShader::create("resources/shaders/compute/Compute_GenerateTerrain.glsl");
+		constexpr uint32_t InitialLOD = 2;
 
-		m_TextureOcclusionMipGenerationShader = ComputeShader::create("resources/shaders/compute/Compute_GenOcclusionMip.glsl");
-		m_ShadowMapBaseMipGenerationShader = ComputeShader::create("resources/shaders/compute/Compute_GenShadowmapBase.glsl");
+		for (const auto& pending : m_PendingChunks)
+		{
+			if (pending->index == chunk_index)
+				return pending->job;
+		}
 
-		Int3 chunk_dimensions = Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width);
-		m_ChunkGenerationShader->set("u_ChunkDimensions", chunk_dimensions);
-		m_ShadowMapBaseMipGenerationShader->set("u_ChunkDimensions", chunk_dimensions);
+		auto pending = make_owning<PendingChunk>();
+		pending->index = chunk_index;
+		pending->lod = InitialLOD;
+
+		// texture creation & upload need the GL thread, only the noise/cache runs on the workers
+		auto voxels = pending->voxels;
+		Float3 chunkPosition = chunk_to_world_position(chunk_index);
+		ChunkCache* cache = m_ChunkCache.get();
+		ChunkCacheKey key = get_cache_key(chunk_index, InitialLOD);
+		Float3 noiseOffset = m_NoiseOffset;
+		TerrainGenerationMode mode = m_Mode;
+		// streaming back in right after an eviction has to see the edits, not race their store
+		pending->job = JobSystem::submit([voxels, chunkPosition, cache, key, noiseOffset, mode]()
+		{
+			PROFILE_SCOPE("GenerateChunk");
+			constexpr uint32_t Width = TerrainChunk::Width >> InitialLOD;
+			constexpr uint32_t Height = TerrainChunk::Height >> InitialLOD;
+			Int3 dimensions = Int3(Width, Height, Width);
+
+			voxels->resize((size_t)Width * Height * Width);
+			if (cache && cache->load(key, voxels->data(), dimensions))
+				return;
 
-		m_ChunkSSBO = ShaderStorageBuffer::create<ChunkInstanceData>(nullptr, 128);
+			generate_terrain_cpu(mode, voxels->data(), dimensions, chunkPosition + noiseOffset, InitialLOD);
+			if (cache)
+				cache->store(key, voxels->data(), dimensions);
+		}, { get_chunk_store(chunk_index) });
+		m_ChunkStores[chunk_index] = pending->job; // it may store too
 
-		m_ShadowMap = Texture3D::create(ShadowMapWidth, ShadowMapHeight, ShadowMapWidth, TextureFormat::R8UI, ShadowMapNumMips);
+		JobHandle handle = pending->job;
+		m_PendingChunks.push_back(std::move(pending));
+		return handle;
 	}
 
-	void TerrainGenerator::dispatch_terrain_lod_gen_compute(TerrainChunk& chunk, uint32_t lod)
+	bool TerrainGenerator::is_chunk_pending(Int2 chunk_index) const
 	{
-		if ((chunk.generated_lods & (1 << lod)) != 0)
-			return;
+		for (const auto& pending : m_PendingChunks)
+		{
+			if (pending->index == chunk_index)
+				return true;
+		}
 
-		auto& texture = chunk.mesh.m_Texture;
-		texture->bind_as_image(0, TextureAccessMode::Write, lod);
+		return false;
+	}
 
-		uint32_t mipWidth = TerrainChunk::Width / glm::exp2(lod);
-		uint32_t mipHeight = TerrainChunk::Height / glm::exp2(lod);
-		m_ChunkGenerationShader->set("u_ChunkDimensions", Int3(mipWidth, mipHeight, mipWidth));
-		m_ChunkGenerationShader->set("u_ChunkPositionWorld", chunk.position);
-		m_ChunkGenerationShader->set("u_MipLevel", lod);
+	void TerrainGenerator::finalise_pending_chunks(bool wait)
+	{
+		uint32_t finalised = 0;
+		for (size_t i = 0; i < m_PendingChunks.size();)
+		{
+			PendingChunk& pending = *m_PendingChunks[i];
+			if (wait)
+				pending.job.wait();
 
-		// dispatch
-		constexpr uint32_t LocalSizeInShader = 4;
-		m_ChunkGenerationShader->dispatch(mipWidth / LocalSizeInShader, mipHeight / LocalSizeInShader, mipWidth / LocalSizeInShader);
-		Graphics::memory_barrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+			if (!pending.job.is_done())
+			{
+				i++;
+				continue;
+			}
 
-		chunk.generated_lods |= 1 << lod;
+			// spread uploads over frames, at least one chunk always goes through
+			if (!wait && finalised > 0 && pending.voxels->size() > StagingRing::get_frame_budget_remaining())
+				break;
+			finalised++;
+
+			TerrainChunk chunk = create_chunk(pending.index);
+			chunk.mesh.m_Texture->set_data(pending.voxels->data(), 0, 0, 0, pending.lod);
+			chunk.voxels[pending.lod] = std::move(pending.voxels);
+			chunk.generated_lods |= 1 << pending.lod;
+			finalise_chunk(std::move(chunk));
+
+			m_PendingChunks.erase(m_PendingChunks.begin() + i);
+		}
 	}
 
-	TerrainChunk& TerrainGenerator::generate_chunk_lod(Int2 chunk_index, uint32_t lod)
+	void TerrainGenerator::wait_for_pending_chunks()
 	{
-		ASSERT(m_ChunkTable.count(chunk_index));
+		finalise_pending_chunks(true);
+	}
 
-		TerrainChunk& chunk = m_ChunkTable[chunk_index];
-		dispatch_terrain_lod_gen_compute(chunk, lod);
+	void TerrainGenerator::update()
+	{
+		finalise_pending_chunks(false);
+		process_lod_queue();
+		poll_terrain_readbacks();
+		flush_voxel_edits();
+		poll_voxel_query_updates();
+	}
 
-		return chunk;
+	void TerrainGenerator::request_lod(const TerrainChunk& chunk, uint32_t lod, uint32_t priority)
+	{
+		for (LODRequest& request : m_LODQueue)
+		{
+			if (request.index == chunk.index && request.lod == lod)
+			{
+				request.priority = priority;
+				return;
+			}
+		}
+
+		m_LODQueue.push_back({ chunk.index, lod, priority });
 	}
 
-	TerrainChunk& TerrainGenerator::generate_chunk(Int2 chunk_index)
+	void TerrainGenerator::poll_lod_timings()
 	{
-		// Generate chunk
-		TerrainChunk chunk{};
-		chunk.index = chunk_index;
-		chunk.mesh.m_Texture = Texture3D::create(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width, TextureFormat::R8UI, 3);
-		chunk.mesh.m_MaterialIndex = 1;
+		constexpr float Smoothing = 0.25f;
+
+		for (size_t i = 0; i < m_LODTimings.size();)
+		{
+			LODTiming& timing = m_LODTimings[i];
+			if (!timing.query->is_available())
+			{
+				i++;
+				continue;
+			}
 
-		// world pos
-		Float3 worldPosition = Float3(chunk.index.x, 0.0f, chunk.index.y) * (float)TerrainChunk::Width;
-		worldPosition *= VoxelScaleMeters;
-		chunk.position = worldPosition;
+			float& estimate = m_LODCostGPU[timing.lod];
+			estimate = glm::mix(estimate, timing.query->get_elapsed_ms(), Smoothing);
+
+			m_FreeTimerQueries.push_back(std::move(timing.query));
+			m_LODTimings.erase(m_LODTimings.begin() + i);
+		}
+	}
 
-		dispatch_terrain_lod_gen_compute(chunk, 2);
+	void TerrainGenerator::process_lod_queue()
+	{
+		poll_lod_timings();
 
-		chunk.bindless_texture = chunk.mesh.m_Texture->get_bindless_texture();
-		chunk.bindless_texture.activate();
+		// cancel anything that's done already, evicted, or that no region of the chunk wants anymore
+		std::erase_if(m_LODQueue, [this](const LODRequest& request)
+		{
+			auto it = m_ChunkTable.find(request.index);
+			if (it == m_ChunkTable.end())
+				return true;
+
+			const TerrainChunk& chunk = it->second;
+			if ((chunk.generated_lods & (1 << request.lod)) != 0 || request.lod < chunk.wanted_lod)
+				return true;
+
+			return std::find(std::begin(chunk.region_lods), std::end(chunk.region_lods), request.lod) == std::end(chunk.region_lods);
+		});
+
+		if (m_LODQueue.empty())
+			return;
+
+		std::sort(m_LODQueue.begin(), m_LODQueue.end(), [](const LODRequest& a, const LODRequest& b)
+		{
+			return a.priority != b.priority ? a.priority < b.priority : a.lod > b.lod;
+		});
+
+		constexpr float Smoothing = 0.25f;
+
+		float spentMS = 0.0f;
+		size_t processed = 0;
+		for (const LODRequest& request : m_LODQueue)
+		{
+			// always make some progress, even if a single request is over budget
+			float estimate = get_lod_cost_estimate_ms(request.lod);
+			if (processed > 0 && spentMS + estimate > m_LODBudgetMS)
+				break;
+
+			owning_ptr<TimerQuery> query;
+			if (!m_FreeTimerQueries.empty())
+			{
+				query = std::move(m_FreeTimerQueries.back());
+				m_FreeTimerQueries.pop_back();
+			}
+			else
+			{
+				query = TimerQuery::create();
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			query->begin();
+			generate_terrain_lod(m_ChunkTable[request.index], request.lod);
+			query->end();
+			std::chrono::duration<float, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - start;
+
+			m_LODCostCPU[request.lod] = glm::mix(m_LODCostCPU[request.lod], cpuTime.count(), Smoothing);
+			m_LODTimings.push_back({ std::move(query), request.lod });
+			on_chunk_set_changed(request.index);
+
+			spentMS += estimate;
+			processed++;
+		}
+
+		m_LODQueue.erase(m_LODQueue.begin(), m_LODQueue.begin() + processed);
+	}
+
+	void TerrainGenerator::update_streaming(Float3 camera_position, float delta_time)
+	{
+		PROFILE_SCOPE("UpdateStreaming");
+		m_StreamingFrame++;
+		std::erase_if(m_ChunkStores, [](const auto& store) { return store.second.is_done(); });
+		finalise_pending_chunks(false);
+		process_lod_queue();
+		poll_terrain_readbacks();
+		flush_voxel_edits();
+		poll_voxel_query_updates();
+
+		const TerrainStreamingSettings& settings = m_StreamingSettings;
+
+		// smoothed so a single jittery frame doesn't prefetch half the world
+		if (delta_time > 0.0f)
+		{
+			Float3 velocity = (camera_position - m_LastCameraPosition) / delta_time;
+			m_CameraVelocity = glm::mix(m_CameraVelocity, velocity, glm::min(delta_time * 4.0f, 1.0f));
+		}
+		m_LastCameraPosition = camera_position;
+
+		Int2 center = world_to_chunk_index(camera_position);
+		Int2 ahead = world_to_chunk_index(camera_position + m_CameraVelocity * settings.prefetch_seconds);
+
+		// wanted chunks, nearest to the camera first
+		struct StreamRequest
+		{
+			Int2 index;
+			int distance;
+		};
+		std::vector<StreamRequest> requests;
+
+		int radius = (int)settings.radius;
+		auto gather = [&](Int2 around)
+		{
+			for (int y = -radius; y <= radius; y++)
+			for (int x = -radius; x <= radius; x++)
+			{
+				if (x * x + y * y > radius * radius)
+					continue;
+
+				Int2 index = around + Int2(x, y);
+				Int2 d = index - center;
+				requests.push_back({ index, d.x * d.x + d.y * d.y });
+			}
+		};
+		gather(center);
+		if (ahead != center)
+			gather(ahead);
+
+		std::sort(requests.begin(), requests.end(), [](const StreamRequest& a, const StreamRequest& b)
+		{
+			return a.distance < b.distance;
+		});
+
+		for (const StreamRequest& request : requests)
+		{
+			auto it = m_ChunkTable.find(request.index);
+			if (it != m_ChunkTable.end())
+			{
+				it->second.last_used_frame = m_StreamingFrame;
+				continue;
+			}
+
+			if (m_PendingChunks.size() < settings.max_in_flight && !is_chunk_pending(request.index))
+				generate_chunk_async(request.index);
+		}
+
+		// LRU eviction, anything touched this frame is still wanted
+		if (m_ChunkTable.size() > settings.max_loaded_chunks)
+		{
+			std::vector<TerrainChunk*> candidates;
+			for (auto& [index, chunk] : m_ChunkTable)
+			{
+				if (chunk.last_used_frame != m_StreamingFrame)
+					candidates.push_back(&chunk);
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [center](TerrainChunk* a, TerrainChunk* b)
+			{
+				if (a->last_used_frame != b->last_used_frame)
+					return a->last_used_frame < b->last_used_frame;
+
+				Int2 dA = a->index - center, dB = b->index - center;
+				return dA.x * dA.x + dA.y * dA.y > dB.x * dB.x + dB.y * dB.y;
+			});
+
+			size_t excess = m_ChunkTable.size() - settings.max_loaded_chunks;
+			std::vector<Int2> evicted;
+			for (size_t i = 0; i < glm::min(excess, candidates.size()); i++)
+				evicted.push_back(candidates[i]->index);
+
+			for (Int2 index : evicted)
+				evict_chunk(index);
+		}
 
-		return m_ChunkTable[chunk.index] = std::move(chunk);
+		if (center != m_StreamingOrigin)
+		{
+			m_StreamingOrigin = center;
+			m_InstancesDirty = true;
+			m_ShadowMapDirty = true;
+		}
+
+		if (m_InstancesDirty || m_LODViewDirty)
+			resort_chunks(center);
+		if (m_ShadowMapDirty)
+			generate_shadowmap(center);
 	}
 
 	static uint32_t determine_lod_from_chunk_indices(Int2 chunk_index, Int2 world_origin)
@@ -112,61 +1292,228 @@ namespace Engine {
 		return 2;
 	}
 
-	void TerrainGenerator::fill_instance_data(struct ChunkInstanceData* data, TerrainChunk& from, Int2 world_origin)
+	void TerrainGenerator::set_lod_view(const Camera& camera, Float3 camera_position, float viewport_height)
+	{
+		LODView view;
+		view.position = camera_position;
+		view.perspective = camera.get_projection_type() == ProjectionType::Perspective;
+		view.pixels_per_meter_at_1m = camera.get_pixels_per_meter(1.0f, viewport_height);
+		view.valid = true;
+
+		// LODs only need another look once the camera moved a bit
+		constexpr float MoveThreshold = 0.25f;
+		if (!m_LODView.valid || glm::distance(view.position, m_LODView.position) > MoveThreshold
+			|| view.pixels_per_meter_at_1m != m_LODView.pixels_per_meter_at_1m || view.perspective != m_LODView.perspective)
+		{
+			m_LODView = view;
+			m_LODViewDirty = true;
+		}
+	}
+
+	uint32_t TerrainGenerator::select_region_lod(const TerrainChunk& chunk, uint32_t region) const
+	{
+		constexpr float RegionSize = (TerrainChunk::Width / 4) * VoxelScaleMeters;
+		Float3 chunkMin = chunk.position - Float3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width) * (VoxelScaleMeters * 0.5f);
+
+		Float3 regionMin = chunkMin + Float3((region % 4) * RegionSize, 0.0f, (region / 4) * RegionSize);
+		Float3 regionMax = regionMin + Float3(RegionSize, TerrainChunk::Height * VoxelScaleMeters, RegionSize);
+
+		// closest point of the region, errs on the finer side
+		Float3 outside = glm::max(glm::max(regionMin - m_LODView.position, m_LODView.position - regionMax), Float3(0.0f));
+		float distance = glm::max(glm::length(outside), VoxelScaleMeters);
+
+		float pixelsPerMeter = m_LODView.perspective ? m_LODView.pixels_per_meter_at_1m / distance : m_LODView.pixels_per_meter_at_1m;
+		float pixelsPerVoxel = VoxelScaleMeters * pixelsPerMeter;
+
+		// every LOD doubles the voxel size, this is how many doublings reach the target
+		float continuous = glm::log2(m_LODSettings.target_pixels_per_voxel / pixelsPerVoxel);
+		uint32_t target = (uint32_t)glm::clamp(glm::ceil(continuous), 0.0f, (float)(TerrainChunk::LODCount - 1));
+
+		uint32_t current = chunk.region_lods[region];
+		float band = m_LODSettings.hysteresis;
+		if (target > current && continuous < (float)current + band)
+			return current;
+		if (target < current && continuous > (float)current - 1.0f - band)
+			return current;
+
+		return target;
+	}
+
+	void TerrainGenerator::fill_instance_data(ChunkInstanceData* data, TerrainChunk& from, Int2 world_origin)
 	{
-		data->transformation = Transformation(from.position, {}, Float3(from.mesh.m_Texture->get_dimensions()) * 0.1f).get_transform();
+		data->transformation = from.transformation;
 		data->voxel_texture = from.bindless_texture.get_handle();
 		data->index = from.index;
 
-		uint32_t lod = determine_lod_from_chunk_indices(from.index, world_origin);
-		if ((from.generated_lods & lod) == 0)
-			generate_chunk_lod(from.index, lod);
+		uint32_t finest = TerrainChunk::LODCount - 1;
+		for (uint32_t region = 0; region < 16; region++)
+		{
+			uint32_t lod = m_LODView.valid ? select_region_lod(from, region) : determine_lod_from_chunk_indices(from.index, world_origin);
+			from.region_lods[region] = (uint8_t)lod;
+			finest = glm::min(finest, lod);
+		}
+		from.wanted_lod = (uint8_t)finest;
+
+		Int2 d = from.index - world_origin;
+		uint32_t priority = (uint32_t)(d.x * d.x + d.y * d.y);
+
+		// closest generated LOD to what each region wants, coarser first
+		auto resolve = [&from](uint32_t lod)
+		{
+			if (from.generated_lods & (1 << lod))
+				return lod;
+
+			for (uint32_t coarser = lod + 1; coarser < TerrainChunk::LODCount; coarser++)
+			{
+				if (from.generated_lods & (1 << coarser))
+					return coarser;
+			}
+			for (int32_t finer = (int32_t)lod - 1; finer >= 0; finer--)
+			{
+				if (from.generated_lods & (1 << finer))
+					return (uint32_t)finer;
+			}
+			return lod;
+		};
+
+		uint32_t requested = 0; // LODs already queued for this chunk
+		data->lod = TerrainChunk::LODCount - 1;
+		data->region_lods = 0;
+		for (uint32_t region = 0; region < 16; region++)
+		{
+			uint32_t lod = from.region_lods[region];
+			if ((from.generated_lods & (1 << lod)) == 0 && (requested & (1 << lod)) == 0)
+			{
+				request_lod(from, lod, priority);
+				requested |= 1 << lod;
+			}
+
+			uint32_t available = resolve(lod);
+			data->region_lods |= available << (region * 2);
+			data->lod = glm::min(data->lod, available);
+		}
+	}
 
-		data->lod = lod;
+	static bool instance_data_equal(const ChunkInstanceData& a, const ChunkInstanceData& b)
+	{
+		// not memcmp, padding is undefined
+		return a.voxel_texture == b.voxel_texture && a.index == b.index && a.lod == b.lod && a.region_lods == b.region_lods
+			&& a.transformation == b.transformation;
 	}
 
-	void TerrainGenerator::resort_chunks(Int2 origin)
+	// stable LSD radix sort on 8 bit digits, only as many passes as the largest key needs
+	// the scratch vectors are swapped in and out, the sorted result always ends up in chunks & keys
+	static void radix_sort_chunks(std::vector<TerrainChunk*>& chunks, std::vector<uint32_t>& keys, std::vector<TerrainChunk*>& chunk_scratch, std::vector<uint32_t>& key_scratch)
 	{
-		m_SortedChunks.clear();
-		m_SortedChunks.reserve(m_ChunkTable.size());
+		chunk_scratch.resize(chunks.size());
+		key_scratch.resize(keys.size());
 
-		static ChunkInstanceData instance_data[128]{};
+		uint32_t maxKey = 0;
+		for (uint32_t key : keys)
+			maxKey = glm::max(maxKey, key);
 
-		for (auto& pair : m_ChunkTable)
+		for (uint32_t shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += 8)
 		{
-			m_SortedChunks.push_back(&pair.second);
+			uint32_t offsets[256]{};
+			for (uint32_t key : keys)
+				offsets[(key >> shift) & 0xFF]++;
+
+			uint32_t total = 0;
+			for (uint32_t& offset : offsets)
+			{
+				uint32_t count = offset;
+				offset = total;
+				total += count;
+			}
+
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				uint32_t destination = offsets[(keys[i] >> shift) & 0xFF]++;
+				key_scratch[destination] = keys[i];
+				chunk_scratch[destination] = chunks[i];
+			}
+
+			keys.swap(key_scratch);
+			chunks.swap(chunk_scratch);
 		}
+	}
+
+	void TerrainGenerator::resort_chunks(Int2 origin)
+	{
+		PROFILE_SCOPE("ResortChunks");
+		// region LODs only move with the view (m_LODViewDirty) or when a LOD finishes generating (on_chunk_set_changed),
+		// anything else can't change an instance
+		bool resort = m_InstancesDirty || origin != m_SortedOrigin;
+		if (!resort && !m_LODViewDirty)
+			return;
 
-		std::sort(m_SortedChunks.begin(), m_SortedChunks.end(), [origin](TerrainChunk* a, TerrainChunk* b)
+		if (resort)
 		{
-			Int2 indexA = a->index, indexB = b->index;
+			// sorting last frame's order keeps equal distances where they were, so fewer entries change
+			m_SortKeys.resize(m_SortedChunks.size());
+			for (size_t i = 0; i < m_SortedChunks.size(); i++)
+			{
+				Int2 d = m_SortedChunks[i]->index - origin;
+				m_SortKeys[i] = (uint32_t)(d.x * d.x + d.y * d.y);
+			}
+			radix_sort_chunks(m_SortedChunks, m_SortKeys, m_SortChunkScratch, m_SortKeyScratch);
+		}
 
-			Int2 dA = indexA - origin;
-			Int2 dB = indexB - origin;
-			int len0 = dA.x * dA.x + dA.y * dA.y;
-			int len1 = dB.x * dB.x + dB.y * dB.y;
+		m_SortedOrigin = origin;
+		m_InstancesDirty = false;
+		m_LODViewDirty = false;
 
-			if (len0 != len1)
-				return len0 < len1;
+		size_t count = m_SortedChunks.size();
+		size_t previousCount = m_InstanceData.size();
+		m_InstanceData.resize(count);
+		if (count == 0)
+			return;
 
-			return indexA.x != indexB.x ? indexA.x < indexB.x : indexA.y < indexB.y;
-		});
+		// headless runs the same sort, LOD selection & diff, there's just nothing to upload to
+		auto upload = [this](size_t begin, size_t end)
+		{
+			if (!m_Headless)
+				m_ChunkSSBO->update(m_InstanceData.data() + begin, begin, end - begin);
+		};
+
+		bool uploadAll = false;
+		if (!m_Headless && count > m_ChunkSSBO->get_capacity())
+		{
+			size_t capacity = glm::max(count, m_ChunkSSBO->get_capacity() * 2);
+			m_ChunkSSBO = ShaderStorageBuffer::create<ChunkInstanceData>(nullptr, capacity);
+			uploadAll = true;
+		}
 
-		ChunkInstanceData* chunk_ptr = instance_data;
-		for (TerrainChunk* chunk : m_SortedChunks)
+		// upload only what changed, ranges closer than MergeGap entries go up as one
+		constexpr size_t MergeGap = 8;
+		size_t rangeBegin = 0, rangeEnd = 0; // rangeEnd == 0 -> no open range
+		for (size_t i = 0; i < count; i++)
 		{
-			fill_instance_data(chunk_ptr, *chunk, origin);
-			chunk_ptr++;
+			ChunkInstanceData instance;
+			fill_instance_data(&instance, *m_SortedChunks[i], origin);
+
+			bool changed = uploadAll || i >= previousCount || !instance_data_equal(instance, m_InstanceData[i]);
+			m_InstanceData[i] = instance;
+			if (!changed)
+				continue;
+
+			if (rangeEnd != 0 && i > rangeEnd + MergeGap)
+			{
+				upload(rangeBegin, rangeEnd);
+				rangeEnd = 0;
+			}
+
+			if (rangeEnd == 0)
+				rangeBegin = i;
+			rangeEnd = i + 1;
 		}
 
-		m_ChunkSSBO->update(instance_data);
+		if (rangeEnd != 0)
+			upload(rangeBegin, rangeEnd);
 	}
 
-	void TerrainGenerator::generate_occlusion_mips_for_texture(Texture3D* texture, size_t textureMipCount)
+	void TerrainGenerator::generate_occlusion_mips_for_region(Texture3D* texture, size_t textureMipCount, Int3 base_offset, Int3 base_size)
 	{
-		size_t baseWidth = texture->get_width();
-		size_t baseHeight = texture->get_height();
-
 		m_TextureOcclusionMipGenerationShader->bind();
 		// Generate mips
 		for (size_t mip = 0; mip < textureMipCount - 1; mip++)
@@ -174,79 +1521,328 @@ namespace Engine {
 			texture->bind_as_image(0, TextureAccessMode::Read, mip);
 			texture->bind_as_image(1, TextureAccessMode::Write, mip + 1);
 
-			size_t writeMipWidth = baseWidth / glm::exp2(mip);
-			size_t writeMipHeight = baseHeight / glm::exp2(mip);
+			// covers every coarser brick the region touches
+			Int3 writeOffset = base_offset >> (int)(mip + 1);
+			Int3 writeSize = ((base_offset + base_size - 1) >> (int)(mip + 1)) + 1 - writeOffset;
+			m_TextureOcclusionMipGenerationShader->set("u_WriteOffset", writeOffset);
+			m_TextureOcclusionMipGenerationShader->set("u_WriteSize", writeSize);
 
-			constexpr size_t LocalSizeInShader = 4;
-			size_t dispatch_x = writeMipWidth / LocalSizeInShader;
-			size_t dispatch_y = writeMipHeight / LocalSizeInShader;
-			m_TextureOcclusionMipGenerationShader->dispatch(dispatch_x, dispatch_y, dispatch_x);
+			m_TextureOcclusionMipGenerationShader->dispatch_threads(writeSize.x, writeSize.y, writeSize.z);
 
 			Graphics::memory_barrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 		}
 	}
 
-	void TerrainGenerator::generate_shadowmap(Int2 center_chunk)
+	Int2 TerrainGenerator::get_occlusion_slot(Int2 chunk_index, int32_t grid)
+	{
+		return Int2(((chunk_index.x % grid) + grid) % grid, ((chunk_index.y % grid) + grid) % grid);
+	}
+
+	Float3 TerrainGenerator::get_occlusion_cascade_min(uint32_t cascade) const
+	{
+		const OcclusionCascade& c = m_OcclusionCascades[cascade];
+		Int2 minChunk = m_ShadowMapOrigin - Int2(c.grid / 2);
+
+		// chunk positions are centers
+		Float3 halfChunk = Float3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width) * VoxelScaleMeters * 0.5f;
+		return chunk_to_world_position(minChunk) - halfChunk;
+	}
+
+	Int3 TerrainGenerator::get_occlusion_cascade_wrap_offset(uint32_t cascade) const
+	{
+		// slot of the cascade's min corner chunk, everything else follows from there
+		const OcclusionCascade& c = m_OcclusionCascades[cascade];
+		Int2 slot = get_occlusion_slot(m_ShadowMapOrigin - Int2(c.grid / 2), c.grid);
+		return Int3(slot.x * c.chunk_voxels.x, 0, slot.y * c.chunk_voxels.z);
+	}
+
+	void TerrainGenerator::invalidate_shadowmap_chunk(Int2 chunk_index)
 	{
-		// bind them chunks boy (DEBUG DEBUG)
-		Int2 target_chunk_indices[ShadowMapNumChunks * ShadowMapNumChunks] =
+		for (OcclusionCascade& cascade : m_OcclusionCascades)
 		{
-			center_chunk + Int2(-1, -1), center_chunk + Int2(0, -1), center_chunk + Int2(1, -1),
-			center_chunk + Int2(-1,  0), center_chunk, center_chunk + Int2(1, 0),
-			center_chunk + Int2(-1,  1), center_chunk + Int2(0, 1), center_chunk + Int2(1, 1),
-		};
+			Int2 slot = get_occlusion_slot(chunk_index, cascade.grid);
+			OcclusionCascade::Slot& state = cascade.slots[slot.y * cascade.grid + slot.x];
+			if (state.chunk == chunk_index)
+			{
+				state.dirty = true;
+				m_ShadowMapDirty = true;
+			}
+		}
+	}
 
-		uint32_t chunk_count = 0;
-		uint64_t bindless_handles[9]{};
-		for (size_t i = 0; i < std::size(target_chunk_indices); i++)
+	void TerrainGenerator::invalidate_shadowmap()
+	{
+		for (OcclusionCascade& cascade : m_OcclusionCascades)
 		{
-			Int2 index = target_chunk_indices[i];
-			if (!m_ChunkTable.count(index))
-				continue;
+			for (OcclusionCascade::Slot& slot : cascade.slots)
+				slot.dirty = true;
+		}
+		m_ShadowMapDirty = true;
+	}
+
+	void TerrainGenerator::build_occlusion_region_cpu(const OcclusionCascade& cascade, const TerrainChunk* chunk, Int3 brick_offset, Int3 brick_size, OcclusionBrickVolume& volume)
+	{
+		uint32_t mipCount = cascade.texture->get_mip_count();
+		if (!chunk)
+		{
+			// missing chunks are empty
+			volume.mips.clear();
+			volume.brick_dimensions.clear();
 
-			TerrainChunk& chunk = m_ChunkTable[index];
-			uint64_t handle = chunk.bindless_texture.get_handle();
-			bindless_handles[i] = handle;
-			chunk_count++;
+			Int3 bricks = brick_size;
+			for (uint32_t mip = 0; mip < mipCount; mip++)
+			{
+				volume.brick_dimensions.push_back(bricks);
+				volume.mips.emplace_back((size_t)bricks.x * bricks.y * bricks.z, 0);
+				bricks = (bricks + 1) / 2;
+			}
+			return;
 		}
 
-		m_ShadowMap->bind_as_image(0, TextureAccessMode::Write);
-		// TODO: smth like vector with sbo instead of std::init list ?
-		m_ShadowMapBaseMipGenerationShader->set("u_ChunkHandles", std::initializer_list<uint64_t>{
-			bindless_handles[0], bindless_handles[1], bindless_handles[2],
-				bindless_handles[3], bindless_handles[4], bindless_handles[5],
-				bindless_handles[6], bindless_handles[7], bindless_handles[8],
-		});
-		m_ShadowMapBaseMipGenerationShader->set("u_ChunkCount", chunk_count);
+		auto& texture = chunk->mesh.m_Texture;
+		Int3 sourceDimensions = texture->get_mip_dimensions(cascade.source_lod);
+		std::vector<uint8_t> readback;
+		const uint8_t* source = nullptr;
+		if (chunk->voxels[cascade.source_lod])
+			source = chunk->voxels[cascade.source_lod]->data();
+		else
+		{
+			// only validation (stalls everywhere anyway) or a switch to the CPU backend gets here before the async readback landed
+			readback.resize((size_t)sourceDimensions.x * sourceDimensions.y * sourceDimensions.z);
+			texture->get_data(readback.data(), readback.size(), cascade.source_lod);
+			source = readback.data();
+		}
+
+		int32_t sourcePerBrick = (int32_t)(OcclusionBrickSize * cascade.source_stride);
+		Int3 span = brick_size * sourcePerBrick;
+		if (span == sourceDimensions)
+		{
+			volume.build(source, sourceDimensions, cascade.source_stride, mipCount);
+			return;
+		}
+
+		std::vector<uint8_t> region((size_t)span.x * span.y * span.z);
+		copy_voxel_box(source, sourceDimensions, brick_offset * sourcePerBrick, span, region.data());
+		volume.build(region.data(), span, cascade.source_stride, mipCount);
+	}
+
+	void TerrainGenerator::update_occlusion_slot(OcclusionCascade& cascade, Int2 slot, const TerrainChunk* chunk)
+	{
+		update_occlusion_region(cascade, slot, chunk, Int3(0), cascade.chunk_voxels / (int)OcclusionBrickSize);
+	}
+
+	void TerrainGenerator::update_occlusion_region(OcclusionCascade& cascade, Int2 slot, const TerrainChunk* chunk, Int3 brick_offset, Int3 brick_size)
+	{
+		Int3 slotBricks = cascade.chunk_voxels / (int)OcclusionBrickSize;
+		Int3 slotOffset = Int3(slot.x, 0, slot.y) * slotBricks;
+		Int3 regionOffset = slotOffset + brick_offset;
+
+		if (m_Backend == TerrainGenerationBackend::CPU)
+		{
+			OcclusionBrickVolume volume;
+			build_occlusion_region_cpu(cascade, chunk, brick_offset, brick_size, volume);
+
+			for (uint32_t mip = 0; mip < volume.get_mip_count(); mip++)
+				cascade.texture->set_region(volume.mips[mip].data(), regionOffset >> (int)mip, volume.brick_dimensions[mip], mip);
 
-		constexpr size_t LocalSizeInShader = 4;
-		constexpr size_t Width = ShadowMapWidth / LocalSizeInShader;
-		constexpr size_t Height = ShadowMapHeight / LocalSizeInShader;
+			if (chunk && &cascade == &m_OcclusionCascades[0])
+				update_voxel_query(chunk->index, brick_offset, brick_size, std::move(volume));
+			return;
+		}
 
-		m_ShadowMapBaseMipGenerationShader->dispatch(Width, Height, Width);
+		cascade.texture->bind_as_image(0, TextureAccessMode::Write);
+		m_ShadowMapBaseMipGenerationShader->set("u_ChunkHandle", std::initializer_list<uint64_t>{ chunk ? chunk->bindless_texture.get_handle() : 0 });
+		m_ShadowMapBaseMipGenerationShader->set("u_HasChunk", chunk != nullptr);
+		m_ShadowMapBaseMipGenerationShader->set("u_SlotBrickOffset", slotOffset);
+		m_ShadowMapBaseMipGenerationShader->set("u_RegionBrickOffset", brick_offset);
+		m_ShadowMapBaseMipGenerationShader->set("u_RegionBricks", brick_size);
+		m_ShadowMapBaseMipGenerationShader->set("u_ChunkDimensions", cascade.chunk_voxels);
+		m_ShadowMapBaseMipGenerationShader->set("u_SourceMip", cascade.source_lod);
+		m_ShadowMapBaseMipGenerationShader->set("u_SourceStride", cascade.source_stride);
+
+		m_ShadowMapBaseMipGenerationShader->dispatch_threads(brick_size.x, brick_size.y, brick_size.z);
 
 		Graphics::memory_barrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
 
-		// Generate mips
-		generate_occlusion_mips_for_texture(m_ShadowMap.get(), ShadowMapNumMips);
+		// slots (and edited regions) are multiples of the mip alignment, so mips never mix chunks
+		generate_occlusion_mips_for_region(cascade.texture.get(), cascade.texture->get_mip_count(), regionOffset, brick_size);
+
+		if (m_Backend == TerrainGenerationBackend::Validate)
+		{
+			Graphics::memory_barrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+			OcclusionBrickVolume volume;
+			build_occlusion_region_cpu(cascade, chunk, brick_offset, brick_size, volume);
+
+			for (uint32_t mip = 0; mip < volume.get_mip_count(); mip++)
+			{
+				const std::vector<uint64_t>& cpu = volume.mips[mip];
+				std::vector<uint64_t> gpu(cpu.size());
+				cascade.texture->get_region(gpu.data(), gpu.size() * sizeof(uint64_t), regionOffset >> (int)mip, volume.brick_dimensions[mip], mip);
+
+				size_t mismatches = 0;
+				for (size_t i = 0; i < cpu.size(); i++)
+					mismatches += cpu[i] != gpu[i];
+
+				LOG("occlusion validation: {:.1f}m cascade slot [{}, {}] mip {} - {} / {} bricks differ",
+					cascade.voxel_scale, slot.x, slot.y, mip, mismatches, cpu.size());
+			}
+		}
+
+		if (chunk && &cascade == &m_OcclusionCascades[0])
+			queue_voxel_query_update(cascade, *chunk, brick_offset, brick_size);
+	}
+
+	void TerrainGenerator::queue_voxel_query_update(const OcclusionCascade& cascade, const TerrainChunk& chunk, Int3 brick_offset, Int3 brick_size)
+	{
+		auto it = std::find_if(m_VoxelQueryUpdates.begin(), m_VoxelQueryUpdates.end(), [&](const VoxelQueryUpdate& update) { return update.chunk == chunk.index; });
+		if (brick_size * (int)OcclusionBrickSize == Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width))
+		{
+			// a job still running for older contents finishes into nothing
+			if (it != m_VoxelQueryUpdates.end())
+				*it = { chunk.index };
+			else
+				m_VoxelQueryUpdates.push_back({ chunk.index });
+			return;
+		}
+
+		// edited regions are small enough to build right away, a whole chunk update still on its way picks them up anyway
+		if (it != m_VoxelQueryUpdates.end())
+			return;
+
+		OcclusionBrickVolume volume;
+		build_occlusion_region_cpu(cascade, &chunk, brick_offset, brick_size, volume);
+		update_voxel_query(chunk.index, brick_offset, brick_size, std::move(volume));
+	}
+
+	void TerrainGenerator::poll_voxel_query_updates()
+	{
+		const OcclusionCascade& cascade = m_OcclusionCascades[0];
+		for (size_t i = 0; i < m_VoxelQueryUpdates.size();)
+		{
+			VoxelQueryUpdate& update = m_VoxelQueryUpdates[i];
+
+			// whatever replaced the chunk in its slot takes care of the query
+			Int2 slot = get_occlusion_slot(update.chunk, cascade.grid);
+			const OcclusionCascade::Slot& state = cascade.slots[slot.y * cascade.grid + slot.x];
+			auto it = m_ChunkTable.find(update.chunk);
+			if (it == m_ChunkTable.end() || state.chunk != update.chunk)
+			{
+				m_VoxelQueryUpdates.erase(m_VoxelQueryUpdates.begin() + i);
+				continue;
+			}
+
+			// GPU generated copies arrive a few frames after the slot was built
+			const auto& voxels = it->second.voxels[cascade.source_lod];
+			if (!update.source)
+			{
+				if (voxels)
+				{
+					update.source = voxels;
+					Int3 dimensions = it->second.mesh.m_Texture->get_mip_dimensions(cascade.source_lod);
+					uint32_t stride = cascade.source_stride, mipCount = cascade.texture->get_mip_count();
+					update.volume = JobSystem::async([source = update.source, dimensions, stride, mipCount]()
+					{
+						PROFILE_SCOPE("BuildVoxelQueryChunk");
+						OcclusionBrickVolume volume;
+						volume.build(source->data(), dimensions, stride, mipCount);
+						return volume;
+					});
+				}
+
+				i++;
+				continue;
+			}
+
+			if (!update.volume.is_ready())
+			{
+				i++;
+				continue;
+			}
+
+			// edits write to a fresh copy while the job holds the old one, so those go again
+			if (update.source != voxels)
+			{
+				update = { update.chunk };
+				i++;
+				continue;
+			}
+
+			m_VoxelQuery.set_chunk(update.chunk, std::move(update.volume.get()));
+			m_VoxelQueryUpdates.erase(m_VoxelQueryUpdates.begin() + i);
+		}
 	}
 
-	void TerrainGenerator::render_terrain(const Matrix4& viewProj, Float3 camera)
+	void TerrainGenerator::update_voxel_query(Int2 chunk_index, Int3 brick_offset, Int3 brick_size, OcclusionBrickVolume&& volume)
+	{
+		if (brick_size * (int)OcclusionBrickSize == Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width))
+			m_VoxelQuery.set_chunk(chunk_index, std::move(volume));
+		else
+			m_VoxelQuery.update_chunk_region(chunk_index, brick_offset, volume);
+	}
+
+	void TerrainGenerator::generate_shadowmap(Int2 center_chunk)
+	{
+		PROFILE_GPU_SCOPE("GenerateShadowmap");
+		m_ShadowMapOrigin = center_chunk;
+		m_ShadowMapDirty = false;
+
+		// toroidal: chunks keep their slot while the origin moves, so only newly exposed or changed chunks are rebuilt
+		uint32_t updated = 0;
+		for (OcclusionCascade& cascade : m_OcclusionCascades)
+		{
+			Int2 minChunk = center_chunk - Int2(cascade.grid / 2);
+			for (int32_t z = 0; z < cascade.grid; z++)
+			for (int32_t x = 0; x < cascade.grid; x++)
+			{
+				Int2 index = minChunk + Int2(x, z);
+				Int2 slot = get_occlusion_slot(index, cascade.grid);
+				OcclusionCascade::Slot& state = cascade.slots[slot.y * cascade.grid + slot.x];
+
+				// chunks without the source LOD are treated as empty
+				auto it = m_ChunkTable.find(index);
+				bool hasSource = it != m_ChunkTable.end() && (it->second.generated_lods & (1 << cascade.source_lod));
+				const TerrainChunk* chunk = hasSource ? &it->second : nullptr;
+				uint8_t lods = chunk ? chunk->generated_lods : 0;
+
+				// LOD0 arriving rebuilds the coarser LODs from it, so any change in generated LODs means new contents
+				bool unchanged = state.generated_lods == lods && (lods == 0 || state.chunk == index);
+				if (!state.dirty && unchanged)
+					continue;
+
+				// the voxel query mirrors the finest cascade, whatever left the slot leaves the query too
+				if (&cascade == &m_OcclusionCascades[0])
+				{
+					if (state.generated_lods && state.chunk != index)
+						m_VoxelQuery.remove_chunk(state.chunk);
+					if (!chunk)
+						m_VoxelQuery.remove_chunk(index);
+				}
+
+				update_occlusion_slot(cascade, slot, chunk);
+				state = { index, lods, false };
+				updated++;
+			}
+		}
+
+		m_ShadowMapSlotsUpdated += updated;
+	}
+
+	void TerrainGenerator::render_terrain()
 	{
 		m_TerrainShader->bind();
 		m_ChunkSSBO->bind(0);
-		m_ShadowMap->bind(0);
+		m_OcclusionCascades[0].texture->bind(OcclusionCascade::TextureUnits[0]);
+		m_OcclusionCascades[1].texture->bind(OcclusionCascade::TextureUnits[1]);
 
 		m_TerrainShader->set("u_MaterialIndex", 1);
 		//m_TerrainShader->set("u_MipLevel", 0);
 		m_TerrainShader->set("u_ChunkDimensions", Int3(TerrainChunk::Width, TerrainChunk::Height, TerrainChunk::Width));
-
-		m_TerrainShader->set("u_CameraPosition", camera);
-		m_TerrainShader->set("u_ViewProjection", viewProj);
+		m_TerrainShader->set("u_OcclusionOriginChunk", m_ShadowMapOrigin);
 
 		VoxelMesh::bind_palette(3);
 
-		Graphics::draw_cubes_instanced(m_SortedChunks.size());
+		Graphics::draw_cubes_instanced(m_InstanceData.size());
 	}
 
 }
\ No newline at end of file
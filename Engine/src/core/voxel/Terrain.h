@@ -1,56 +1,439 @@
 #pragma once
 
+#include <variant>
+
 #include "rendering/Texture.h"
 #include "rendering/Buffer.h"
+#include "rendering/Shader.h"
+#include "rendering/TimerQuery.h"
+#include "rendering/ReadbackBuffer.h"
+
+#include "threading/JobSystem.h"
+
+#include "ChunkCache.h"
+#include "VoxelMesh.h"
+#include "VoxelMips.h"
+#include "OcclusionBricks.h"
+#include "VoxelQuery.h"
 
 namespace Engine {
 	
 	class Shader;
+	class Camera;
 	class ComputeShader;
+	struct TerrainChunkEdits;
 
 	struct TerrainChunk
 	{
 		static constexpr size_t Width = 512, Height = 128;
+		static constexpr uint32_t LODCount = 3;
 
 		VoxelMesh mesh;
 		BindlessTexture3D bindless_texture;
 		Int2 index{};
 		Float3 position{};
+		Matrix4 transformation{}; // instance transform, cached
 
 		uint8_t generated_lods = 0;
+		uint8_t wanted_lod = LODCount - 1; // finest LOD the selection asked for last
+		uint8_t region_lods[16] = { 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }; // 4x4 xz regions, hysteresis state
+		uint64_t last_used_frame = 0; // streaming LRU
+
+		// CPU copy of every generated LOD (from the generator, the cache or an async readback), null while it's on its way
+		// mips, occlusion and edits work off these instead of reading the texture back
+		std::shared_ptr<std::vector<uint8_t>> voxels[LODCount];
+		owning_ptr<TerrainChunkEdits> edits; // only exists once the chunk has been edited
+	};
+
+	// the query can't include this header, so it keeps its own copy of the dimensions
+	static_assert(VoxelQuery::ChunkWidth == TerrainChunk::Width && VoxelQuery::ChunkHeight == TerrainChunk::Height);
+
+	// dirty state of an edited chunk, set_voxels writes into TerrainChunk::voxels and flush_voxel_edits uploads the dirty bricks
+	struct TerrainChunkEdits
+	{
+		static constexpr int32_t BrickSize = 4; // in LOD0 voxels, also the dirty granularity
+
+		std::vector<uint64_t> dirty_bricks; // a bit per LOD0 brick that hasn't been uploaded yet
+		Int3 dirty_min = Int3(INT32_MAX), dirty_max = Int3(INT32_MIN); // brick bounds of the dirty bits, max exclusive
+	};
+
+	// world space shapes for set_voxels
+	struct VoxelBox
+	{
+		Float3 min{}, max{};
+	};
+
+	struct VoxelSphere
+	{
+		Float3 center{};
+		float radius = 0.0f;
+	};
+
+	struct VoxelEditStats
+	{
+		uint64_t voxels_changed = 0;
+		uint64_t bricks_uploaded = 0;           // LOD0 bricks, coarser LODs follow them
+		uint64_t bytes_uploaded = 0;            // all LODs
+		uint64_t occlusion_bricks_rebuilt = 0;  // all cascades, base mip
+		float last_flush_ms = 0.0f;             // CPU time of the last flush that had work
+	};
+
+	// per-instance data of the terrain draw, matches ChunkInstance in TerrainShader.glsl (std430)
+	struct alignas(16) ChunkInstanceData
+	{
+		Matrix4 transformation;
+		uint64_t voxel_texture;
+		Int2 index;
+		uint32_t lod;         // finest LOD in use
+		uint32_t region_lods; // 2 bits per 4x4 xz region, x fastest
+	};
+
+	struct TerrainLODSettings
+	{
+		float target_pixels_per_voxel = 2.0f; // coarsen once voxels would get smaller than this on screen
+		float hysteresis = 0.25f;             // in LODs, how far past a boundary before switching
+	};
+
+	struct TerrainStreamingSettings
+	{
+		uint32_t radius = 2;            // in chunks, kept loaded around the camera
+		float prefetch_seconds = 1.5f;  // also load around where the camera will be in this many seconds
+		uint32_t max_loaded_chunks = 40; // least recently used chunks are evicted above this (~38MB each, twice that with the CPU copies)
+		uint32_t max_in_flight = 16;    // async generations at once
+	};
+
+	// also picks who packs the occlusion cascades (OcclusionBricks.h on the CPU)
+	enum class TerrainGenerationBackend
+	{
+		GPU,      // Compute_GenerateTerrain.glsl
+		CPU,      // generate_terrain_voxels_cpu, uploaded afterwards
+		Validate, // runs both and diffs the results per chunk (keeps the GPU volume), the SIMD occlusion encoder is checked on switching to it
+	};
+
+	enum class TerrainGenerationMode : uint32_t
+	{
+		Volume,    // fBm per voxel (3D noise thresholded by height), the original look
+		Heightmap, // fBm once per (x, z) column, columns filled up to the height (~60x cheaper, no overhangs)
+	};
+
+	// 4x4x4 bit brick occupancy (RG32UI, see OcclusionBricks.h) around the camera, nested cascades of growing voxel size
+	// every cascade has the same xz resolution, so each covers 4x the extent of the previous one at the same or lower memory
+	struct OcclusionCascade
+	{
+		static constexpr uint32_t Count = 3;
+		static constexpr uint32_t TextureUnits[Count] = { 0, 7, 8 };
+
+		struct Slot
+		{
+			Int2 chunk{};
+			uint8_t generated_lods = 0; // of the chunk when packed, 0 = empty slot
+			bool dirty = true;
+		};
+
+		owning_ptr<Texture3D> texture;
+		float voxel_scale = 0.0f;   // meters
+		uint32_t source_lod = 0;    // chunk LOD it's packed from
+		uint32_t source_stride = 1; // source voxels per cascade voxel along each axis
+		int32_t grid = 0;           // chunks per side
+		Int3 chunk_voxels{};        // one chunk in cascade voxels
+		std::vector<Slot> slots;    // grid x grid, indexed by chunk index mod grid
 	};
 
 	class TerrainGenerator
 	{
+	private:
+		struct HeadlessTag {};
+		TerrainGenerator(HeadlessTag);
 	public:
 		TerrainGenerator();
+		~TerrainGenerator();
+
+		// no shaders, textures or buffers, for running the CPU side (chunk bookkeeping, LOD selection, resort_chunks) without a GL context
+		// chunks only come from add_placeholder_chunk, nothing gets generated or uploaded
+		static owning_ptr<TerrainGenerator> create_headless();
+		// headless only, a chunk that claims generated_lods without any voxels behind it
+		void add_placeholder_chunk(Int2 chunk_index, uint8_t generated_lods);
+		bool is_headless() const { return m_Headless; }
+
+		void set_generation_backend(TerrainGenerationBackend backend);
+		TerrainGenerationBackend get_generation_backend() const { return m_Backend; }
+
+		// only affects chunks generated afterwards, cached chunks are keyed by mode
+		void set_generation_mode(TerrainGenerationMode mode) { m_Mode = mode; }
+		TerrainGenerationMode get_generation_mode() const { return m_Mode; }
+
+		// coarser LODs are downsampled from LOD0 once it exists (noise generated before that)
+		void set_mip_reduction(VoxelMipReduction rule) { m_MipReduction = rule; }
+		VoxelMipReduction get_mip_reduction() const { return m_MipReduction; }
+
+		// rebuilds every LOD coarser than from_lod out of it, call after modifying a LOD
+		void rebuild_chunk_mips(Int2 chunk_index, uint32_t from_lod = 0);
+
+		// material 0 carves, only loaded chunks are affected (LOD0 gets generated first if missing)
+		// changes are uploaded by the next flush_voxel_edits, returns the number of voxels changed
+		// chunks still waiting for their CPU copies get the edit once those arrive, it isn't counted here
+		uint32_t set_voxels(const VoxelBox& box, uint8_t material);
+		uint32_t set_voxels(const VoxelSphere& sphere, uint8_t material);
+
+		// uploads dirty bricks of every LOD and rebuilds only the occlusion they cover, update() & update_streaming() call it
+		void flush_voxel_edits();
+		const VoxelEditStats& get_voxel_edit_stats() const { return m_EditStats; }
+
+		// CPU copy of the finest occlusion cascade, kept in sync with streaming & edits
+		const VoxelQuery& get_voxel_query() const { return m_VoxelQuery; }
+
+		// times GPU & CPU generation of one chunk LOD in both modes on a scratch texture and logs the results
+		// stalls the GPU, debug only
+		void benchmark_generation(uint32_t lod);
+
+		// counts texel fetches of AO rays through a CPU generated LOD0 chunk in the old 2x2x2 and the 4x4x4 brick occlusion format
+		void benchmark_occlusion_formats();
+
+		// seed 0 is the original terrain, others offset the noise domain
+		// only affects chunks generated afterwards
+		void set_seed(uint32_t seed);
+		uint32_t get_seed() const { return m_Seed; }
+
+		// generated LODs are looked up in/written to the cache, nullptr disables it
+		void set_chunk_cache(owning_ptr<ChunkCache> cache) { m_ChunkCache = std::move(cache); }
+		ChunkCache* get_chunk_cache() const { return m_ChunkCache.get(); }
 
 		// generates lowest LOD
 		TerrainChunk& generate_chunk(Int2 chunk_index);
 		TerrainChunk& generate_chunk_lod(Int2 chunk_index, uint32_t lod);
 
+		// generates the lowest LOD on the job system (always on the CPU), returns immediately
+		// the chunk shows up in m_ChunkTable once update() finalises it on the GL thread
+		JobHandle generate_chunk_async(Int2 chunk_index);
+		bool is_chunk_pending(Int2 chunk_index) const;
+		size_t get_pending_chunk_count() const { return m_PendingChunks.size(); }
+		void wait_for_pending_chunks();
+
+		// call once per frame on the GL thread
+		void update();
+
+		// finer LODs are queued by distance and generated under a per-frame GPU time budget
+		// chunks render the closest generated LOD until theirs is ready
+		void set_lod_budget_ms(float budget) { m_LODBudgetMS = budget; }
+		float get_lod_budget_ms() const { return m_LODBudgetMS; }
+		size_t get_queued_lod_count() const { return m_LODQueue.size(); }
+		float get_lod_cost_estimate_ms(uint32_t lod) const { return m_LODCostCPU[lod] + m_LODCostGPU[lod]; }
+
+		// LOD is picked per chunk region from its projected voxel size
+		// without a view the old chunk distance rings are used
+		void set_lod_view(const Camera& camera, Float3 camera_position, float viewport_height);
+		void set_lod_settings(const TerrainLODSettings& settings) { m_LODSettings = settings; m_LODViewDirty = true; }
+		const TerrainLODSettings& get_lod_settings() const { return m_LODSettings; }
+
+		// keeps chunks loaded around the camera, prefetches along its velocity and evicts by LRU
+		// also resorts the instances & regenerates the shadowmap when needed, replaces update()
+		void update_streaming(Float3 camera_position, float delta_time);
+		void set_streaming_settings(const TerrainStreamingSettings& settings) { m_StreamingSettings = settings; }
+		const TerrainStreamingSettings& get_streaming_settings() const { return m_StreamingSettings; }
+
+		void evict_chunk(Int2 chunk_index);
+		size_t get_loaded_chunk_memory() const; // bytes of voxel textures
+
+		Int2 get_shadowmap_origin() const { return m_ShadowMapOrigin; }
+		Texture3D* get_shadowmap() const { return m_OcclusionCascades[0].texture.get(); } // finest cascade
+		uint64_t get_shadowmap_slots_updated() const { return m_ShadowMapSlotsUpdated; } // chunk slots rebuilt so far
+		void invalidate_shadowmap(); // rebuilds every slot on the next generate_shadowmap
+
+		const OcclusionCascade& get_occlusion_cascade(uint32_t cascade) const { return m_OcclusionCascades[cascade]; }
+		Float3 get_occlusion_cascade_min(uint32_t cascade) const;     // world space min corner
+		Int3 get_occlusion_cascade_wrap_offset(uint32_t cascade) const; // toroidal addressing offset, in cascade voxels
+
+		// binds the cascades to OcclusionCascade::TextureUnits and sets u_CascadeMin[] / u_CascadeWrapOffset[], see ComputeAO.glsl
+		template<typename TShader>
+		void bind_occlusion_cascades(TShader& shader) const
+		{
+			static constexpr UniformID CascadeMin[] = { "u_CascadeMin[0]", "u_CascadeMin[1]", "u_CascadeMin[2]" };
+			static constexpr UniformID CascadeWrapOffset[] = { "u_CascadeWrapOffset[0]", "u_CascadeWrapOffset[1]", "u_CascadeWrapOffset[2]" };
+			static_assert(std::size(CascadeMin) == OcclusionCascade::Count);
+
+			for (uint32_t i = 0; i < OcclusionCascade::Count; i++)
+			{
+				m_OcclusionCascades[i].texture->bind(OcclusionCascade::TextureUnits[i]);
+				shader.set(CascadeMin[i], get_occlusion_cascade_min(i));
+				shader.set(CascadeWrapOffset[i], get_occlusion_cascade_wrap_offset(i));
+			}
+		}
+
+		static Int2 world_to_chunk_index(Float3 position);
+		static Float3 chunk_to_world_position(Int2 chunk_index);
+
+		// stable bucket sort of the loaded chunks by distance to origin, uploads only changed instances
+		// only refreshes LODs if the origin is unchanged, no-op if nothing changed since the last call
 		void resort_chunks(Int2 origin);
+		// the occlusion cascades are addressed toroidally, only chunk slots that changed since the last call get rebuilt
 		void generate_shadowmap(Int2 origin);
 
-		void render_terrain(const Matrix4& viewProjection, Float3 camera);
+		void render_terrain(); // camera comes from the RenderPipeline camera block
 	private:
-		void generate_occlusion_mips_for_texture(Texture3D* texture, size_t textureMipCount);
+		struct PendingChunk
+		{
+			Int2 index{};
+			uint32_t lod = 0;
+			std::shared_ptr<std::vector<uint8_t>> voxels = std::make_shared<std::vector<uint8_t>>(); // written by the job
+			JobHandle job;
+		};
+
+		TerrainChunk create_chunk(Int2 chunk_index);
+		TerrainChunk& finalise_chunk(TerrainChunk&& chunk);
+		void on_chunk_set_changed(Int2 chunk_index);
+		void finalise_pending_chunks(bool wait);
+
+		void generate_occlusion_mips_for_region(Texture3D* texture, size_t textureMipCount, Int3 base_offset, Int3 base_size);
+		void update_occlusion_slot(OcclusionCascade& cascade, Int2 slot, const TerrainChunk* chunk);
+		void update_occlusion_region(OcclusionCascade& cascade, Int2 slot, const TerrainChunk* chunk, Int3 brick_offset, Int3 brick_size);
+		void build_occlusion_region_cpu(const OcclusionCascade& cascade, const TerrainChunk* chunk, Int3 brick_offset, Int3 brick_size, OcclusionBrickVolume& volume);
+		void update_voxel_query(Int2 chunk_index, Int3 brick_offset, Int3 brick_size, OcclusionBrickVolume&& volume);
+		// GPU built occlusion reaches the voxel query from the CPU copy, whole chunks are built on the job pool
+		void queue_voxel_query_update(const OcclusionCascade& cascade, const TerrainChunk& chunk, Int3 brick_offset, Int3 brick_size);
+		void poll_voxel_query_updates();
+		void invalidate_shadowmap_chunk(Int2 chunk_index);
+		static Int2 get_occlusion_slot(Int2 chunk_index, int32_t grid);
 		void dispatch_terrain_lod_gen_compute(TerrainChunk& chunk, uint32_t lod);
+		void dispatch_terrain_gen_compute(Texture3D* texture, Float3 chunk_position, uint32_t lod, TerrainGenerationMode mode);
+		void generate_terrain_lod_cpu(TerrainChunk& chunk, uint32_t lod);
+		void validate_terrain_lod(TerrainChunk& chunk, uint32_t lod);
+		void generate_terrain_lod(TerrainChunk& chunk, uint32_t lod);
+		void build_terrain_mips(TerrainChunk& chunk, uint32_t from_lod, bool store_in_cache = false);
+		// replaces the CPU copy, older readbacks of the LOD won't overwrite it anymore
+		void set_chunk_voxels(TerrainChunk& chunk, uint32_t lod, std::shared_ptr<std::vector<uint8_t>> voxels);
+		void dispatch_downsample_compute(Texture3D* texture, uint32_t from_mip);
+		bool load_terrain_lod_from_cache(TerrainChunk& chunk, uint32_t lod);
+
+		template<typename TShape>
+		uint32_t apply_voxel_edit(const TShape& shape, uint8_t material);
+		template<typename TShape>
+		uint32_t apply_chunk_voxel_edit(TerrainChunk& chunk, const TShape& shape, uint8_t material);
+		// null while the CPU copies of the chunk are still on their way
+		TerrainChunkEdits* begin_chunk_edit(TerrainChunk& chunk);
+		void flush_chunk_edits(TerrainChunk& chunk);
+		void store_chunk_edits_in_cache(TerrainChunk& chunk);
+		void store_terrain_lod_in_cache(Int2 chunk_index, uint32_t lod, std::shared_ptr<std::vector<uint8_t>> voxels);
+		// GPU generated LODs come back through a ReadbackBuffer, poll_terrain_readbacks turns them into the CPU copy
+		// (and stores them in the cache) a few frames later
+		void read_back_terrain_lod(TerrainChunk& chunk, uint32_t lod, bool store_in_cache);
+		void poll_terrain_readbacks();
+		// pending readbacks of the LODs in lod_mask won't become CPU copies, the ones not yet storing are dropped with drop_stores
+		void detach_terrain_readbacks(Int2 chunk_index, uint32_t lod_mask, bool drop_stores);
+		// cache writes of one chunk run in submission order, loads of the chunk wait for them
+		JobHandle submit_chunk_store(Int2 chunk_index, JobSystem::JobFunction store);
+		JobHandle get_chunk_store(Int2 chunk_index) const;
+
+		// coarser LODs depend on the mip reduction, LOD0 is shared between them
+		ChunkCacheKey get_cache_key(Int2 chunk_index, uint32_t lod) const { return { m_Seed, chunk_index, lod, (uint32_t)m_Mode, lod > 0 ? (uint32_t)m_MipReduction : 0 }; }
+
+		void fill_instance_data(ChunkInstanceData* data, TerrainChunk& from, Int2 world_origin);
+		uint32_t select_region_lod(const TerrainChunk& chunk, uint32_t region) const;
+
+		struct LODRequest
+		{
+			Int2 index{};
+			uint32_t lod = 0;
+			uint32_t priority = 0; // squared chunk distance, lower goes first
+		};
+
+		struct TerrainReadback
+		{
+			ChunkCacheKey key{};
+			Int3 dimensions{};
+			owning_ptr<ReadbackBuffer> buffer;
+			std::shared_ptr<std::vector<uint8_t>> voxels; // copied out of the mapping by the job
+			JobHandle job; // empty until the readback landed and the copy (& store) was submitted
+			bool store_in_cache = false;
+			bool becomes_copy = true; // false once detached
+		};
 
-		void fill_instance_data(struct ChunkInstanceData* data, TerrainChunk& from, Int2 world_origin);
+		struct LODTiming
+		{
+			owning_ptr<TimerQuery> query;
+			uint32_t lod = 0;
+		};
+
+		void request_lod(const TerrainChunk& chunk, uint32_t lod, uint32_t priority);
+		void process_lod_queue();
+		void poll_lod_timings();
 	public:
 		owning_ptr<Shader> m_TerrainShader;
 		owning_ptr<Shader> m_TerrainShader_DepthPP;
 		owning_ptr<ComputeShader> m_ChunkGenerationShader;
+		owning_ptr<ComputeShader> m_HeightmapGenerationShader;
+		owning_ptr<ComputeShader> m_MipDownsampleShader;
 
 		owning_ptr<ComputeShader> m_ShadowMapBaseMipGenerationShader;
 		owning_ptr<ComputeShader> m_TextureOcclusionMipGenerationShader;
 
 		std::unordered_map<Int2, TerrainChunk> m_ChunkTable;
 		std::vector<TerrainChunk*> m_SortedChunks;
+		std::vector<TerrainChunk*> m_SortChunkScratch; // resort_chunks, kept to not reallocate every frame
+		std::vector<uint32_t> m_SortKeys, m_SortKeyScratch;
+		std::vector<ChunkInstanceData> m_InstanceData;
 		owning_ptr<ShaderStorageBuffer> m_ChunkSSBO;
 
-		owning_ptr<Texture3D> m_ShadowMap;
+		OcclusionCascade m_OcclusionCascades[OcclusionCascade::Count];
+		uint64_t m_ShadowMapSlotsUpdated = 0;
+		VoxelQuery m_VoxelQuery;
+
+		struct VoxelQueryUpdate
+		{
+			Int2 chunk{};
+			std::shared_ptr<std::vector<uint8_t>> source; // the CPU copy it's built from, null until the job was submitted
+			JobFuture<OcclusionBrickVolume> volume;
+		};
+		std::vector<VoxelQueryUpdate> m_VoxelQueryUpdates; // whole chunks of cascade 0
+
+		struct DeferredVoxelEdit
+		{
+			Int2 chunk{};
+			std::variant<VoxelBox, VoxelSphere> shape;
+			uint8_t material = 0;
+		};
+
+		std::vector<Int2> m_EditedChunks; // with dirty bricks
+		std::vector<DeferredVoxelEdit> m_DeferredEdits; // in order, replayed by flush_voxel_edits
+		VoxelEditStats m_EditStats;
+
+		TerrainGenerationBackend m_Backend = TerrainGenerationBackend::GPU;
+		bool m_Headless = false;
+		TerrainGenerationMode m_Mode = TerrainGenerationMode::Volume;
+		VoxelMipReduction m_MipReduction = VoxelMipReduction::AnySolid;
+		uint32_t m_Seed = 0;
+		Float3 m_NoiseOffset{};
+		owning_ptr<ChunkCache> m_ChunkCache;
+		std::vector<owning_ptr<PendingChunk>> m_PendingChunks;
+		std::unordered_map<Int2, JobHandle> m_ChunkStores; // last cache write per chunk, done ones are dropped in update_streaming
+
+		TerrainStreamingSettings m_StreamingSettings;
+		uint64_t m_StreamingFrame = 0;
+		Float3 m_LastCameraPosition{};
+		Float3 m_CameraVelocity{};
+		Int2 m_StreamingOrigin{};
+		Int2 m_SortedOrigin{};
+		Int2 m_ShadowMapOrigin{};
+		bool m_InstancesDirty = true, m_ShadowMapDirty = true;
+
+		std::vector<LODRequest> m_LODQueue;
+		std::vector<LODTiming> m_LODTimings; // waiting for results
+		std::vector<owning_ptr<TimerQuery>> m_FreeTimerQueries;
+		std::vector<TerrainReadback> m_TerrainReadbacks; // in flight or being stored
+		std::vector<owning_ptr<ReadbackBuffer>> m_FreeReadbackBuffers[TerrainChunk::LODCount];
+		float m_LODBudgetMS = 2.0f;
+
+		struct LODView
+		{
+			Float3 position{};
+			float pixels_per_meter_at_1m = 0.0f; // perspective: scales with 1 / distance
+			bool perspective = true;
+			bool valid = false;
+		} m_LODView;
+		TerrainLODSettings m_LODSettings;
+		bool m_LODViewDirty = false;
+
+		float m_LODCostCPU[TerrainChunk::LODCount] = { 0.0f, 0.0f, 0.0f };
+		float m_LODCostGPU[TerrainChunk::LODCount] = { 6.0f, 0.8f, 0.1f }; // guesses until the first queries come back
 	};
 
 } 
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include "pch.h"
+
+#include "TerrainNoise.h"
+
+#include "threading/JobSystem.h"
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define TERRAIN_NOISE_AVX2 1
+#endif
+
+namespace Engine {
+
+	// Straight port of the ashima/stegu 3D simplex noise in Compute_GenerateTerrain.glsl.
+	// The vendored SimplexNoise (third_party/simplex_noise) uses a different lattice hash & gradient set,
+	// so it can't reproduce the GPU volume - the op order here mirrors the GLSL as closely as possible instead
+	static inline Float4 mod289(Float4 x)
+	{
+		return x - glm::floor(x * (1.0f / 289.0f)) * 289.0f;
+	}
+
+	static inline Float3 mod289(Float3 x)
+	{
+		return x - glm::floor(x * (1.0f / 289.0f)) * 289.0f;
+	}
+
+	static inline Float4 permute(Float4 x)
+	{
+		return mod289(((x * 34.0f) + 10.0f) * x);
+	}
+
+	static inline Float4 taylor_inv_sqrt(Float4 r)
+	{
+		return 1.79284291400159f - 0.85373472095314f * r;
+	}
+
+	float terrain_simplex_noise(Float3 v)
+	{
+		const Float2 C = Float2(1.0f / 6.0f, 1.0f / 3.0f);
+		const Float4 D = Float4(0.0f, 0.5f, 1.0f, 2.0f);
+
+		// first corner
+		Float3 i = glm::floor(v + glm::dot(v, Float3(C.y)));
+		Float3 x0 = v - i + glm::dot(i, Float3(C.x));
+
+		// other corners
+		Float3 g = glm::step(Float3(x0.y, x0.z, x0.x), x0);
+		Float3 l = 1.0f - g;
+		Float3 i1 = glm::min(g, Float3(l.z, l.x, l.y));
+		Float3 i2 = glm::max(g, Float3(l.z, l.x, l.y));
+
+		Float3 x1 = x0 - i1 + C.x;
+		Float3 x2 = x0 - i2 + C.y;
+		Float3 x3 = x0 - D.y;
+
+		// permutations
+		i = mod289(i);
+		Float4 p = permute(permute(permute(
+			i.z + Float4(0.0f, i1.z, i2.z, 1.0f))
+			+ i.y + Float4(0.0f, i1.y, i2.y, 1.0f))
+			+ i.x + Float4(0.0f, i1.x, i2.x, 1.0f));
+
+		// gradients: 7x7 points over a square, mapped onto an octahedron
+		float n_ = 0.142857142857f; // 1/7
+		Float3 ns = n_ * Float3(D.w, D.y, D.z) - Float3(D.x, D.z, D.x);
+
+		Float4 j = p - 49.0f * glm::floor(p * ns.z * ns.z);
+
+		Float4 x_ = glm::floor(j * ns.z);
+		Float4 y_ = glm::floor(j - 7.0f * x_);
+
+		Float4 x = x_ * ns.x + ns.y;
+		Float4 y = y_ * ns.x + ns.y;
+		Float4 h = 1.0f - glm::abs(x) - glm::abs(y);
+
+		Float4 b0 = Float4(x.x, x.y, y.x, y.y);
+		Float4 b1 = Float4(x.z, x.w, y.z, y.w);
+
+		Float4 s0 = glm::floor(b0) * 2.0f + 1.0f;
+		Float4 s1 = glm::floor(b1) * 2.0f + 1.0f;
+		Float4 sh = -glm::step(h, Float4(0.0f));
+
+		Float4 a0 = Float4(b0.x, b0.z, b0.y, b0.w) + Float4(s0.x, s0.z, s0.y, s0.w) * Float4(sh.x, sh.x, sh.y, sh.y);
+		Float4 a1 = Float4(b1.x, b1.z, b1.y, b1.w) + Float4(s1.x, s1.z, s1.y, s1.w) * Float4(sh.z, sh.z, sh.w, sh.w);
+
+		Float3 p0 = Float3(a0.x, a0.y, h.x);
+		Float3 p1 = Float3(a0.z, a0.w, h.y);
+		Float3 p2 = Float3(a1.x, a1.y, h.z);
+		Float3 p3 = Float3(a1.z, a1.w, h.w);
+
+		// normalise gradients
+		Float4 norm = taylor_inv_sqrt(Float4(glm::dot(p0, p0), glm::dot(p1, p1), glm::dot(p2, p2), glm::dot(p3, p3)));
+		p0 *= norm.x;
+		p1 *= norm.y;
+		p2 *= norm.z;
+		p3 *= norm.w;
+
+		// mix final noise value
+		Float4 m = glm::max(0.5f - Float4(glm::dot(x0, x0), glm::dot(x1, x1), glm::dot(x2, x2), glm::dot(x3, x3)), 0.0f);
+		m = m * m;
+		return 105.0f * glm::dot(m * m, Float4(glm::dot(p0, x0), glm::dot(p1, x1), glm::dot(p2, x2), glm::dot(p3, x3)));
+	}
+
+	float terrain_fbm(Float3 p, const TerrainNoiseParams& params)
+	{
+		float amplitude = params.amplitude;
+		float frequency = params.frequency;
+		float maxAmplitude = 0.0f;
+
+		float result = 0.0f;
+		for (uint32_t i = 0; i < params.octaves; i++)
+		{
+			result += terrain_simplex_noise(p * frequency) * amplitude;
+			frequency *= params.lacunarity;
+			amplitude *= params.persistence;
+
+			maxAmplitude += amplitude; // matches the shader (accumulated after the falloff)
+		}
+		return result / maxAmplitude;
+	}
+
+	static uint8_t terrain_voxel_value_for_mip(uint32_t mip)
+	{
+		return mip == 0 ? 127 : (mip == 1 ? 100 : 40);
+	}
+
+#if TERRAIN_NOISE_AVX2
+	// 8-wide version of terrain_simplex_noise, one lane per voxel
+	namespace simd {
+
+		static inline __m256 floor8(__m256 v) { return _mm256_floor_ps(v); }
+
+		static inline __m256 mod289(__m256 x)
+		{
+			const __m256 inv = _mm256_set1_ps(1.0f / 289.0f);
+			const __m256 k = _mm256_set1_ps(289.0f);
+			return _mm256_sub_ps(x, _mm256_mul_ps(floor8(_mm256_mul_ps(x, inv)), k));
+		}
+
+		static inline __m256 permute(__m256 x)
+		{
+			__m256 t = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(34.0f)), _mm256_set1_ps(10.0f));
+			return mod289(_mm256_mul_ps(t, x));
+		}
+
+		// step(edge, x) = x >= edge ? 1 : 0
+		static inline __m256 step(__m256 edge, __m256 x)
+		{
+			return _mm256_and_ps(_mm256_cmp_ps(x, edge, _CMP_GE_OQ), _mm256_set1_ps(1.0f));
+		}
+
+		static inline __m256 dot3(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+		}
+
+		static inline __m256 abs8(__m256 v)
+		{
+			return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+		}
+
+		// contribution of a single simplex corner, given its offset from the first corner
+		static inline __m256 corner(__m256 ix, __m256 iy, __m256 iz, __m256 ox, __m256 oy, __m256 oz, __m256 dx, __m256 dy, __m256 dz)
+		{
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 nsx = _mm256_set1_ps(0.142857142857f * 2.0f);
+			const __m256 nsy = _mm256_set1_ps(0.142857142857f * 0.5f - 1.0f);
+			const __m256 nsz = _mm256_set1_ps(0.142857142857f * 1.0f);
+
+			__m256 p = permute(_mm256_add_ps(iz, oz));
+			p = permute(_mm256_add_ps(_mm256_add_ps(p, iy), oy));
+			p = permute(_mm256_add_ps(_mm256_add_ps(p, ix), ox));
+
+			__m256 j = _mm256_sub_ps(p, _mm256_mul_ps(_mm256_set1_ps(49.0f), floor8(_mm256_mul_ps(_mm256_mul_ps(p, nsz), nsz))));
+			__m256 x_ = floor8(_mm256_mul_ps(j, nsz));
+			__m256 y_ = floor8(_mm256_sub_ps(j, _mm256_mul_ps(_mm256_set1_ps(7.0f), x_)));
+
+			__m256 x = _mm256_add_ps(_mm256_mul_ps(x_, nsx), nsy);
+			__m256 y = _mm256_add_ps(_mm256_mul_ps(y_, nsx), nsy);
+			__m256 h = _mm256_sub_ps(_mm256_sub_ps(one, abs8(x)), abs8(y));
+
+			// sh = -step(h, 0)
+			__m256 sh = _mm256_sub_ps(_mm256_setzero_ps(), step(h, _mm256_setzero_ps()));
+			__m256 sx = _mm256_add_ps(_mm256_mul_ps(floor8(x), _mm256_set1_ps(2.0f)), one);
+			__m256 sy = _mm256_add_ps(_mm256_mul_ps(floor8(y), _mm256_set1_ps(2.0f)), one);
+
+			__m256 gx = _mm256_add_ps(x, _mm256_mul_ps(sx, sh));
+			__m256 gy = _mm256_add_ps(y, _mm256_mul_ps(sy, sh));
+			__m256 gz = h;
+
+			__m256 norm = _mm256_sub_ps(_mm256_set1_ps(1.79284291400159f),
+				_mm256_mul_ps(_mm256_set1_ps(0.85373472095314f), dot3(gx, gy, gz, gx, gy, gz)));
+			gx = _mm256_mul_ps(gx, norm);
+			gy = _mm256_mul_ps(gy, norm);
+			gz = _mm256_mul_ps(gz, norm);
+
+			__m256 m = _mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), dot3(dx, dy, dz, dx, dy, dz)), _mm256_setzero_ps());
+			m = _mm256_mul_ps(m, m);
+			return _mm256_mul_ps(_mm256_mul_ps(m, m), dot3(gx, gy, gz, dx, dy, dz));
+		}
+
+		static inline __m256 snoise(__m256 vx, __m256 vy, __m256 vz)
+		{
+			const __m256 cx = _mm256_set1_ps(1.0f / 6.0f);
+			const __m256 cy = _mm256_set1_ps(1.0f / 3.0f);
+			const __m256 one = _mm256_set1_ps(1.0f);
+
+			// first corner
+			__m256 s = dot3(vx, vy, vz, cy, cy, cy);
+			__m256 ix = floor8(_mm256_add_ps(vx, s));
+			__m256 iy = floor8(_mm256_add_ps(vy, s));
+			__m256 iz = floor8(_mm256_add_ps(vz, s));
+
+			__m256 t = dot3(ix, iy, iz, cx, cx, cx);
+			__m256 x0x = _mm256_add_ps(_mm256_sub_ps(vx, ix), t);
+			__m256 x0y = _mm256_add_ps(_mm256_sub_ps(vy, iy), t);
+			__m256 x0z = _mm256_add_ps(_mm256_sub_ps(vz, iz), t);
+
+			// other corners
+			__m256 gx = step(x0y, x0x);
+			__m256 gy = step(x0z, x0y);
+			__m256 gz = step(x0x, x0z);
+			__m256 lx = _mm256_sub_ps(one, gx);
+			__m256 ly = _mm256_sub_ps(one, gy);
+			__m256 lz = _mm256_sub_ps(one, gz);
+
+			__m256 i1x = _mm256_min_ps(gx, lz), i1y = _mm256_min_ps(gy, lx), i1z = _mm256_min_ps(gz, ly);
+			__m256 i2x = _mm256_max_ps(gx, lz), i2y = _mm256_max_ps(gy, lx), i2z = _mm256_max_ps(gz, ly);
+
+			__m256 x1x = _mm256_add_ps(_mm256_sub_ps(x0x, i1x), cx);
+			__m256 x1y = _mm256_add_ps(_mm256_sub_ps(x0y, i1y), cx);
+			__m256 x1z = _mm256_add_ps(_mm256_sub_ps(x0z, i1z), cx);
+
+			__m256 x2x = _mm256_add_ps(_mm256_sub_ps(x0x, i2x), cy);
+			__m256 x2y = _mm256_add_ps(_mm256_sub_ps(x0y, i2y), cy);
+			__m256 x2z = _mm256_add_ps(_mm256_sub_ps(x0z, i2z), cy);
+
+			const __m256 half = _mm256_set1_ps(0.5f);
+			__m256 x3x = _mm256_sub_ps(x0x, half);
+			__m256 x3y = _mm256_sub_ps(x0y, half);
+			__m256 x3z = _mm256_sub_ps(x0z, half);
+
+			ix = mod289(ix);
+			iy = mod289(iy);
+			iz = mod289(iz);
+
+			const __m256 zero = _mm256_setzero_ps();
+			__m256 n = corner(ix, iy, iz, zero, zero, zero, x0x, x0y, x0z);
+			n = _mm256_add_ps(n, corner(ix, iy, iz, i1x, i1y, i1z, x1x, x1y, x1z));
+			n = _mm256_add_ps(n, corner(ix, iy, iz, i2x, i2y, i2z, x2x, x2y, x2z));
+			n = _mm256_add_ps(n, corner(ix, iy, iz, one, one, one, x3x, x3y, x3z));
+
+			return _mm256_mul_ps(_mm256_set1_ps(105.0f), n);
+		}
+
+		static inline __m256 fbm(__m256 px, __m256 py, __m256 pz, const TerrainNoiseParams& params)
+		{
+			float amplitude = params.amplitude;
+			float frequency = params.frequency;
+			float maxAmplitude = 0.0f;
+
+			__m256 result = _mm256_setzero_ps();
+			for (uint32_t i = 0; i < params.octaves; i++)
+			{
+				__m256 f = _mm256_set1_ps(frequency);
+				__m256 n = snoise(_mm256_mul_ps(px, f), _mm256_mul_ps(py, f), _mm256_mul_ps(pz, f));
+				result = _mm256_add_ps(result, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+
+				frequency *= params.lacunarity;
+				amplitude *= params.persistence;
+				maxAmplitude += amplitude;
+			}
+			return _mm256_div_ps(result, _mm256_set1_ps(maxAmplitude));
+		}
+
+	}
+#endif
+
+	void generate_terrain_voxels_cpu_slab(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip, uint32_t z_begin, uint32_t z_end)
+	{
+		const TerrainNoiseParams params{};
+		const float voxelScale = 0.1f * glm::exp2((float)mip);
+		const uint8_t value = terrain_voxel_value_for_mip(mip);
+
+		const size_t rowPitch = dimensions.x;
+		const size_t slicePitch = (size_t)dimensions.x * dimensions.y;
+
+		for (uint32_t z = z_begin; z < z_end; z++)
+		for (uint32_t y = 0; y < (uint32_t)dimensions.y; y++)
+		{
+			uint8_t* row = voxels + z * slicePitch + y * rowPitch;
+			float py = (float)y * voxelScale + chunk_position.y;
+			float pz = (float)z * voxelScale + chunk_position.z;
+
+			uint32_t x = 0;
+#if TERRAIN_NOISE_AVX2
+			const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+			const __m256 scale = _mm256_set1_ps(voxelScale);
+			const __m256 vy = _mm256_set1_ps(py);
+			const __m256 vz = _mm256_set1_ps(pz);
+			const __m256 heightScale = _mm256_set1_ps((float)dimensions.y);
+			const __m256i voxelY = _mm256_set1_epi32((int)y);
+
+			for (; x + 8 <= (uint32_t)dimensions.x; x += 8)
+			{
+				__m256 vx = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)x), lane), scale), _mm256_set1_ps(chunk_position.x));
+
+				__m256 h = simd::fbm(vx, vy, vz, params);
+				h = _mm256_add_ps(_mm256_mul_ps(h, _mm256_set1_ps(0.5f)), _mm256_set1_ps(0.5f));
+				h = _mm256_min_ps(_mm256_max_ps(h, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+
+				// int(height_sample * dims.y - 1) truncates like the shader
+				__m256i voxelHeight = _mm256_cvttps_epi32(_mm256_sub_ps(_mm256_mul_ps(h, heightScale), _mm256_set1_ps(1.0f)));
+				__m256i solid = _mm256_cmpgt_epi32(voxelHeight, voxelY);
+
+				int mask = _mm256_movemask_ps(_mm256_castsi256_ps(solid));
+				for (int i = 0; i < 8; i++)
+					row[x + i] = (mask >> i) & 1 ? value : 0;
+			}
+#endif
+			for (; x < (uint32_t)dimensions.x; x++)
+			{
+				Float3 p = Float3((float)x * voxelScale + chunk_position.x, py, pz);
+				float heightSample = glm::clamp(terrain_fbm(p, params) * 0.5f + 0.5f, 0.0f, 1.0f);
+
+				int voxelHeight = int(heightSample * dimensions.y - 1);
+				row[x] = (int)y < voxelHeight ? value : 0;
+			}
+		}
+	}
+
+	void generate_terrain_heightmap_cpu_slab(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip, uint32_t z_begin, uint32_t z_end)
+	{
+		const TerrainNoiseParams params{};
+		const float voxelScale = 0.1f * glm::exp2((float)mip);
+		const uint8_t value = terrain_voxel_value_for_mip(mip);
+
+		const size_t rowPitch = dimensions.x;
+		const size_t slicePitch = (size_t)dimensions.x * dimensions.y;
+
+		std::vector<int32_t> heights(dimensions.x);
+		for (uint32_t z = z_begin; z < z_end; z++)
+		{
+			// one fBm per column, sampled on the chunk's base plane like the heightmap shader
+			float pz = (float)z * voxelScale + chunk_position.z;
+
+			uint32_t x = 0;
+#if TERRAIN_NOISE_AVX2
+			const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+			const __m256 scale = _mm256_set1_ps(voxelScale);
+			const __m256 vy = _mm256_set1_ps(chunk_position.y);
+			const __m256 vz = _mm256_set1_ps(pz);
+			const __m256 heightScale = _mm256_set1_ps((float)dimensions.y);
+
+			for (; x + 8 <= (uint32_t)dimensions.x; x += 8)
+			{
+				__m256 vx = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)x), lane), scale), _mm256_set1_ps(chunk_position.x));
+
+				__m256 h = simd::fbm(vx, vy, vz, params);
+				h = _mm256_add_ps(_mm256_mul_ps(h, _mm256_set1_ps(0.5f)), _mm256_set1_ps(0.5f));
+				h = _mm256_min_ps(_mm256_max_ps(h, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+
+				__m256i voxelHeight = _mm256_cvttps_epi32(_mm256_sub_ps(_mm256_mul_ps(h, heightScale), _mm256_set1_ps(1.0f)));
+				_mm256_storeu_si256((__m256i*)&heights[x], voxelHeight);
+			}
+#endif
+			for (; x < (uint32_t)dimensions.x; x++)
+			{
+				Float3 p = Float3((float)x * voxelScale + chunk_position.x, chunk_position.y, pz);
+				float heightSample = glm::clamp(terrain_fbm(p, params) * 0.5f + 0.5f, 0.0f, 1.0f);
+				heights[x] = int(heightSample * dimensions.y - 1);
+			}
+
+			// fill the slice row by row, the compiler vectorizes this
+			for (int32_t y = 0; y < dimensions.y; y++)
+			{
+				uint8_t* row = voxels + z * slicePitch + y * rowPitch;
+				for (int32_t i = 0; i < dimensions.x; i++)
+					row[i] = y < heights[i] ? value : 0;
+			}
+		}
+	}
+
+	void generate_terrain_heightmap_cpu(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip)
+	{
+		// much less work per slice than the volume path
+		constexpr uint32_t SlicesPerJob = 16;
+		JobSystem::parallel_for(dimensions.z, SlicesPerJob, [=](uint32_t begin, uint32_t end)
+		{
+			generate_terrain_heightmap_cpu_slab(voxels, dimensions, chunk_position, mip, begin, end);
+		}).wait();
+	}
+
+	void generate_terrain_voxels_cpu(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip)
+	{
+		// a few z slices per job, workers steal the rest
+		constexpr uint32_t SlicesPerJob = 4;
+		JobSystem::parallel_for(dimensions.z, SlicesPerJob, [=](uint32_t begin, uint32_t end)
+		{
+			generate_terrain_voxels_cpu_slab(voxels, dimensions, chunk_position, mip, begin, end);
+		}).wait();
+	}
+
+}
\ No newline at end of file
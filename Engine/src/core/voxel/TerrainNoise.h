@@ -0,0 +1,31 @@
+#pragma once
+
+namespace Engine {
+
+	// fBm parameters - keep in sync with GetSimplexHeightMapValue() in terrain_noise.glinc
+	struct TerrainNoiseParams
+	{
+		float amplitude = 0.5f;
+		float frequency = 0.1f;
+		float lacunarity = 1.8f;
+		float persistence = 0.6f;
+		uint32_t octaves = 5;
+	};
+
+	// scalar port of the ashima/stegu snoise(vec3) used by the terrain compute shader
+	float terrain_simplex_noise(Float3 p);
+	float terrain_fbm(Float3 p, const TerrainNoiseParams& params = {});
+
+	// CPU equivalent of Compute_GenerateTerrain.glsl
+	// fills a tightly packed R8UI volume (x fastest, then y, then z) for the given mip of a chunk
+	void generate_terrain_voxels_cpu(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip);
+
+	// same as above but only for z slices [z_begin, z_end), voxels still points at the start of the volume
+	void generate_terrain_voxels_cpu_slab(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip, uint32_t z_begin, uint32_t z_end);
+
+	// CPU equivalent of Compute_GenerateTerrainHeightmap.glsl
+	// evaluates the fBm once per (x, z) column instead of once per voxel, same output layout
+	void generate_terrain_heightmap_cpu(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip);
+	void generate_terrain_heightmap_cpu_slab(uint8_t* voxels, Int3 dimensions, Float3 chunk_position, uint32_t mip, uint32_t z_begin, uint32_t z_end);
+
+}
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include "pch.h"
 
-#include "Math.h"
+#include "math/Math.h"
 
 #include "rendering/Texture.h"
 #include "VoxelEntity.h"
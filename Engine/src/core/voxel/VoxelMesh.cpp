@@ -9,14 +9,7 @@
 
 namespace Engine {	
 
-	struct VoxelMeshData
-	{
-		uint8_t* voxels = nullptr;
-		uint32_t palette[256]{};
-	};
-
-	// Generates 8-bit voxel data and corresponding palette from image pixels
-	static VoxelMeshData process_voxel_image_data(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t depth, uint32_t bytesPerPixel)
+	VoxelMeshData process_voxel_image_data(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t depth, uint32_t bytesPerPixel)
 	{
 		uint32_t voxelCount = width * height * depth;
 
@@ -5,6 +5,16 @@ namespace Engine {
 	class Texture2D;
 	class Texture3D;
 
+	struct VoxelMeshData
+	{
+		uint8_t* voxels = nullptr; // new[]'d, owned by the caller
+		uint32_t palette[256]{};
+	};
+
+	// Generates 8-bit voxel data and corresponding palette from image pixels
+	// pixels are RGBA slices stacked along the image height, alpha 0 is empty
+	VoxelMeshData process_voxel_image_data(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t depth, uint32_t bytesPerPixel);
+
 	class VoxelMesh
 	{
 	public:
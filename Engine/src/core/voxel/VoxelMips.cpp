@@ -0,0 +1,163 @@
+#include "pch.h"
+
+#include "VoxelMips.h"
+
+#include "threading/JobSystem.h"
+
+#include <bit>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define VOXEL_MIPS_AVX2 1
+#endif
+
+namespace Engine {
+
+	static uint8_t reduce_children(const uint8_t children[8], VoxelMipReduction rule)
+	{
+		uint32_t solid = 0;
+		uint8_t material = 0;
+		uint32_t materialCount = 0;
+
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			if (children[i] == 0)
+				continue;
+
+			solid++;
+
+			uint32_t count = 0;
+			for (uint32_t j = 0; j < 8; j++)
+				count += children[j] == children[i];
+
+			// strictly greater, so ties keep the earlier child
+			if (count > materialCount)
+			{
+				material = children[i];
+				materialCount = count;
+			}
+		}
+
+		bool keep = rule == VoxelMipReduction::AnySolid ? solid > 0 : solid >= 4;
+		return keep ? material : 0;
+	}
+
+	static inline uint8_t reduce_voxel(const uint8_t* source, size_t strideY, size_t strideZ, size_t x, VoxelMipReduction rule)
+	{
+		const uint8_t* p = source + x * 2;
+		uint8_t children[8] = {
+			p[0],                 p[1],
+			p[strideY],           p[strideY + 1],
+			p[strideZ],           p[strideZ + 1],
+			p[strideZ + strideY], p[strideZ + strideY + 1],
+		};
+		return reduce_children(children, rule);
+	}
+
+#if VOXEL_MIPS_AVX2
+	// low byte of every 16 bit lane -> 16 packed bytes
+	static inline __m128i pack_low_bytes(__m256i v)
+	{
+		v = _mm256_and_si256(v, _mm256_set1_epi16(0x00FF));
+		v = _mm256_packus_epi16(v, v);
+		return _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0b1000));
+	}
+#endif
+
+	void downsample_voxel_mip_slab(const uint8_t* source, Int3 source_dimensions, uint8_t* dest, VoxelMipReduction rule, uint32_t z_begin, uint32_t z_end)
+	{
+		ASSERT(source_dimensions.x % 2 == 0 && source_dimensions.y % 2 == 0 && source_dimensions.z % 2 == 0);
+
+		const Int3 destDimensions = source_dimensions / 2;
+		const size_t strideY = source_dimensions.x;
+		const size_t strideZ = (size_t)source_dimensions.x * source_dimensions.y;
+
+#if VOXEL_MIPS_AVX2
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i one = _mm256_set1_epi8(1);
+		const __m256i threshold = _mm256_set1_epi8(rule == VoxelMipReduction::AnySolid ? 1 : 4);
+#endif
+
+		for (uint32_t z = z_begin; z < z_end; z++)
+		for (int32_t y = 0; y < destDimensions.y; y++)
+		{
+			const uint8_t* row = source + (size_t)z * 2 * strideZ + (size_t)y * 2 * strideY;
+			uint8_t* out = dest + ((size_t)z * destDimensions.y + y) * destDimensions.x;
+
+			int32_t x = 0;
+#if VOXEL_MIPS_AVX2
+			// 16 output voxels at a time from 4 source rows of 32 bytes
+			// most children are uniform (all air or one material), only mixed materials go scalar
+			for (; x + 16 <= destDimensions.x; x += 16)
+			{
+				const uint8_t* p = row + x * 2;
+				__m256i r0 = _mm256_loadu_si256((const __m256i*)p);
+				__m256i r1 = _mm256_loadu_si256((const __m256i*)(p + strideY));
+				__m256i r2 = _mm256_loadu_si256((const __m256i*)(p + strideZ));
+				__m256i r3 = _mm256_loadu_si256((const __m256i*)(p + strideZ + strideY));
+
+				// per byte: solid count of the 4 rows, max, min with air treated as 255
+				auto solid = [&](__m256i r) { return _mm256_andnot_si256(_mm256_cmpeq_epi8(r, zero), one); };
+				auto solidMin = [&](__m256i r) { return _mm256_or_si256(r, _mm256_cmpeq_epi8(r, zero)); };
+
+				__m256i count = _mm256_add_epi8(_mm256_add_epi8(solid(r0), solid(r1)), _mm256_add_epi8(solid(r2), solid(r3)));
+				__m256i maxV = _mm256_max_epu8(_mm256_max_epu8(r0, r1), _mm256_max_epu8(r2, r3));
+				__m256i minV = _mm256_min_epu8(_mm256_min_epu8(solidMin(r0), solidMin(r1)), _mm256_min_epu8(solidMin(r2), solidMin(r3)));
+
+				// fold x pairs into the low byte of each 16 bit lane
+				count = _mm256_maddubs_epi16(count, one);
+				maxV = _mm256_max_epu8(maxV, _mm256_srli_epi16(maxV, 8));
+				minV = _mm256_min_epu8(minV, _mm256_srli_epi16(minV, 8));
+
+				__m128i counts = pack_low_bytes(count);
+				__m128i maxes = pack_low_bytes(maxV);
+				__m128i mins = pack_low_bytes(minV);
+
+				__m128i keep = _mm_cmpeq_epi8(_mm_max_epu8(counts, _mm256_castsi256_si128(threshold)), counts);
+				_mm_storeu_si128((__m128i*)(out + x), _mm_and_si128(maxes, keep));
+
+				// kept voxels with more than one material need the full majority vote
+				uint32_t mixed = (uint32_t)_mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(maxes, mins), keep));
+				while (mixed)
+				{
+					uint32_t lane = std::countr_zero(mixed);
+					out[x + lane] = reduce_voxel(row, strideY, strideZ, x + lane, rule);
+					mixed &= mixed - 1;
+				}
+			}
+#endif
+			for (; x < destDimensions.x; x++)
+				out[x] = reduce_voxel(row, strideY, strideZ, x, rule);
+		}
+	}
+
+	void downsample_voxel_mip_region(const uint8_t* source, Int3 source_dimensions, uint8_t* dest, VoxelMipReduction rule, Int3 dest_min, Int3 dest_max)
+	{
+		const Int3 destDimensions = source_dimensions / 2;
+		const size_t strideY = source_dimensions.x;
+		const size_t strideZ = (size_t)source_dimensions.x * source_dimensions.y;
+
+		dest_min = glm::max(dest_min, Int3(0));
+		dest_max = glm::min(dest_max, destDimensions);
+
+		for (int32_t z = dest_min.z; z < dest_max.z; z++)
+		for (int32_t y = dest_min.y; y < dest_max.y; y++)
+		{
+			const uint8_t* row = source + y * 2 * strideY + z * 2 * strideZ;
+			uint8_t* out = dest + (y + (size_t)z * destDimensions.y) * destDimensions.x;
+
+			for (int32_t x = dest_min.x; x < dest_max.x; x++)
+				out[x] = reduce_voxel(row, strideY, strideZ, x, rule);
+		}
+	}
+
+	void downsample_voxel_mip(const uint8_t* source, Int3 source_dimensions, uint8_t* dest, VoxelMipReduction rule)
+	{
+		constexpr uint32_t SlicesPerJob = 8;
+		JobSystem::parallel_for(source_dimensions.z / 2, SlicesPerJob, [=](uint32_t begin, uint32_t end)
+		{
+			downsample_voxel_mip_slab(source, source_dimensions, dest, rule, begin, end);
+		}).wait();
+	}
+
+}
\ No newline at end of file
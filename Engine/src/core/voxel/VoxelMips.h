@@ -0,0 +1,23 @@
+#pragma once
+
+namespace Engine {
+
+	// how 2x2x2 children of a voxel mip collapse into one voxel of the next mip
+	// the material is always the most common solid child (ties go to the first child, x fastest, then y, then z)
+	enum class VoxelMipReduction : uint32_t
+	{
+		AnySolid, // solid if any child is solid, keeps thin features (what the raymarcher wants)
+		Majority, // solid if at least 4 of the 8 children are, smoother silhouettes
+	};
+
+	// CPU equivalent of Compute_DownsampleVoxelMip.glsl
+	// source is a tightly packed R8UI volume (x fastest, then y, then z) with even dimensions, dest is half its size
+	void downsample_voxel_mip(const uint8_t* source, Int3 source_dimensions, uint8_t* dest, VoxelMipReduction rule);
+
+	// same as above but only for dest z slices [z_begin, z_end)
+	void downsample_voxel_mip_slab(const uint8_t* source, Int3 source_dimensions, uint8_t* dest, VoxelMipReduction rule, uint32_t z_begin, uint32_t z_end);
+
+	// only recomputes dest voxels in [dest_min, dest_max), for small edited regions
+	void downsample_voxel_mip_region(const uint8_t* source, Int3 source_dimensions, uint8_t* dest, VoxelMipReduction rule, Int3 dest_min, Int3 dest_max);
+
+}
\ No newline at end of file
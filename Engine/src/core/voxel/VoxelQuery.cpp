@@ -0,0 +1,714 @@
+#include "pch.h"
+
+#include "VoxelQuery.h"
+
+#include "utils/Transformation.h"
+#include "threading/JobSystem.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <random>
+#include <utility>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define VOXEL_QUERY_AVX2 1
+#endif
+
+namespace Engine {
+
+	static inline int32_t floor_div(int32_t a, int32_t b)
+	{
+		return (a >= 0 ? a : a - b + 1) / b;
+	}
+
+	Int3 VoxelQuery::world_to_voxel(Float3 world_position)
+	{
+		return Int3(glm::floor(world_position / VoxelScaleMeters));
+	}
+
+	Int3 VoxelQuery::get_chunk_min_voxel(Int2 chunk_index)
+	{
+		// chunk positions are centers, y is centered on 0 as well
+		return Int3(chunk_index.x * ChunkWidth - ChunkWidth / 2, -ChunkHeight / 2, chunk_index.y * ChunkWidth - ChunkWidth / 2);
+	}
+
+	size_t TracedRayBatch::add(Float3 origin, Float3 direction, float distance)
+	{
+		origin_x.push_back(origin.x);
+		origin_y.push_back(origin.y);
+		origin_z.push_back(origin.z);
+		direction_x.push_back(direction.x);
+		direction_y.push_back(direction.y);
+		direction_z.push_back(direction.z);
+		max_distance.push_back(distance);
+		return origin_x.size() - 1;
+	}
+
+	void TracedRayBatch::reserve(size_t count)
+	{
+		for (auto* inputs : { &origin_x, &origin_y, &origin_z, &direction_x, &direction_y, &direction_z, &max_distance })
+			inputs->reserve(count);
+	}
+
+	void TracedRayBatch::clear()
+	{
+		for (auto* inputs : { &origin_x, &origin_y, &origin_z, &direction_x, &direction_y, &direction_z, &max_distance, &t })
+			inputs->clear();
+		for (auto* cells : { &cell_x, &cell_y, &cell_z })
+			cells->clear();
+		for (auto* normals : { &normal_x, &normal_y, &normal_z })
+			normals->clear();
+		hit.clear();
+	}
+
+	void TracedRayBatch::resize_results()
+	{
+		size_t count = size();
+		hit.resize(count);
+		t.resize(count);
+		for (auto* cells : { &cell_x, &cell_y, &cell_z })
+			cells->resize(count);
+		for (auto* normals : { &normal_x, &normal_y, &normal_z })
+			normals->resize(count);
+	}
+
+	TracedRay TracedRayBatch::get(size_t index) const
+	{
+		TracedRay ray;
+		ray.direction = Float3(direction_x[index], direction_y[index], direction_z[index]);
+		ray.hit = hit[index] != 0;
+		ray.t = t[index];
+		ray.hitpoint = Float3(origin_x[index], origin_y[index], origin_z[index]) + ray.direction * ray.t;
+		ray.sample = hit[index];
+		ray.cell = Int3(cell_x[index], cell_y[index], cell_z[index]);
+		ray.normal = Int3(normal_x[index], normal_y[index], normal_z[index]);
+		return ray;
+	}
+
+	void VoxelQuery::set_chunk(Int2 chunk_index, OcclusionBrickVolume&& volume)
+	{
+		ASSERT(volume.get_mip_count() > 0 && volume.get_voxel_dimensions(0) == Int3(ChunkWidth, ChunkHeight, ChunkWidth));
+		ASSERT(volume.get_mip_count() <= MaxMipCount && (m_MipCount == 0 || volume.get_mip_count() == m_MipCount));
+		m_MipCount = volume.get_mip_count();
+		m_Chunks.insert_or_assign(chunk_index, std::move(volume));
+	}
+
+	void VoxelQuery::update_chunk_region(Int2 chunk_index, Int3 brick_offset, const OcclusionBrickVolume& region)
+	{
+		auto it = m_Chunks.find(chunk_index);
+		if (it == m_Chunks.end())
+			return;
+
+		OcclusionBrickVolume& volume = it->second;
+		uint32_t mipCount = glm::min(volume.get_mip_count(), region.get_mip_count());
+		for (uint32_t mip = 0; mip < mipCount; mip++)
+		{
+			Int3 offset = brick_offset >> (int)mip;
+			Int3 size = region.brick_dimensions[mip];
+			Int3 dimensions = volume.brick_dimensions[mip];
+
+			for (int32_t z = 0; z < size.z; z++)
+			for (int32_t y = 0; y < size.y; y++)
+			{
+				const uint64_t* from = region.mips[mip].data() + (y + (size_t)z * size.y) * size.x;
+				uint64_t* to = volume.mips[mip].data() + offset.x + (offset.y + y + (size_t)(offset.z + z) * dimensions.y) * dimensions.x;
+				memcpy(to, from, size.x * sizeof(uint64_t));
+			}
+		}
+	}
+
+	void VoxelQuery::remove_chunk(Int2 chunk_index)
+	{
+		m_Chunks.erase(chunk_index);
+	}
+
+	size_t VoxelQuery::get_memory_usage() const
+	{
+		size_t bytes = 0;
+		for (const auto& [index, volume] : m_Chunks)
+		{
+			for (const std::vector<uint64_t>& mip : volume.mips)
+				bytes += mip.size() * sizeof(uint64_t);
+		}
+		return bytes;
+	}
+
+	const OcclusionBrickVolume* VoxelQuery::find_chunk(Int2 chunk_index) const
+	{
+		auto it = m_Chunks.find(chunk_index);
+		return it != m_Chunks.end() ? &it->second : nullptr;
+	}
+
+	bool VoxelQuery::is_solid(Int3 world_voxel) const
+	{
+		Int2 chunk = Int2(floor_div(world_voxel.x + ChunkWidth / 2, ChunkWidth), floor_div(world_voxel.z + ChunkWidth / 2, ChunkWidth));
+		const OcclusionBrickVolume* volume = find_chunk(chunk);
+		return volume && volume->is_solid(0, world_voxel - get_chunk_min_voxel(chunk));
+	}
+
+	bool VoxelQuery::is_solid(Float3 world_position) const
+	{
+		return is_solid(world_to_voxel(world_position));
+	}
+
+	struct ChunkHit
+	{
+		bool hit = false;
+		float t = 0.0f; // voxels
+		Int3 voxel{};   // chunk local
+		int axis = -1;  // entered through
+	};
+
+	static inline int min_axis(Float3 v)
+	{
+		return v.x < v.y ? (v.x < v.z ? 0 : 2) : (v.y < v.z ? 1 : 2);
+	}
+
+	// everything in chunk local voxel units, the signs of d are SX, SY, SZ
+	// every branch on a step sign folds away, axes that don't move get FLT_MAX and never win min_axis
+	template<int SX, int SY, int SZ>
+	static ChunkHit raycast_chunk(const OcclusionBrickVolume& volume, Float3 o, Float3 d, Float3 inv_d, float t, float t_end, int axis, VoxelQueryStats& stats)
+	{
+		constexpr int S[3] = { SX, SY, SZ };
+
+		// t where the ray leaves [lo, lo + size) along an axis
+		auto exit_t = [&](int a, int32_t lo, int32_t size)
+		{
+			if (S[a] > 0) return ((float)(lo + size) - o[a]) * inv_d[a];
+			if (S[a] < 0) return ((float)lo - o[a]) * inv_d[a];
+			return FLT_MAX;
+		};
+
+		const Int3 dimensions = volume.get_voxel_dimensions(0);
+		const int32_t top = (int32_t)volume.get_mip_count() - 1;
+
+		Int3 voxel = glm::clamp(Int3(glm::floor(o + d * t)), Int3(0), dimensions - 1);
+		while (t <= t_end)
+		{
+			if (voxel.x < 0 || voxel.y < 0 || voxel.z < 0 || voxel.x >= dimensions.x || voxel.y >= dimensions.y || voxel.z >= dimensions.z)
+				break;
+
+			// coarsest empty brick around the voxel, a coarse brick being empty means everything below is too
+			int32_t level = -1;
+			for (int32_t l = top; l >= 0; l--)
+			{
+				stats.brick_fetches++;
+				if (volume.get_brick(l, voxel >> (2 + l)) == 0)
+				{
+					level = l;
+					break;
+				}
+			}
+
+			if (level >= 0)
+			{
+				int32_t shift = 2 + level, size = 1 << shift;
+				Int3 cellMin = (voxel >> shift) << shift;
+
+				Float3 tExit = Float3(exit_t(0, cellMin.x, size), exit_t(1, cellMin.y, size), exit_t(2, cellMin.z, size));
+				axis = min_axis(tExit);
+				t = tExit[axis];
+
+				// the exit axis steps exactly, the others are kept inside the cell so rounding never walks backwards
+				Int3 next = Int3(glm::floor(o + d * t));
+				for (int a = 0; a < 3; a++)
+					next[a] = a == axis ? (S[a] > 0 ? cellMin[a] + size : cellMin[a] - 1) : glm::clamp(next[a], cellMin[a], cellMin[a] + size - 1);
+				voxel = next;
+				continue;
+			}
+
+			// occupied LOD0 brick, plain DDA until something is hit or the brick is left
+			Int3 brickPos = voxel >> 2;
+			uint64_t brick = volume.get_brick(0, brickPos);
+
+			Float3 tMax = Float3(exit_t(0, voxel.x, 1), exit_t(1, voxel.y, 1), exit_t(2, voxel.z, 1));
+			Float3 delta = Float3(SX ? glm::abs(inv_d.x) : 0.0f, SY ? glm::abs(inv_d.y) : 0.0f, SZ ? glm::abs(inv_d.z) : 0.0f);
+			while (true)
+			{
+				stats.voxel_steps++;
+				if (occlusion_brick_test(brick, voxel & 3))
+					return { true, t, voxel, axis };
+
+				axis = min_axis(tMax);
+				t = tMax[axis];
+				if (t > t_end)
+					return {};
+
+				voxel[axis] += S[axis];
+				tMax[axis] += delta[axis];
+				if ((voxel[axis] >> 2) != brickPos[axis])
+					break;
+			}
+		}
+
+		return {};
+	}
+
+	using RaycastChunkFunction = ChunkHit(*)(const OcclusionBrickVolume&, Float3, Float3, Float3, float, float, int, VoxelQueryStats&);
+
+	// index (sx + 1) + (sy + 1) * 3 + (sz + 1) * 9
+	template<size_t... I>
+	static constexpr std::array<RaycastChunkFunction, 27> make_raycast_table(std::index_sequence<I...>)
+	{
+		return { &raycast_chunk<(int)(I % 3) - 1, (int)(I / 3 % 3) - 1, (int)(I / 9) - 1>... };
+	}
+	static constexpr std::array<RaycastChunkFunction, 27> RaycastChunkTable = make_raycast_table(std::make_index_sequence<27>{});
+
+	TracedRay VoxelQuery::raycast(Float3 origin, Float3 direction, float max_distance, VoxelQueryStats* stats) const
+	{
+		VoxelQueryStats localStats;
+		VoxelQueryStats& s = stats ? *stats : localStats;
+		s.rays++;
+
+		TracedRay result;
+		result.direction = direction;
+		result.t = max_distance;
+
+		Int3 sign = Int3(glm::sign(direction));
+		RaycastChunkFunction raycast_in_chunk = RaycastChunkTable[(sign.x + 1) + (sign.y + 1) * 3 + (sign.z + 1) * 9];
+
+		Float3 o = origin / VoxelScaleMeters;
+		Float3 invD = 1.0f / direction;
+		float tMax = max_distance / VoxelScaleMeters;
+		const Float3 chunkDimensions = Float3(ChunkWidth, ChunkHeight, ChunkWidth);
+
+		// chunk columns along the ray, one slab test each
+		float t = 0.0f;
+		while (t < tMax)
+		{
+			constexpr float Nudge = 1e-3f;
+			Float3 p = o + direction * (t + Nudge);
+			Int2 chunk = Int2(floor_div((int32_t)glm::floor(p.x) + ChunkWidth / 2, ChunkWidth), floor_div((int32_t)glm::floor(p.z) + ChunkWidth / 2, ChunkWidth));
+
+			Int3 chunkMin = get_chunk_min_voxel(chunk);
+			Float3 local = o - Float3(chunkMin);
+
+			Float3 t0 = (Float3(0.0f) - local) * invD;
+			Float3 t1 = (chunkDimensions - local) * invD;
+			Float3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+			for (int a = 0; a < 3; a++)
+			{
+				// parallel to the slab, inside it or not at all
+				if (sign[a] == 0)
+				{
+					bool inside = local[a] >= 0.0f && local[a] < chunkDimensions[a];
+					tNear[a] = inside ? -FLT_MAX : FLT_MAX;
+					tFar[a] = inside ? FLT_MAX : -FLT_MAX;
+				}
+			}
+
+			float columnExit = glm::min(tFar.x, tFar.z);
+			if (const OcclusionBrickVolume* volume = find_chunk(chunk))
+			{
+				int nearAxis = min_axis(-tNear);
+				float near = tNear[nearAxis];
+				float far = glm::min(columnExit, tFar.y);
+
+				float start = glm::max(near, t);
+				float end = glm::min(far, tMax);
+				if (start <= end)
+				{
+					ChunkHit hit = raycast_in_chunk(*volume, local, direction, invD, start, end, near > 0.0f ? nearAxis : -1, s);
+					if (hit.hit)
+					{
+						result.hit = true;
+						result.sample = 1;
+						result.t = hit.t * VoxelScaleMeters;
+						result.hitpoint = origin + direction * result.t;
+						result.cell = chunkMin + hit.voxel;
+						if (hit.axis >= 0)
+							result.normal[hit.axis] = -sign[hit.axis];
+						return result;
+					}
+				}
+			}
+
+			t = glm::max(columnExit, t + Nudge);
+		}
+
+		return result;
+	}
+
+#if VOXEL_QUERY_AVX2
+	// gathers address bricks relative to this, every lane can point into a different chunk's mips
+	alignas(8) static const uint64_t s_GatherBase = 0;
+
+	static inline int64_t get_gather_offset(const uint64_t* bricks)
+	{
+		return ((intptr_t)bricks - (intptr_t)&s_GatherBase) / (intptr_t)sizeof(uint64_t);
+	}
+
+	// two 4 x 64 bit lane masks into one 8 x 32 bit mask
+	static inline __m256i pack_masks_epi64(__m256i lo, __m256i hi)
+	{
+		const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+		return _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(lo, even), _mm256_permutevar8x32_epi32(hi, even), 0x20);
+	}
+
+	// one brick per lane, lanes outside mask read 0
+	static inline void gather_bricks(const int64_t* lane_offsets, __m256i brick_index, __m256i mask, __m256i& lo, __m256i& hi)
+	{
+		const long long* base = (const long long*)&s_GatherBase;
+		__m256i indexLo = _mm256_add_epi64(_mm256_load_si256((const __m256i*)lane_offsets), _mm256_cvtepi32_epi64(_mm256_castsi256_si128(brick_index)));
+		__m256i indexHi = _mm256_add_epi64(_mm256_load_si256((const __m256i*)(lane_offsets + 4)), _mm256_cvtepi32_epi64(_mm256_extracti128_si256(brick_index, 1)));
+		lo = _mm256_mask_i64gather_epi64(_mm256_setzero_si256(), base, indexLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask)), 8);
+		hi = _mm256_mask_i64gather_epi64(_mm256_setzero_si256(), base, indexHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1)), 8);
+	}
+
+	static inline uint32_t lane_count(__m256i mask)
+	{
+		return (uint32_t)std::popcount((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(mask)));
+	}
+
+	// same walk as raycast_chunk, but every lane takes its own step each iteration:
+	// the coarsest empty brick, the whole chunk column if it isn't resident, or a single voxel inside an occupied LOD0 brick
+	// positions are integer voxels relative to a per lane base (which absorbs the chunk offset) plus a float fraction, so far out rays stay exact
+	void VoxelQuery::raycast_packet(TracedRayBatch& batch, size_t first, uint32_t count, VoxelQueryStats& stats) const
+	{
+		constexpr int32_t HalfWidth = ChunkWidth / 2, HalfHeight = ChunkHeight / 2;
+		constexpr int32_t ChunkWidthShift = 9, ChunkHeightShift = 7;
+		static_assert(ChunkWidth == 1 << ChunkWidthShift && ChunkHeight == 1 << ChunkHeightShift);
+
+		alignas(32) float frac[3][8] = {}, dir[3][8] = {}, start[8] = {}, end[8] = {};
+		alignas(32) int32_t base[3][8] = {}, voxel[3][8] = {}, axis[8], active[8] = {};
+
+		// the world is one chunk tall, so every ray gets clipped against that slab once up front
+		// voxel coordinates are shifted by half a chunk here so chunk boundaries land on multiples of the chunk size
+		for (uint32_t i = 0; i < PacketWidth; i++)
+		{
+			axis[i] = -1;
+			if (i >= count)
+				continue;
+
+			size_t r = first + i;
+			Float3 d = Float3(batch.direction_x[r], batch.direction_y[r], batch.direction_z[r]);
+			Float3 u = Float3(batch.origin_x[r], batch.origin_y[r], batch.origin_z[r]) / VoxelScaleMeters + Float3(HalfWidth, HalfHeight, HalfWidth);
+			Int3 b = Int3(glm::floor(u));
+			Float3 f = u - Float3(b);
+
+			float t0 = 0.0f, t1 = batch.max_distance[r] / VoxelScaleMeters;
+			if (d.y != 0.0f)
+			{
+				float enter = -u.y / d.y, exit = (ChunkHeight - u.y) / d.y;
+				t0 = glm::max(t0, glm::min(enter, exit));
+				t1 = glm::min(t1, glm::max(enter, exit));
+				if (t0 > 0.0f)
+					axis[i] = 1;
+			}
+			else if (u.y < 0.0f || u.y >= ChunkHeight)
+				t1 = -1.0f;
+
+			Int3 v = Int3(glm::floor(f + d * t0));
+			v.y = glm::clamp(v.y, -b.y, ChunkHeight - 1 - b.y);
+			for (int a = 0; a < 3; a++)
+			{
+				frac[a][i] = f[a];
+				dir[a][i] = d[a];
+				base[a][i] = b[a];
+				voxel[a][i] = v[a];
+			}
+			start[i] = t0;
+			end[i] = t1;
+			active[i] = t0 <= t1 ? -1 : 0;
+		}
+
+		const __m256i zeroi = _mm256_setzero_si256(), onei = _mm256_set1_epi32(1);
+		const __m256 zero = _mm256_setzero_ps(), huge = _mm256_set1_ps(FLT_MAX);
+
+		__m256 f[3], d[3], inv[3];
+		__m256i b[3], v[3], stepPositive[3], stepZero[3];
+		for (int a = 0; a < 3; a++)
+		{
+			f[a] = _mm256_load_ps(frac[a]);
+			d[a] = _mm256_load_ps(dir[a]);
+			inv[a] = _mm256_div_ps(_mm256_set1_ps(1.0f), d[a]);
+			b[a] = _mm256_load_si256((const __m256i*)base[a]);
+			v[a] = _mm256_load_si256((const __m256i*)voxel[a]);
+			stepPositive[a] = _mm256_castps_si256(_mm256_cmp_ps(d[a], zero, _CMP_GT_OQ));
+			stepZero[a] = _mm256_castps_si256(_mm256_cmp_ps(d[a], zero, _CMP_EQ_OQ));
+		}
+
+		__m256 t = _mm256_load_ps(start);
+		const __m256 tEnd = _mm256_load_ps(end);
+		__m256i axisV = _mm256_load_si256((const __m256i*)axis);
+		__m256i activeV = _mm256_load_si256((const __m256i*)active);
+
+		alignas(32) float hitT[8] = {};
+		alignas(32) int32_t hitCell[3][8] = {}, hitAxis[8] = {}, hitLanes[8] = {};
+
+		// last chunk each lane looked up
+		alignas(32) int32_t chunkX[8], chunkZ[8], resident[8] = {};
+		alignas(32) int64_t mipOffsets[MaxMipCount][8] = {};
+		for (uint32_t i = 0; i < PacketWidth; i++)
+			chunkX[i] = chunkZ[i] = INT32_MIN;
+
+		// occupied LOD0 brick each lane is walking through, voxel steps inside it skip the gathers
+		__m256i cachedIndex = _mm256_set1_epi32(-1), cachedLo = zeroi, cachedHi = zeroi;
+
+		const int32_t mipCount = (int32_t)m_MipCount;
+		const Int3 chunkBricks = Int3(ChunkWidth, ChunkHeight, ChunkWidth) / (int)OcclusionBrickSize;
+
+		while (true)
+		{
+			__m256i u[3] = { _mm256_add_epi32(b[0], v[0]), _mm256_add_epi32(b[1], v[1]), _mm256_add_epi32(b[2], v[2]) };
+
+			// leaving the slab ends the ray
+			__m256i insideY = _mm256_and_si256(_mm256_cmpgt_epi32(u[1], _mm256_set1_epi32(-1)), _mm256_cmpgt_epi32(_mm256_set1_epi32(ChunkHeight), u[1]));
+			activeV = _mm256_and_si256(activeV, insideY);
+			if (_mm256_testz_si256(activeV, activeV))
+				break;
+
+			// chunk lookups only for lanes that crossed into another chunk
+			__m256i cx = _mm256_srai_epi32(u[0], ChunkWidthShift), cz = _mm256_srai_epi32(u[2], ChunkWidthShift);
+			__m256i sameChunk = _mm256_and_si256(_mm256_cmpeq_epi32(cx, _mm256_load_si256((const __m256i*)chunkX)), _mm256_cmpeq_epi32(cz, _mm256_load_si256((const __m256i*)chunkZ)));
+			uint32_t stale = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(sameChunk, activeV)));
+			if (stale)
+			{
+				_mm256_store_si256((__m256i*)chunkX, _mm256_blendv_epi8(_mm256_load_si256((const __m256i*)chunkX), cx, activeV));
+				_mm256_store_si256((__m256i*)chunkZ, _mm256_blendv_epi8(_mm256_load_si256((const __m256i*)chunkZ), cz, activeV));
+				for (; stale; stale &= stale - 1)
+				{
+					uint32_t lane = (uint32_t)std::countr_zero(stale);
+					const OcclusionBrickVolume* volume = find_chunk(Int2(chunkX[lane], chunkZ[lane]));
+					resident[lane] = volume ? -1 : 0;
+					for (int32_t mip = 0; mip < mipCount; mip++)
+						mipOffsets[mip][lane] = volume ? get_gather_offset(volume->mips[mip].data()) : 0;
+				}
+			}
+			__m256i residentV = _mm256_and_si256(_mm256_load_si256((const __m256i*)resident), activeV);
+			cachedIndex = _mm256_blendv_epi8(cachedIndex, _mm256_set1_epi32(-1), _mm256_andnot_si256(sameChunk, activeV));
+
+			__m256i local[3] = { _mm256_and_si256(u[0], _mm256_set1_epi32(ChunkWidth - 1)), u[1], _mm256_and_si256(u[2], _mm256_set1_epi32(ChunkWidth - 1)) };
+
+			auto brick_index = [&](int32_t mip)
+			{
+				__m128i shift = _mm_cvtsi32_si128(2 + mip);
+				__m256i bx = _mm256_srl_epi32(local[0], shift), by = _mm256_srl_epi32(local[1], shift), bz = _mm256_srl_epi32(local[2], shift);
+				return _mm256_add_epi32(bx, _mm256_mullo_epi32(_mm256_add_epi32(by, _mm256_mullo_epi32(bz, _mm256_set1_epi32(chunkBricks.y >> mip))), _mm256_set1_epi32(chunkBricks.x >> mip)));
+			};
+			__m256i index0 = brick_index(0);
+			__m256i known = _mm256_and_si256(_mm256_cmpeq_epi32(index0, cachedIndex), residentV);
+
+			// coarsest empty brick per lane, -1 if the LOD0 brick is occupied
+			__m256i level = _mm256_set1_epi32(-1), found = zeroi;
+			__m256i brickLo = zeroi, brickHi = zeroi;
+			for (int32_t mip = mipCount - 1; mip >= 0; mip--)
+			{
+				__m256i mask = _mm256_andnot_si256(_mm256_or_si256(found, known), residentV);
+				if (_mm256_testz_si256(mask, mask))
+					break;
+
+				gather_bricks(mipOffsets[mip], mip == 0 ? index0 : brick_index(mip), mask, brickLo, brickHi);
+				stats.brick_fetches += lane_count(mask);
+
+				__m256i empty = _mm256_and_si256(pack_masks_epi64(_mm256_cmpeq_epi64(brickLo, zeroi), _mm256_cmpeq_epi64(brickHi, zeroi)), mask);
+				level = _mm256_blendv_epi8(level, _mm256_set1_epi32(mip), empty);
+				found = _mm256_or_si256(found, empty);
+			}
+
+			// brickLo/Hi only hold mip 0 for lanes that got that far, everything else is masked off below
+			__m256i fresh = _mm256_andnot_si256(_mm256_or_si256(found, known), residentV);
+			brickLo = _mm256_blendv_epi8(brickLo, cachedLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(known)));
+			brickHi = _mm256_blendv_epi8(brickHi, cachedHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(known, 1)));
+			cachedIndex = _mm256_blendv_epi8(cachedIndex, index0, fresh);
+			cachedLo = _mm256_blendv_epi8(cachedLo, brickLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(fresh)));
+			cachedHi = _mm256_blendv_epi8(cachedHi, brickHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(fresh, 1)));
+
+			// lanes in occupied LOD0 bricks test their voxel
+			__m256i occupied = _mm256_andnot_si256(found, residentV);
+			if (!_mm256_testz_si256(occupied, occupied))
+			{
+				stats.voxel_steps += lane_count(occupied);
+
+				const __m256i three = _mm256_set1_epi32(3);
+				__m256i bit = _mm256_add_epi32(_mm256_and_si256(local[0], three), _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(local[1], three), 2), _mm256_slli_epi32(_mm256_and_si256(local[2], three), 4)));
+				const __m256i one64 = _mm256_set1_epi64x(1);
+				__m256i setLo = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srlv_epi64(brickLo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(bit))), one64), one64);
+				__m256i setHi = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srlv_epi64(brickHi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(bit, 1))), one64), one64);
+
+				__m256i solid = _mm256_and_si256(pack_masks_epi64(setLo, setHi), occupied);
+				if (!_mm256_testz_si256(solid, solid))
+				{
+					_mm256_maskstore_ps(hitT, solid, t);
+					_mm256_maskstore_epi32(hitAxis, solid, axisV);
+					_mm256_maskstore_epi32(hitLanes, solid, solid);
+					_mm256_maskstore_epi32(hitCell[0], solid, _mm256_sub_epi32(u[0], _mm256_set1_epi32(HalfWidth)));
+					_mm256_maskstore_epi32(hitCell[1], solid, _mm256_sub_epi32(u[1], _mm256_set1_epi32(HalfHeight)));
+					_mm256_maskstore_epi32(hitCell[2], solid, _mm256_sub_epi32(u[2], _mm256_set1_epi32(HalfWidth)));
+					activeV = _mm256_andnot_si256(solid, activeV);
+				}
+			}
+
+			// cell to step over: empty bricks span 4 << level voxels, missing chunks the whole column, occupied bricks a single voxel
+			__m256i missing = _mm256_andnot_si256(residentV, activeV);
+			__m256i shift = _mm256_and_si256(_mm256_add_epi32(level, _mm256_set1_epi32(2)), found);
+			__m256i shifts[3] = {
+				_mm256_blendv_epi8(shift, _mm256_set1_epi32(ChunkWidthShift), missing),
+				_mm256_blendv_epi8(shift, _mm256_set1_epi32(ChunkHeightShift), missing),
+				_mm256_blendv_epi8(shift, _mm256_set1_epi32(ChunkWidthShift), missing)
+			};
+
+			__m256i cellMin[3], cellSize[3];
+			__m256 tExit[3];
+			for (int a = 0; a < 3; a++)
+			{
+				cellSize[a] = _mm256_sllv_epi32(onei, shifts[a]);
+				cellMin[a] = _mm256_sub_epi32(_mm256_sllv_epi32(_mm256_srav_epi32(u[a], shifts[a]), shifts[a]), b[a]); // relative to the lane base
+
+				__m256i boundary = _mm256_blendv_epi8(cellMin[a], _mm256_add_epi32(cellMin[a], cellSize[a]), stepPositive[a]);
+				__m256 tAxis = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(boundary), f[a]), inv[a]);
+				tExit[a] = _mm256_blendv_ps(tAxis, huge, _mm256_castsi256_ps(stepZero[a]));
+			}
+
+			// same tie breaking as min_axis
+			__m256 xy = _mm256_cmp_ps(tExit[0], tExit[1], _CMP_LT_OQ), xz = _mm256_cmp_ps(tExit[0], tExit[2], _CMP_LT_OQ), yz = _mm256_cmp_ps(tExit[1], tExit[2], _CMP_LT_OQ);
+			__m256 tNext = _mm256_blendv_ps(_mm256_blendv_ps(tExit[2], tExit[1], yz), _mm256_blendv_ps(tExit[2], tExit[0], xz), xy);
+			__m256i axisNext = _mm256_castps_si256(_mm256_blendv_ps(
+				_mm256_blendv_ps(_mm256_castsi256_ps(_mm256_set1_epi32(2)), _mm256_castsi256_ps(onei), yz),
+				_mm256_blendv_ps(_mm256_castsi256_ps(_mm256_set1_epi32(2)), _mm256_castsi256_ps(zeroi), xz), xy));
+
+			activeV = _mm256_and_si256(activeV, _mm256_castps_si256(_mm256_cmp_ps(tNext, tEnd, _CMP_LE_OQ)));
+			t = _mm256_blendv_ps(t, tNext, _mm256_castsi256_ps(activeV));
+			axisV = _mm256_blendv_epi8(axisV, axisNext, activeV);
+
+			// the exit axis steps exactly, the others are kept inside the cell so rounding never walks backwards
+			for (int a = 0; a < 3; a++)
+			{
+				__m256i p = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_fmadd_ps(d[a], tNext, f[a])));
+				__m256i last = _mm256_sub_epi32(_mm256_add_epi32(cellMin[a], cellSize[a]), onei);
+				__m256i inside = _mm256_max_epi32(_mm256_min_epi32(p, last), cellMin[a]);
+				__m256i stepped = _mm256_blendv_epi8(_mm256_sub_epi32(cellMin[a], onei), _mm256_add_epi32(last, onei), stepPositive[a]);
+				__m256i next = _mm256_blendv_epi8(inside, stepped, _mm256_cmpeq_epi32(axisNext, _mm256_set1_epi32(a)));
+				v[a] = _mm256_blendv_epi8(v[a], next, activeV);
+			}
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			size_t r = first + i;
+			bool hit = hitLanes[i] != 0;
+			batch.hit[r] = hit ? 1 : 0;
+			batch.t[r] = hit ? hitT[i] * VoxelScaleMeters : batch.max_distance[r];
+			batch.cell_x[r] = hit ? hitCell[0][i] : 0;
+			batch.cell_y[r] = hit ? hitCell[1][i] : 0;
+			batch.cell_z[r] = hit ? hitCell[2][i] : 0;
+
+			Int3 normal = Int3(0);
+			if (hit && hitAxis[i] >= 0)
+			{
+				float component = hitAxis[i] == 0 ? batch.direction_x[r] : hitAxis[i] == 1 ? batch.direction_y[r] : batch.direction_z[r];
+				normal[hitAxis[i]] = component > 0.0f ? -1 : 1;
+			}
+			batch.normal_x[r] = (int8_t)normal.x;
+			batch.normal_y[r] = (int8_t)normal.y;
+			batch.normal_z[r] = (int8_t)normal.z;
+		}
+		stats.rays += count;
+	}
+#else
+	void VoxelQuery::raycast_packet(TracedRayBatch& batch, size_t first, uint32_t count, VoxelQueryStats& stats) const
+	{
+		for (size_t r = first; r < first + count; r++)
+		{
+			TracedRay ray = raycast(Float3(batch.origin_x[r], batch.origin_y[r], batch.origin_z[r]), Float3(batch.direction_x[r], batch.direction_y[r], batch.direction_z[r]), batch.max_distance[r], &stats);
+			batch.hit[r] = ray.hit ? 1 : 0;
+			batch.t[r] = ray.t;
+			batch.cell_x[r] = ray.cell.x;
+			batch.cell_y[r] = ray.cell.y;
+			batch.cell_z[r] = ray.cell.z;
+			batch.normal_x[r] = (int8_t)ray.normal.x;
+			batch.normal_y[r] = (int8_t)ray.normal.y;
+			batch.normal_z[r] = (int8_t)ray.normal.z;
+		}
+	}
+#endif
+
+	void VoxelQuery::raycast_batch(TracedRayBatch& batch, VoxelQueryStats* stats, bool use_job_pool) const
+	{
+		batch.resize_results();
+
+		uint32_t rayCount = (uint32_t)batch.size();
+		uint32_t packetCount = (rayCount + PacketWidth - 1) / PacketWidth;
+
+		auto cast_packets = [&](uint32_t begin, uint32_t end)
+		{
+			VoxelQueryStats local;
+			for (uint32_t packet = begin; packet < end; packet++)
+				raycast_packet(batch, (size_t)packet * PacketWidth, glm::min(PacketWidth, rayCount - packet * PacketWidth), local);
+
+			if (stats)
+			{
+				std::atomic_ref<uint64_t>(stats->rays) += local.rays;
+				std::atomic_ref<uint64_t>(stats->brick_fetches) += local.brick_fetches;
+				std::atomic_ref<uint64_t>(stats->voxel_steps) += local.voxel_steps;
+			}
+		};
+
+		// a job per 64 packets, enough work to be worth the scheduling
+		constexpr uint32_t PacketsPerJob = 64;
+		if (use_job_pool && packetCount > PacketsPerJob)
+			JobSystem::parallel_for(packetCount, PacketsPerJob, cast_packets).wait();
+		else
+			cast_packets(0, packetCount);
+	}
+
+	void VoxelQuery::benchmark_raycasts(Float3 origin, uint32_t ray_count, float max_distance) const
+	{
+		if (m_Chunks.empty())
+		{
+			LOG("voxel query benchmark: no chunks resident");
+			return;
+		}
+
+		// line of sight style, origins spread around a point and directions all over the sphere
+		TracedRayBatch batch;
+		batch.reserve(ray_count);
+
+		std::mt19937 rng(1337);
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+		for (uint32_t i = 0; i < ray_count; i++)
+		{
+			Float3 direction;
+			do
+				direction = Float3(uniform(rng), uniform(rng), uniform(rng));
+			while (glm::dot(direction, direction) > 1.0f || glm::dot(direction, direction) < 1e-4f);
+
+			Float3 jitter = Float3(uniform(rng), uniform(rng) * 0.1f, uniform(rng)) * 10.0f;
+			batch.add(origin + jitter, glm::normalize(direction), max_distance);
+		}
+
+		auto run = [&](const char* name, auto&& cast)
+		{
+			VoxelQueryStats stats;
+			auto start = std::chrono::high_resolution_clock::now();
+			cast(stats);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+			LOG("voxel query benchmark: {} - {:.2f} fetches/ray, {:.2f} steps/ray, {:.2f}M rays/s",
+				name, (double)stats.brick_fetches / ray_count, (double)stats.voxel_steps / ray_count, ray_count / elapsed.count() / 1000.0);
+		};
+
+		LOG("voxel query benchmark: {} rays of {:.0f}m, {} chunks resident", ray_count, max_distance, m_Chunks.size());
+
+		std::vector<TracedRay> single(ray_count);
+		run("single rays", [&](VoxelQueryStats& stats)
+		{
+			for (uint32_t i = 0; i < ray_count; i++)
+				single[i] = raycast(Float3(batch.origin_x[i], batch.origin_y[i], batch.origin_z[i]), Float3(batch.direction_x[i], batch.direction_y[i], batch.direction_z[i]), max_distance, &stats);
+		});
+		run("8 ray packets, 1 thread", [&](VoxelQueryStats& stats) { raycast_batch(batch, &stats, false); });
+		run(std::format("8 ray packets, {} workers", JobSystem::get_worker_count()).c_str(), [&](VoxelQueryStats& stats) { raycast_batch(batch, &stats, true); });
+
+		uint32_t hits = 0, mismatches = 0;
+		for (uint32_t i = 0; i < ray_count; i++)
+		{
+			hits += batch.hit[i];
+			mismatches += (batch.hit[i] != 0) != single[i].hit || (single[i].hit && Int3(batch.cell_x[i], batch.cell_y[i], batch.cell_z[i]) != single[i].cell);
+		}
+		LOG("voxel query benchmark: {} hits, {} rays differ between single & packets", hits, mismatches);
+	}
+
+}
\ No newline at end of file
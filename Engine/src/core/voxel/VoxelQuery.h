@@ -0,0 +1,90 @@
+#pragma once
+
+#include "OcclusionBricks.h"
+
+namespace Engine {
+
+	struct TracedRay
+	{
+		Float3 direction{};
+		Float3 hitpoint{};
+		bool hit = false;
+		float t = 0.0f;     // meters
+		uint8_t sample = 0; // 1 if hit, the occlusion bits don't carry materials
+		Int3 cell{};        // world voxel, (0, 0, 0) spans [0, 0.1m)
+		Int3 normal{};      // face that was entered, zero if the ray started inside a solid voxel
+	};
+
+	// SoA rays for VoxelQuery::raycast_batch, 8 consecutive rays load straight into one AVX2 packet
+	// results are filled in next to the inputs, get() turns one back into a TracedRay
+	struct TracedRayBatch
+	{
+		std::vector<float> origin_x, origin_y, origin_z;
+		std::vector<float> direction_x, direction_y, direction_z; // normalized
+		std::vector<float> max_distance;                          // meters
+
+		std::vector<uint8_t> hit;
+		std::vector<float> t; // meters, max_distance on a miss
+		std::vector<int32_t> cell_x, cell_y, cell_z;
+		std::vector<int8_t> normal_x, normal_y, normal_z;
+
+		size_t add(Float3 origin, Float3 direction, float max_distance); // returns the ray index
+		void reserve(size_t count);
+		void clear();
+		void resize_results();
+
+		size_t size() const { return origin_x.size(); }
+		TracedRay get(size_t index) const;
+	};
+
+	struct VoxelQueryStats
+	{
+		uint64_t rays = 0;
+		uint64_t brick_fetches = 0; // all mips
+		uint64_t voxel_steps = 0;   // per voxel DDA steps inside occupied bricks
+	};
+
+	// CPU side occupancy of the chunks around the camera (mirrors occlusion cascade 0, 0.1m voxels) for picking, gameplay & tools
+	// raycasts skip empty space with the OR mips: the coarsest empty brick around the ray is stepped over in one go,
+	// only occupied LOD0 bricks are walked voxel by voxel
+	// chunks that aren't resident count as empty. not thread safe against updates, read only queries can go wide
+	class VoxelQuery
+	{
+	public:
+		static constexpr int32_t ChunkWidth = 512, ChunkHeight = 128; // TerrainChunk dimensions in voxels, Terrain.h asserts they match
+		static constexpr uint32_t PacketWidth = 8, MaxMipCount = 8;
+
+		// volume covers the whole chunk at mip 0
+		void set_chunk(Int2 chunk_index, OcclusionBrickVolume&& volume);
+		// region has the same mip count, brick_offset is in mip 0 bricks and aligned to the coarsest mip
+		void update_chunk_region(Int2 chunk_index, Int3 brick_offset, const OcclusionBrickVolume& region);
+		void remove_chunk(Int2 chunk_index);
+		void clear() { m_Chunks.clear(); }
+
+		bool has_chunk(Int2 chunk_index) const { return m_Chunks.count(chunk_index) != 0; }
+		size_t get_chunk_count() const { return m_Chunks.size(); }
+		size_t get_memory_usage() const;
+
+		bool is_solid(Int3 world_voxel) const;
+		bool is_solid(Float3 world_position) const;
+
+		// direction has to be normalized
+		TracedRay raycast(Float3 origin, Float3 direction, float max_distance, VoxelQueryStats* stats = nullptr) const;
+		// packets of 8 rays stepped together with AVX2 (one raycast per ray without it), packets are spread over the job pool
+		// same results as raycast up to rays grazing voxel edges
+		void raycast_batch(TracedRayBatch& batch, VoxelQueryStats* stats = nullptr, bool use_job_pool = true) const;
+
+		// rays in random directions from around origin through single raycasts, packets on one thread & packets on the job pool, logs rays/s
+		void benchmark_raycasts(Float3 origin, uint32_t ray_count, float max_distance) const;
+
+		static Int3 world_to_voxel(Float3 world_position);
+		static Int3 get_chunk_min_voxel(Int2 chunk_index);
+	private:
+		const OcclusionBrickVolume* find_chunk(Int2 chunk_index) const;
+		void raycast_packet(TracedRayBatch& batch, size_t first, uint32_t count, VoxelQueryStats& stats) const;
+	private:
+		std::unordered_map<Int2, OcclusionBrickVolume> m_Chunks;
+		uint32_t m_MipCount = 0; // the same for every chunk
+	};
+
+}
\ No newline at end of file
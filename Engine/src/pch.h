@@ -7,6 +7,7 @@
 #include <array>
 #include <cstdint>
 #include <iostream>
+#include <format>
 #include <filesystem>
 
 #include "Logging.h"
@@ -17,4 +18,5 @@
 #include "utils/Color.h"
 #include "utils/Utils.h"
 #include "utils/Transformation.h"
-#include "utils/Memory.h"
\ No newline at end of file
+#include "utils/Memory.h"
+#include "utils/Profiler.h"
\ No newline at end of file
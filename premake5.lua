@@ -34,6 +34,7 @@ project "Engine"
 	pchheader "pch.h"
 	pchsource "Engine/src/pch.cpp"
 	characterset "unicode"
+	vectorextensions "AVX2"
 
 	files
 	{
@@ -125,3 +126,60 @@ project "App"
 		defines "ENGINE_RELEASE"
 		runtime "Release"
 		optimize "on"
+
+project "Bench"
+	location "Bench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++20"
+	staticruntime "on"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+	characterset "unicode"
+	vectorextensions "AVX2"
+
+	files
+	{
+		"%{prj.name}/src/**.h",
+		"%{prj.name}/src/**.cpp",
+	}
+
+	defines
+	{
+		"_CRT_SECURE_NO_WARNINGS"
+	}
+
+	includedirs
+	{
+		"Engine/src",
+		"Engine/src/core",
+		"Engine/third_party",
+		"%{prj.name}/src",
+	}
+
+	-- headless, but the engine library still references GL & GLFW symbols
+	links
+	{
+		"Engine",
+		"msdf-atlas-gen",
+		"glad",
+		"GLFW",
+	}
+
+	filter "system:windows"
+		systemversion "latest"
+		characterset "MBCS"
+
+	filter "system:linux"
+		links { "pthread", "dl" }
+
+	filter "configurations:Debug"
+		defines "ENGINE_DEBUG"
+		runtime "Debug"
+		symbols "on"
+
+	filter "configurations:Release"
+		defines "ENGINE_RELEASE"
+		runtime "Release"
+		optimize "on"